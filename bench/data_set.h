@@ -0,0 +1,138 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_BENCH_DATA_SET_H
+#define FILESTORE_BENCH_DATA_SET_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+namespace fs = std::filesystem;
+
+// File sizes of a synthetic data set, read from FILESTORE_BENCH_SIZES:
+//   fixed:<size>, uniform:<min>:<max> or lognormal:<median>:<sigma> (sizes in bytes)
+struct SizeDistribution {
+    enum class Kind { fixed, uniform, lognormal };
+
+    static constexpr std::uint64_t max_size = 64U << 20;
+
+    Kind kind{Kind::lognormal};
+    double a{16384};
+    double b{1.5};
+
+    static SizeDistribution from_environment() {
+        SizeDistribution distribution;
+        const char *value = std::getenv("FILESTORE_BENCH_SIZES");
+        if (value == nullptr)
+            return distribution;
+
+        std::istringstream input{value};
+        std::string kind;
+        char separator;
+        std::getline(input, kind, ':');
+        if (kind == "fixed")
+            distribution = {Kind::fixed, 0, 0};
+        else if (kind == "uniform")
+            distribution = {Kind::uniform, 0, 0};
+        input >> distribution.a;
+        if (kind != "fixed")
+            input >> separator >> distribution.b;
+        return distribution;
+    }
+
+    std::uint64_t sample(std::mt19937_64 &rng) const {
+        double size = a;
+        if (kind == Kind::uniform)
+            size = std::uniform_real_distribution<double>{a, b}(rng);
+        else if (kind == Kind::lognormal)
+            size = std::lognormal_distribution<double>{std::log(a), b}(rng);
+        return std::min(static_cast<std::uint64_t>(std::max(size, 0.0)), max_size);
+    }
+
+    std::string description() const {
+        std::ostringstream result;
+        switch (kind) {
+        case Kind::fixed: result << "fixed:" << a; break;
+        case Kind::uniform: result << "uniform:" << a << ':' << b; break;
+        case Kind::lognormal: result << "lognormal:" << a << ':' << b; break;
+        }
+        return result.str();
+    }
+};
+
+// Number of files in a data set, read from FILESTORE_BENCH_FILES
+inline size_t data_set_files() {
+    const char *value = std::getenv("FILESTORE_BENCH_FILES");
+    return value != nullptr ? std::stoul(value) : 256;
+}
+
+// Directory of files with random contents. The same seed gives the same files.
+class DataSet {
+public:
+    DataSet(size_t count, const SizeDistribution &distribution, std::uint64_t seed = 1) {
+        m_path = fs::temp_directory_path() / ("filestore-bench-" + std::to_string(seed) + "-" + std::to_string(std::random_device{}()));
+        fs::create_directories(m_path);
+
+        std::mt19937_64 rng{seed};
+        std::vector<char> content;
+        for (size_t i = 0; i < count; ++i) {
+            content.resize(distribution.sample(rng));
+            fill(content, rng);
+            m_files.push_back(m_path / std::to_string(i));
+            std::ofstream{m_files.back(), std::ios_base::binary}.write(content.data(), static_cast<std::streamsize>(content.size()));
+            m_total_size += content.size();
+        }
+    }
+    ~DataSet() { fs::remove_all(m_path); }
+
+    DataSet(const DataSet &) = delete;
+    DataSet &operator=(const DataSet &) = delete;
+
+    const fs::path &path() const { return m_path; }
+    const std::vector<fs::path> &files() const { return m_files; }
+    std::uint64_t total_size() const { return m_total_size; }
+
+    static void fill(std::vector<char> &content, std::mt19937_64 &rng) {
+        for (size_t i = 0; i < content.size(); i += sizeof(std::uint64_t)) {
+            const auto value = rng();
+            std::copy_n(reinterpret_cast<const char *>(&value), std::min(sizeof(value), content.size() - i), content.data() + i);
+        }
+    }
+private:
+    fs::path m_path;
+    std::vector<fs::path> m_files;
+    std::uint64_t m_total_size{0};
+};
+
+// Removes the file's clean pages from the page cache, so the next read comes from the disk
+inline void drop_from_page_cache([[maybe_unused]] const fs::path &file_path) {
+#if defined(__linux__)
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fdatasync(fd);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+#endif
+}
+
+} // namespace bench
+
+#endif
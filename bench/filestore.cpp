@@ -0,0 +1,165 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <benchmark/benchmark.h>
+
+#include "FileStore/filestore.h"
+#include "data_set.h"
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Empty store in a temporary directory
+class TempStore {
+public:
+    TempStore() : m_path{fs::temp_directory_path() / ("filestore-bench-store-" + std::to_string(std::random_device{}()))} {}
+    ~TempStore() { fs::remove_all(m_path); }
+
+    const fs::path &path() const { return m_path; }
+private:
+    fs::path m_path;
+};
+
+void get_file_path(benchmark::State &state) {
+    const TempStore temp;
+    const filestore::FileStore store{temp.path(), static_cast<int>(state.range(0))};
+    filestore::Key key{};
+    for (size_t i = 0; i < key.data.size(); ++i)
+        key.data[i] = static_cast<std::byte>(i * 37);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(store.get_file_path(key));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+BENCHMARK(get_file_path)->Arg(0)->Arg(2)->Arg(4);
+
+void set_counters(benchmark::State &state, const bench::DataSet &data) {
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.total_size()));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * data.files().size()));
+}
+
+// Every file is new to the store. The argument is the pack threshold.
+void import_new(benchmark::State &state) {
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+    const filestore::StoreOptions options{.pack_threshold = static_cast<std::uint64_t>(state.range(0))};
+
+    std::optional<TempStore> temp;
+    for (auto _ : state) {
+        state.PauseTiming();
+        temp.reset();
+        filestore::FileStore store{temp.emplace().path(), options};
+        state.ResumeTiming();
+
+        for (const auto &file : data.files())
+            benchmark::DoNotOptimize(store.import(file));
+    }
+    set_counters(state, data);
+}
+BENCHMARK(import_new)->Arg(0)->Arg(64 << 10)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Every file is new to the store, all imports are in flight at once
+void import_new_async(benchmark::State &state) {
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+
+    std::optional<TempStore> temp;
+    for (auto _ : state) {
+        state.PauseTiming();
+        temp.reset();
+        filestore::FileStore store{temp.emplace().path()};
+        state.ResumeTiming();
+
+        std::vector<std::future<filestore::FileStore::import_result>> results;
+        for (const auto &file : data.files())
+            results.push_back(store.import_async(file));
+        for (auto &result : results)
+            benchmark::DoNotOptimize(result.get());
+    }
+    set_counters(state, data);
+}
+BENCHMARK(import_new_async)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Every file is already in the store
+void import_duplicates(benchmark::State &state) {
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+    const TempStore temp;
+    filestore::FileStore store{temp.path()};
+    for (const auto &file : data.files())
+        store.import(file);
+
+    for (auto _ : state) {
+        for (const auto &file : data.files())
+            benchmark::DoNotOptimize(store.import(file));
+    }
+    set_counters(state, data);
+}
+BENCHMARK(import_duplicates)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The place of every file is taken by an object of the same size and hash, but other contents in the middle,
+// so the contents are compared completely before a new distinguisher is used
+void import_collisions(benchmark::State &state) {
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+    std::vector<filestore::Key> keys;
+    for (const auto &file : data.files())
+        keys.push_back(filestore::generate_file_key(file));
+
+    std::optional<TempStore> temp;
+    for (auto _ : state) {
+        state.PauseTiming();
+        temp.reset();
+        filestore::FileStore store{temp.emplace().path()};
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const auto object_path = store.get_file_path(keys[i]);
+            fs::create_directories(object_path.parent_path());
+            fs::copy_file(data.files()[i], object_path);
+            const auto size = fs::file_size(object_path);
+            if (size == 0)
+                continue;
+            std::fstream object{object_path, std::ios_base::binary | std::ios_base::in | std::ios_base::out};
+            object.seekp(static_cast<std::streamoff>(size / 2));
+            object.put('\x01');
+        }
+        state.ResumeTiming();
+
+        for (const auto &file : data.files())
+            benchmark::DoNotOptimize(store.import(file));
+    }
+    set_counters(state, data);
+}
+BENCHMARK(import_collisions)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+
+namespace {
+
+// Repeated reads of the same objects, with and without the mapping cache
+void open_objects(benchmark::State &state) {
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+    const TempStore temp;
+    filestore::FileStore store{temp.path(), filestore::StoreOptions{.mapping_cache_size = static_cast<size_t>(state.range(0))}};
+    std::vector<filestore::Key> keys;
+    for (const auto &file : data.files()) {
+        const auto result = store.import(file);
+        keys.push_back(result ? *result : result.error());
+    }
+
+    for (auto _ : state) {
+        for (const auto &key : keys) {
+            const auto view = store.open(key);
+            if (!view.empty())
+                benchmark::DoNotOptimize(view.data()[0]);
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * keys.size()));
+}
+BENCHMARK(open_objects)->Arg(0)->Arg(4096);
+
+} // namespace
@@ -0,0 +1,122 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <benchmark/benchmark.h>
+
+#include "FileStore/bin_utils.h"
+#include "FileStore/blake3.h"
+#include "FileStore/filestore.h"
+#include "FileStore/hash.h"
+#include "FileStore/sha256.h"
+#include "FileStore/xxhash.h"
+#include "data_set.h"
+#include <random>
+#include <vector>
+
+namespace {
+
+void sha256_update(benchmark::State &state) {
+    using namespace filestore;
+    std::vector<char> buffer(static_cast<size_t>(state.range(0)));
+    std::mt19937_64 rng{1};
+    bench::DataSet::fill(buffer, rng);
+
+    SHA256 sha;
+    for (auto _ : state) {
+        sha.update(buffer);
+        benchmark::DoNotOptimize(sha);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+    state.SetLabel(SHA256::implementation() == SHA256::Implementation::shani ? "shani" : "generic");
+}
+BENCHMARK(sha256_update)->RangeMultiplier(8)->Range(64, 1 << 24);
+
+void blake3_update(benchmark::State &state) {
+    using namespace filestore;
+    std::vector<char> buffer(static_cast<size_t>(state.range(0)));
+    std::mt19937_64 rng{1};
+    bench::DataSet::fill(buffer, rng);
+
+    Blake3 blake3;
+    for (auto _ : state) {
+        blake3.update(buffer);
+        benchmark::DoNotOptimize(blake3);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+    static constexpr const char *names[] = {"generic", "avx2", "avx512"};
+    state.SetLabel(names[static_cast<int>(Blake3::implementation())]);
+}
+BENCHMARK(blake3_update)->RangeMultiplier(8)->Range(64, 1 << 24);
+
+void xxh3_128_update(benchmark::State &state) {
+    using namespace filestore;
+    std::vector<char> buffer(static_cast<size_t>(state.range(0)));
+    std::mt19937_64 rng{1};
+    bench::DataSet::fill(buffer, rng);
+
+    XXH3_128 xxh;
+    for (auto _ : state) {
+        xxh.update(buffer);
+        benchmark::DoNotOptimize(xxh);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(xxh3_128_update)->RangeMultiplier(8)->Range(64, 1 << 24);
+
+void hash_file(benchmark::State &state, bool cold) {
+    using namespace filestore;
+    const bench::DataSet data{bench::data_set_files(), bench::SizeDistribution::from_environment()};
+
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            for (const auto &file : data.files())
+                bench::drop_from_page_cache(file);
+            state.ResumeTiming();
+        }
+        for (const auto &file : data.files())
+            benchmark::DoNotOptimize(filestore::hash_file<SHA256>(file));
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.total_size()));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * data.files().size()));
+}
+BENCHMARK_CAPTURE(hash_file, warm, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(hash_file, cold, true)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void bytes_to_hex(benchmark::State &state) {
+    std::vector<std::byte> bytes(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = static_cast<std::byte>(i * 37);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(filestore::bytes_to_hex(bytes.begin(), bytes.end()));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(bytes_to_hex)->Arg(32)->Arg(1024);
+
+void key_to_string(benchmark::State &state) {
+    filestore::Key key{};
+    for (size_t i = 0; i < key.data.size(); ++i)
+        key.data[i] = static_cast<std::byte>(i * 37);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(filestore::to_string(key));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+BENCHMARK(key_to_string);
+
+void key_from_string(benchmark::State &state) {
+    filestore::Key key{};
+    for (size_t i = 0; i < key.data.size(); ++i)
+        key.data[i] = static_cast<std::byte>(i * 37);
+    const auto digits = filestore::to_string(key);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(filestore::from_string(digits));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+BENCHMARK(key_from_string);
+
+} // namespace
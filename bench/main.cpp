@@ -0,0 +1,32 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <benchmark/benchmark.h>
+
+#include "FileStore/sha256.h"
+#include "FileStore/sha256_multi.h"
+#include "data_set.h"
+#include <string>
+
+// Compare builds with the JSON output, e.g.
+//   benchmarks --benchmark_out=base.json --benchmark_out_format=json
+//   compare.py benchmarks base.json new.json
+// The data set and the selected implementations are recorded in the context of the output.
+int main(int argc, char **argv) {
+    using namespace filestore;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    benchmark::AddCustomContext("data_set_sizes", bench::SizeDistribution::from_environment().description());
+    benchmark::AddCustomContext("data_set_files", std::to_string(bench::data_set_files()));
+    benchmark::AddCustomContext("sha256", SHA256::implementation() == SHA256::Implementation::shani ? "shani" : "generic");
+    benchmark::AddCustomContext("sha256_lanes", std::to_string(SHA256Multi::lanes()));
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
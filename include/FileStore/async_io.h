@@ -0,0 +1,96 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_ASYNC_IO_H
+#define FILESTORE_ASYNC_IO_H
+
+#include "FileStore/thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// File I/O with many requests in flight, so one thread can keep a fast disk busy. Uses io_uring on Linux, if the
+// kernel allows it, blocking reads and writes on the thread pool otherwise. Handlers run on the thread pool and
+// may start further requests.
+class AsyncIo {
+public:
+    enum class Backend {
+        io_uring,
+        threads,
+    };
+
+    using data_handler = std::function<void(std::span<const char>)>;
+    // Gets the error, if the request failed
+    using done_handler = std::function<void(std::exception_ptr)>;
+
+    static constexpr size_t chunk_size = 1U << 20;
+
+    // queue_depth: operations submitted to the kernel at once. threads: for handlers and the fallback, 0 for one
+    // per hardware thread. Falls back to threads, if io_uring is not available.
+    explicit AsyncIo(Backend backend = Backend::io_uring, unsigned queue_depth = 64, size_t threads = 0);
+    // Waits for all requests
+    ~AsyncIo();
+
+    AsyncIo(const AsyncIo &) = delete;
+    AsyncIo &operator=(const AsyncIo &) = delete;
+
+    Backend backend() const { return m_ring ? Backend::io_uring : Backend::threads; }
+
+    // Reads the file front to back in chunks. on_data gets them in order, on_done is called once after the last
+    // one. An exception thrown by on_data ends the request and is passed to on_done.
+    void read_file(const fs::path &path, data_handler on_data, done_handler on_done);
+    // Like read_file, but the data is also written to target, which is created or truncated
+    void copy_file(const fs::path &source, const fs::path &target, data_handler on_data, done_handler on_done);
+    // Runs a task on the handler threads
+    void post(std::function<void()> task);
+
+    // Blocks until all requests are finished. Rethrows the first exception thrown by a done handler or task.
+    // Must not be called from a handler.
+    void wait();
+private:
+    class Ring;
+    struct Operation;
+    struct Transfer;
+
+    std::unique_ptr<Ring> m_ring; // nullptr for the thread backend
+    ThreadPool m_pool;
+    std::thread m_completion_thread;
+
+    std::mutex m_submit_mutex;
+    std::deque<std::unique_ptr<Operation>> m_backlog; // waiting for room in the ring
+    unsigned m_queue_depth;
+    unsigned m_in_flight{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_all_done;
+    size_t m_pending{0};
+    std::exception_ptr m_exception;
+
+    void start_transfer(std::shared_ptr<Transfer> transfer);
+    void continue_transfer(std::shared_ptr<Transfer> transfer, std::int64_t result);
+    void submit(std::unique_ptr<Operation> operation);
+    void submit_to_ring(std::unique_ptr<Operation> operation);
+    void run_completions();
+    void run_handler(const std::function<void()> &handler);
+    void add_pending();
+    void finish_pending();
+};
+
+} // namespace filestore
+
+#endif
@@ -6,27 +6,49 @@
 #ifndef FILESTORE_BIN_UTILS_H
 #define FILESTORE_BIN_UTILS_H
 
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <span>
 #include <string>
+#include <string_view>
 
 namespace filestore {
 
+// Both hex digits (lower case) of every byte value
+inline constexpr auto hex_table = []() {
+    constexpr auto hexchars = "0123456789abcdef";
+    std::array<std::array<char, 2>, 256> table{};
+    for (size_t i = 0; i < table.size(); ++i)
+        table[i] = {hexchars[i / 16], hexchars[i % 16]};
+    return table;
+}();
+
+// Writes the 2 * bytes.size() hex digits of bytes to out. Uses SSSE3, if available.
+void hex_encode(std::span<const std::byte> bytes, char *out);
+// Reads the lower case hex digits written by hex_encode. Returns false, if hex is not 2 * bytes.size() long or
+// contains other characters; bytes is undefined then.
+bool hex_decode(std::string_view hex, std::span<std::byte> bytes);
+
 inline std::string byte_to_hex(std::byte b) {
-    static constexpr auto hexchars = "0123456789abcdef";
-    std::string res{2, '0'};
-    const auto value = std::to_integer<int>(b);
-    res[0] = hexchars[value / 16];
-    res[1] = hexchars[value % 16];
-    return res;
+    const auto &digits = hex_table[std::to_integer<size_t>(b)];
+    return std::string(digits.data(), digits.size());
 }
 
 template<typename I>
 inline std::string bytes_to_hex(I begin, I end) {
-    std::string res;
-    const auto length = std::distance(begin, end);
-    res.reserve(length * 2);
-    I it{begin};
-    while (it != end)
-        res += byte_to_hex(*it++);
+    std::string res(2 * static_cast<size_t>(std::distance(begin, end)), '\0');
+    if constexpr (std::contiguous_iterator<I> && std::same_as<std::iter_value_t<I>, std::byte>) {
+        hex_encode(std::span<const std::byte>(begin, end), res.data());
+    } else {
+        auto *out = res.data();
+        for (I it{begin}; it != end; ++it) {
+            const auto &digits = hex_table[std::to_integer<size_t>(*it)];
+            *out++ = digits[0];
+            *out++ = digits[1];
+        }
+    }
     return res;
 }
 
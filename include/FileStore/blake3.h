@@ -0,0 +1,81 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_BLAKE3_H
+#define FILESTORE_BLAKE3_H
+
+#include "FileStore/hash.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+namespace filestore {
+
+// BLAKE3 with 256 bit output (hash mode, no key). Full chunks are hashed in parallel SIMD lanes, if the CPU
+// supports it.
+class Blake3 {
+public:
+    static constexpr auto hash_size = 256U;
+    static constexpr size_t block_size = 64;
+    static constexpr size_t chunk_size = 1024;
+    using hash_type = hash_value<hash_size>;
+    using word = std::uint32_t;
+
+    static constexpr word IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    static constexpr std::uint8_t message_schedule[7][16] = {
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}, {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+        {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1}, {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+        {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4}, {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+        {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13}};
+
+    enum flags : word {
+        chunk_start = 1,
+        chunk_end = 2,
+        parent = 4,
+        root = 8,
+    };
+
+    enum class Implementation {
+        generic, // one chunk after the other
+        avx2,    // 8 chunks at once
+        avx512,  // 16 chunks at once
+    };
+
+    Blake3();
+
+    void update(std::span<const char> data);
+    hash_type hash() const;
+
+    static bool is_supported(Implementation impl);
+    static Implementation implementation();
+    // Select the implementation used by all Blake3 instances. Returns false, if the CPU does not support it.
+    static bool use_implementation(Implementation impl);
+private:
+    using chaining_value = std::array<word, 8>;
+
+    // the chunk being hashed
+    chaining_value m_chunk_cv;
+    std::uint64_t m_chunk_counter{0};
+    std::array<std::byte, block_size> m_block{};
+    size_t m_block_length{0};
+    size_t m_blocks_compressed{0};
+    // chaining values of complete subtrees, one for each set bit of m_chunk_counter
+    std::array<chaining_value, 54> m_stack;
+    size_t m_stack_size{0};
+
+    static std::atomic<int> selected; // -1: not yet selected
+
+    // Adds the chaining value of a complete subtree of chunks chunks (a power of two) at the chunk counter
+    void add_chunk_cv(chaining_value cv, std::uint64_t chunks = 1);
+    // Hashes full chunks directly from the input, several at once. The chunk state must be empty.
+    void hash_chunks(const std::byte *data, size_t chunks);
+    static Implementation detect_implementation();
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,93 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_CATALOG_H
+#define FILESTORE_CATALOG_H
+
+#include "FileStore/file.h"
+#include "FileStore/key.h"
+#include "FileStore/key_index.h"
+#include "FileStore/mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+struct CatalogEntry {
+    Key key{};
+    std::uint64_t size{0};
+    std::int64_t modification_time{0}; // nanoseconds since the Unix epoch
+    std::int64_t import_time{0};       // nanoseconds since the Unix epoch
+    std::uint64_t sample_hash{0};      // see Fingerprint, 0 if unknown
+
+    Fingerprint fingerprint() const { return {size, sample_hash}; }
+};
+
+// Append-only list of the objects in a store. Every record carries a checksum and is handed to the file system when
+// it is added, so it outlives a crash of the process; records torn by a crash are cut off when the catalog is opened.
+// Enumeration is a sequential scan of the memory-mapped file. A catalog file must only be open in one Catalog (and
+// process) at a time.
+class Catalog {
+public:
+    // Opens the catalog file, creating an empty one, if it does not exist
+    explicit Catalog(const fs::path &file_path);
+    ~Catalog();
+
+    Catalog(const Catalog &) = delete;
+    Catalog &operator=(const Catalog &) = delete;
+
+    // Adding a listed object again replaces its entry, removing an unlisted one has no effect
+    void add(const CatalogEntry &entry);
+    void remove(const Key &key);
+
+    // Calls f for each object in the catalog, in the order they were added. f must not change the catalog.
+    void for_each(const std::function<void(const CatalogEntry &)> &f) const;
+    std::vector<CatalogEntry> entries() const;
+    size_t size() const;
+
+    // False, if the catalog was still open in another Catalog when this one opened it, e.g. after a crash. Objects
+    // stored meanwhile may be missing then.
+    bool closed_cleanly() const { return m_closed_cleanly; }
+
+    // Flushes the records to the disk
+    void sync();
+    // Rewrites the file without records of removed objects
+    void compact();
+    // Replaces the catalog by the one in file_path, which is moved in its place
+    void replace(const fs::path &file_path);
+
+    const fs::path &file_path() const { return m_file_path; }
+    static std::int64_t now();
+private:
+    fs::path m_file_path;
+    fs::path m_open_marker_path;
+    bool m_closed_cleanly{true};
+    mutable std::mutex m_mutex;
+    mutable MappedFile m_mapping;
+    mutable size_t m_mapped_records{0};
+    mutable std::ofstream m_output;
+    size_t m_records{0};
+    size_t m_removals{0};
+    KeyIndex m_live; // keys of the listed objects
+
+    void open();
+    void recover();
+    void append(const CatalogEntry &entry, std::uint32_t type);
+    void map() const;
+    void scan(const std::function<void(const CatalogEntry &)> &f) const;
+    void compact_locked();
+    void replace_locked(const fs::path &file_path);
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,55 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_CHUNKING_H
+#define FILESTORE_CHUNKING_H
+
+#include "FileStore/file.h"
+#include "FileStore/key.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace filestore {
+
+struct ChunkingPolicy {
+    // Files at least this large are stored as chunks, 0 for none
+    std::uint64_t min_file_size{0};
+    std::uint32_t min_chunk_size{16U << 10};
+    std::uint32_t average_chunk_size{64U << 10}; // a power of 2
+    std::uint32_t max_chunk_size{256U << 10};
+};
+
+// Length of the first chunk of data. Boundaries are found with a Gear rolling hash over the last 64 bytes (FastCDC
+// with normalized chunking), so they depend on the content only: an insertion moves the boundaries around it, but
+// not the ones further away.
+size_t next_chunk_size(std::span<const std::byte> data, const ChunkingPolicy &policy);
+
+struct ChunkRef {
+    Key key{};
+    std::uint32_t size{0};
+};
+
+// The chunks an object is made of, stored in place of its content
+struct ChunkManifest {
+    std::uint64_t size{0};        // of the content
+    std::uint64_t sample_hash{0}; // see Fingerprint
+    std::vector<ChunkRef> chunks;
+
+    Fingerprint fingerprint() const { return {size, sample_hash}; }
+
+    std::vector<std::byte> serialize() const;
+    // nullopt, if the data is not a manifest
+    static std::optional<ChunkManifest> parse(std::span<const std::byte> data);
+    // Whether the data starts like a manifest, so it may be one; a check before reading it completely
+    static bool has_magic(std::span<const std::byte> data);
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,84 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_COMPRESSION_H
+#define FILESTORE_COMPRESSION_H
+
+#include "FileStore/file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+enum class Compression {
+    none,
+    deflate, // zlib, only if the library was built with it
+};
+
+struct CompressionPolicy {
+    Compression algorithm{Compression::none};
+    int level{6};
+    // Uncompressed bytes per block. Each block is compressed on its own, so it can be read without the others.
+    std::uint32_t block_size{256U << 10};
+    // Content is stored uncompressed, if compression does not get it below this fraction of its size
+    double max_ratio{0.9};
+};
+
+bool compression_available(Compression algorithm);
+
+// Writes the content of source to target in the compressed block format. Returns false, if the content does not
+// compress well enough; target is incomplete then and must be discarded. Content that looks like the block
+// format itself, and any content with escape, is always written in it, even with Compression::none, so stored
+// files are never taken for something they are not.
+bool compress_file(const fs::path &source, TempFile &target, const CompressionPolicy &policy, bool escape = false);
+
+// Whether the data is in the compressed block format
+bool is_compressed(std::span<const std::byte> data);
+
+// Reads the logical content of a stored file, which may be compressed. Blocks are decompressed on demand, so a read
+// only touches the blocks it needs. A reader must not be used by several threads at once.
+class ContentReader {
+public:
+    // Maps the file
+    explicit ContentReader(const fs::path &file_path);
+    // owner keeps data valid for the lifetime of the reader, it may be nullptr, if the caller does. Data, that may
+    // not be compressed, is read as it is, whatever it looks like.
+    explicit ContentReader(std::span<const std::byte> data, std::shared_ptr<const void> owner = nullptr, bool may_be_compressed = true);
+
+    bool compressed() const { return m_compressed; }
+    std::uint64_t size() const { return m_size; }
+
+    // Copies content from offset to buffer, returns the number of bytes copied
+    size_t read(std::uint64_t offset, std::span<std::byte> buffer) const;
+    // Calls f for the content block by block, front to back
+    void for_each_block(const std::function<void(std::span<const std::byte>)> &f) const;
+    std::vector<std::byte> read_all() const;
+    bool equals(std::span<const std::byte> data) const;
+    Fingerprint fingerprint() const;
+private:
+    std::shared_ptr<const void> m_owner;
+    std::span<const std::byte> m_data;
+    bool m_compressed{false};
+    std::uint64_t m_size{0};
+    std::uint32_t m_block_size{0};
+    size_t m_block_count{0};
+    std::span<const std::byte> m_blocks; // compressed blocks, followed by their end offsets
+    mutable size_t m_cached_block{0};
+    mutable std::vector<std::byte> m_block;
+
+    std::span<const std::byte> block(size_t index) const;
+};
+
+} // namespace filestore
+
+#endif
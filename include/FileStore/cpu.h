@@ -0,0 +1,36 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_CPU_H
+#define FILESTORE_CPU_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FILESTORE_X86 1
+#endif
+
+// Enables instruction set extensions for a single function. MSVC allows intrinsics without special flags.
+#if defined(FILESTORE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FILESTORE_TARGET(features) __attribute__((target(features)))
+#else
+#define FILESTORE_TARGET(features)
+#endif
+
+namespace filestore {
+
+struct cpu_features {
+    bool ssse3{false};
+    bool sse41{false};
+    bool sse42{false};
+    bool avx2{false};
+    bool avx512f{false};
+    bool sha{false};
+};
+
+// Features of the CPU the program runs on, detected once on first use
+const cpu_features &cpu();
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,21 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_CRC32C_H
+#define FILESTORE_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace filestore {
+
+// CRC-32C (Castagnoli) checksum for detecting damaged metadata records. Uses the SSE4.2 instruction, if available.
+// Pass the result of a previous call as crc to continue a checksum.
+std::uint32_t crc32c(std::span<const std::byte> data, std::uint32_t crc = 0);
+
+} // namespace filestore
+
+#endif
@@ -6,8 +6,12 @@
 #ifndef FILESTORE_FILE_H
 #define FILESTORE_FILE_H
 
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace filestore {
 
@@ -22,8 +26,105 @@ private:
     fs::path path;
 };
 
+// Cheap summary of a file's contents: the size and a hash of the first and last 4 KiB. Different fingerprints
+// mean different contents, equal fingerprints do not prove equal contents.
+struct Fingerprint {
+    static constexpr std::uint64_t sample_size = 4096;
+
+    std::uint64_t size{0};
+    std::uint64_t sample_hash{0};
+
+    bool operator==(const Fingerprint &) const = default;
+};
+
+Fingerprint fingerprint_file(const fs::path &file_path);
+// The same fingerprint as for a file with this content
+Fingerprint fingerprint_data(std::span<const std::byte> data);
+
 bool files_have_same_size(const fs::path &path1, const fs::path &path2);
+// The bytes of the files are compared as they are; a compressed object (see compression.h) must be decoded first
 bool files_are_equal(const fs::path &existing_file, const fs::path &candidate_path);
+bool file_has_contents(const fs::path &file_path, std::span<const std::byte> data);
+std::vector<char> read_file(const fs::path &file_path);
+
+// How a file gets to its place in the store. If the file system does not support a mode, the next cheaper one
+// is used, down to a full copy.
+enum class TransferMode {
+    copy,        // read and write all data in user space
+    kernel_copy, // copy_file_range/sendfile, data stays in the kernel (and may be offloaded by the file system)
+    reflink,     // share the data blocks with the source (copy-on-write clone)
+    hardlink,    // link to the source inode; the source must not be modified afterwards
+    move,        // rename the source into the store; the source is gone afterwards
+};
+
+// A file written under a unique name, that is moved to its final place once it is complete. The file is removed
+// again, if it does not get committed.
+class TempFile {
+public:
+    explicit TempFile(const fs::path &directory);
+    ~TempFile();
+
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+
+    void write(std::span<const char> data);
+    // Closes the file, so it can be read through path()
+    void close();
+    // Moves the file to target. Missing parent directories are created.
+    void commit(const fs::path &target);
+    // Moves the file to target with publish_file. Returns false and keeps the file, if target exists.
+    bool try_commit(const fs::path &target);
+
+    const fs::path &path() const { return m_path; }
+private:
+    fs::path m_path;
+    std::ofstream m_stream;
+    bool m_committed{false};
+};
+
+// Creates target (which must not exist) with the contents of source. Returns the mode actually used.
+TransferMode transfer_file(const fs::path &source, const fs::path &target, TransferMode mode);
+
+// Moves source to target, unless target exists, in one step: other threads and processes see either no target or
+// the complete file, and of several publishing to the same target, exactly one succeeds. Returns false, if target
+// exists; source is kept then. Missing parent directories are created.
+bool publish_file(const fs::path &source, const fs::path &target);
+
+struct DirectoryFile {
+    fs::path path;
+    std::uint64_t inode{0}; // 0, where the platform does not report it
+};
+
+// The regular files below directory, in directory order. On Linux the directories are read with getdents64 in
+// large batches, and the inodes come with the entries without a stat per file. Symbolic links are not followed.
+// Subdirectories that cannot be read are added to unreadable, if given, and are an error otherwise.
+std::vector<DirectoryFile> list_files(const fs::path &directory, std::vector<fs::path> *unreadable = nullptr);
+// Asks the OS to start reading the file into the page cache (posix_fadvise WILLNEED), where it supports that
+void prefetch_file(const fs::path &file_path);
+
+// Removes many files: the directory of the files is kept open and they are unlinked relative to it (unlinkat), so
+// their paths are not resolved again for each one. Files should come grouped by directory.
+class FileRemover {
+public:
+    FileRemover() = default;
+    ~FileRemover();
+
+    FileRemover(const FileRemover &) = delete;
+    FileRemover &operator=(const FileRemover &) = delete;
+
+    // Returns false, if the file does not exist
+    bool remove(const fs::path &file_path);
+    // Where files were removed
+    const std::vector<fs::path> &directories() const { return m_directories; }
+private:
+    fs::path m_directory;
+    int m_directory_fd{-1};
+    std::vector<fs::path> m_directories;
+};
+
+// Removes those of the directories, that are empty, and then their parents below root, as long as they are empty.
+// Returns the number removed.
+size_t remove_empty_directories(std::vector<fs::path> directories, const fs::path &root);
 
 } // namespace filestore
 
@@ -6,63 +6,378 @@
 #ifndef FILESTORE_FILESTORE_H
 #define FILESTORE_FILESTORE_H
 
+#include "FileStore/async_io.h"
+#include "FileStore/catalog.h"
+#include "FileStore/chunking.h"
+#include "FileStore/compression.h"
+#include "FileStore/file.h"
+#include "FileStore/key.h"
+#include "FileStore/key_index.h"
+#include "FileStore/mapped_file.h"
+#include "FileStore/mapping_cache.h"
+#include "FileStore/metrics.h"
+#include "FileStore/pack.h"
 #include "FileStore/sha256.h"
+#include "FileStore/shard_layout.h"
+#include "FileStore/source_cache.h"
+#include "FileStore/store_config.h"
+#include "FileStore/thread_pool.h"
 #include <array>
+#include <atomic>
 #include <expected>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
 
 namespace filestore {
 
 namespace fs = std::filesystem;
 
-struct Key {
-    using distinguisher_type = std::uint32_t;
-    static constexpr auto hash_size = 32U;
-    static constexpr auto distinguisher_size = sizeof(distinguisher_type);
-    static constexpr auto bytelength = hash_size + distinguisher_size;
+struct StoreOptions {
+    int folder_levels{2};
+    TransferMode import_mode{TransferMode::copy};
+    // Keep all keys in memory instead of asking the file system. Only for stores without other writers.
+    bool key_index{false};
+    // Record all objects in a catalog file, so they can be listed without walking the directories. Only one process
+    // may use a store with a catalog at a time. A catalog that was not closed, e.g. after a crash, is rebuilt when
+    // the store is opened.
+    bool catalog{false};
+    // Skip reading source files that have the same path, size, modification time and inode as when they were
+    // last imported. Only safe, if sources are not modified without changing their modification time.
+    bool trust_source_cache{false};
+    // Operations in flight at once for import_async and read_async
+    unsigned io_queue_depth{64};
+    // Number of objects, that stay mapped after open, 0 for none
+    size_t mapping_cache_size{0};
+    // Objects smaller than this are appended to pack files instead of getting a file of their own, 0 for none.
+    // Packed objects have no path of their own; they are read through open and read_async.
+    std::uint64_t pack_threshold{0};
+    // Applied to objects with files of their own when they are added, whatever the import mode. Keys and
+    // comparisons are always based on the uncompressed content.
+    CompressionPolicy compression{};
+    // Files of at least chunking.min_file_size are split into chunks, each stored once for all objects that
+    // contain it. The object file is a manifest of the chunks then.
+    ChunkingPolicy chunking{};
+    // Used, when the store is created, and recorded in it. Stores opened later keep the recorded one.
+    StoreConfig config{};
+    // Split a directory into subdirectories by the next byte of the keys, once it holds more objects than this,
+    // so the depth of the objects grows with the store; folder_levels (at most 2) is the depth to start with. The
+    // layout is recorded in the store and used by all stores opened later, a store with fixed folder levels is
+    // converted. 0 keeps the recorded threshold, if any. Only for stores without writers in other processes.
+    std::uint64_t shard_split_threshold{0};
+};
 
-    std::array<std::byte, bytelength> data;
+struct ImportOptions {
+    size_t threads{0};         // 0: one per hardware thread
+    ThreadPool *pool{nullptr}; // run on an existing pool instead of starting threads
+};
 
-    distinguisher_type distinguisher() const {
-        distinguisher_type d;
-        std::memcpy(&d, data.data() + hash_size, distinguisher_size);
-        return d;
-    }
-    void update_distiguisher(distinguisher_type d) { std::memcpy(data.data() + hash_size, &d, distinguisher_size); }
-    bool increment() {
-        auto d = distinguisher();
-        if (d < std::numeric_limits<distinguisher_type>::max()) {
-            update_distiguisher(d + 1);
-            return true;
-        }
-        return false;
-    }
+struct TreeImportOptions {
+    size_t threads{0};         // 0: one per hardware thread
+    ThreadPool *pool{nullptr}; // run on an existing pool instead of starting threads
+    // Files the OS is asked to read ahead of the one being imported, 0 for none
+    size_t read_ahead{8};
 };
 
-inline bool operator==(const Key &k1, const Key &k2) {
-    return k1.data == k2.data;
-}
+struct TreeImportEntry {
+    fs::path path;
+    Key key;
+};
 
-std::string to_string(const Key &k);
+struct TreeImportReport {
+    std::vector<TreeImportEntry> added;      // files stored as new objects
+    std::vector<TreeImportEntry> duplicates; // files whose content was already stored
+    std::vector<fs::path> failed;            // files and directories that could not be read or imported
+};
+
+struct GcOptions {
+    size_t threads{0};         // 0: one per hardware thread
+    ThreadPool *pool{nullptr}; // run on an existing pool instead of starting threads
+    // Objects removed at once, while imports of keys with the same first byte wait
+    size_t batch_size{1024};
+};
+
+struct GcReport {
+    size_t objects_kept{0};
+    size_t objects_removed{0};
+    size_t chunks_removed{0};      // no longer used by any object
+    size_t directories_removed{0}; // shard directories left empty
+};
+
+struct ScrubOptions {
+    size_t threads{0};         // 0: one per hardware thread
+    ThreadPool *pool{nullptr}; // run on an existing pool instead of starting threads
+    // Content read per second by all threads together, 0 for no limit
+    std::uint64_t max_bytes_per_second{0};
+    // The progress is recorded in this file, so a scrub that was stopped continues where it left off. It is removed
+    // once all objects are checked. Empty for no checkpoints.
+    fs::path checkpoint_path{};
+    // Asked between batches of objects: the scrub stops, when it returns true
+    std::function<bool()> stop{};
+};
+
+struct ScrubReport {
+    size_t objects{0};             // checked by this scrub
+    std::uint64_t bytes{0};        // content read
+    std::vector<Key> mismatches;   // objects whose content does not match their key or cannot be read
+    std::vector<fs::path> orphans; // files in the store, that belong to no object
+    bool complete{false};          // false, if stopped before all objects were checked
+};
+
+// Contents of a stored object, mapped into memory (or decompressed)
+class ObjectView {
+public:
+    explicit ObjectView(std::shared_ptr<const MappedFile> mapping) : m_owner{mapping}, m_data{mapping->data()} {}
+    // Data kept valid by owner, e.g. a part of the mapping of a pack file
+    ObjectView(std::shared_ptr<const void> owner, std::span<const std::byte> data) : m_owner{std::move(owner)}, m_data{data} {}
+
+    std::span<const std::byte> data() const { return m_data; }
+    size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+private:
+    std::shared_ptr<const void> m_owner;
+    std::span<const std::byte> m_data;
+};
 
 class FileStore {
 public:
     using import_result = std::expected<Key, Key>;
 
     explicit FileStore(const fs::path &root_path, int folder_levels = 2);
+    FileStore(const fs::path &root_path, const StoreOptions &options);
 
     import_result import(const fs::path &file_path);
+    // Imports data that is not in a file, e.g. received over the network. It is hashed while it is written to the
+    // store, the keys are the same as for a file with this content.
+    import_result import(std::span<const std::byte> data);
+    import_result import(std::istream &input);
+    // Reads from the file descriptor (a file, pipe or socket) up to its end. The descriptor stays open.
+    import_result import_fd(int fd);
+    // Imports the files in parallel, the results are in input order. If a file cannot be imported, the other files
+    // are still processed and the first error (in input order) is rethrown afterwards.
+    std::vector<import_result> import_many(std::span<const fs::path> file_paths, const ImportOptions &options = {});
+    template<std::ranges::input_range R>
+        requires std::convertible_to<std::ranges::range_reference_t<R>, fs::path> && (!std::convertible_to<R, std::span<const fs::path>>)
+    std::vector<import_result> import_many(R &&file_paths, const ImportOptions &options = {}) {
+        std::vector<fs::path> paths;
+        for (auto &&path : file_paths)
+            paths.emplace_back(path);
+        return import_many(std::span<const fs::path>{paths}, options);
+    }
+
+    // Imports all regular files below directory in parallel. They are imported in the order of their inodes, which
+    // follows the order of their data on disk on most file systems, and the next ones are read ahead. A file that
+    // cannot be imported does not stop the others. The directory of the store is skipped, if it is in the tree.
+    TreeImportReport import_tree(const fs::path &directory, const TreeImportOptions &options = {});
+
+    // The file is read (and copied) in the background through io_uring, if available, so one thread can keep many
+    // imports in flight. The store must not be destroyed before the returned futures are ready.
+    std::future<import_result> import_async(const fs::path &file_path);
+    // Reads a stored object in the background
+    std::future<std::vector<char>> read_async(const Key &file_key) const;
+
+    // Maps a stored object into memory. Objects in the mapping cache are returned without a system call; the
+    // access pattern is only applied when an object is mapped.
+    ObjectView open(const Key &file_key, AccessPattern pattern = AccessPattern::normal) const;
+    // Reads a stored object in parts, at any offset. Compressed objects are only decompressed as far as needed.
+    ContentReader read(const Key &file_key) const;
+    // Calls f for the content of a stored object part by part, front to back. Chunked objects are not assembled.
+    void read_stream(const Key &file_key, const std::function<void(std::span<const std::byte>)> &f) const;
+
+    // Where the object has its own file. Packed objects do not have one.
     fs::path get_file_path(const Key &file_key) const;
+    bool is_packed(const Key &file_key) const { return m_packs && m_packs->contains(file_key); }
+
+    // Checks that the content of the object in [offset, offset + length) still matches its key. Objects keyed by a
+    // tree hash have their leaf hashes recorded, so only the leaves in the range are read; others are read whole.
+    bool verify(const Key &file_key, std::uint64_t offset = 0, std::uint64_t length = std::numeric_limits<std::uint64_t>::max()) const;
+    // Rehashes all objects in parallel, in the order of their keys, and compares the hashes to the keys. Can run
+    // while the store is used; objects added meanwhile may be missed.
+    ScrubReport scrub(const ScrubOptions &options = {}) const;
+
+    // Removes all objects that are not in roots, and the chunks that only they used (mark and sweep). Can run while
+    // the store is used: keys returned by imports through this store meanwhile are kept, even if their content was
+    // stored before, but imports through other stores on the root or in other processes are not protected.
+    // Packed objects leave garbage in their packs until repack.
+    GcReport collect_garbage(std::span<const Key> roots, const GcOptions &options = {});
+    // Removes the objects, returns the number of objects that were stored. Their chunks stay, until
+    // collect_garbage finds that no other object uses them.
+    size_t remove(std::span<const Key> keys);
+
+    // Splits all directories with more objects than the split threshold, e.g. after the threshold was lowered or
+    // a store with fixed folder levels was converted. Can run while the store is used. Does nothing for stores
+    // without adaptive sharding.
+    void reshard();
+
+    // Writes the key index, so the next FileStore on this root does not have to scan the directories
+    void save_key_index() const;
+
+    // Lists the objects from the catalog, if the store has one, by walking the directories otherwise
+    void for_each_object(const std::function<void(const CatalogEntry &)> &f) const;
+    size_t object_count() const;
+    // Recreates the catalog from the directories, e.g. after objects were added without it
+    void rebuild_catalog();
+    // Moves objects below the pack threshold, that have files of their own, into packs and rewrites packs of
+    // which at least min_garbage is taken by removed objects. Can run in a background thread while the store is
+    // used; open and read_async find the objects at their new places.
+    void repack(double min_garbage = 0.25);
 
     const fs::path &root_path() const { return m_root_path; }
+    const StoreConfig &config() const { return m_config; }
+    // Counters and latencies of the operations since the store was opened, shared by its copies. Empty, unless the
+    // library is built with metrics (see metrics_enabled).
+    MetricsSnapshot metrics() const { return m_metrics->snapshot(); }
 private:
+    using import_locks = std::array<std::mutex, 256>;
+    struct key_index_state {
+        std::once_flag loaded;
+        std::shared_mutex mutex;
+        KeyIndex keys;
+    };
+    struct shard_state {
+        std::unique_ptr<ShardLayout> layout;
+        std::shared_mutex mutex; // shared while publishing objects, exclusive while splitting a directory
+        std::mutex counts_mutex;
+        std::unordered_map<fs::path::string_type, std::uint64_t> counts; // objects per directory, counted on first use
+    };
+    struct gc_state {
+        // Imports hold the lock of the first byte of a key shared from looking it up until it is kept, collections
+        // exclusively while removing a batch of objects
+        std::array<std::shared_mutex, 256> locks;
+        std::mutex collection_mutex; // one collection at a time
+        std::atomic<bool> collecting{false};
+        std::mutex kept_mutex;
+        KeyIndex kept; // keys imports returned during the collection
+    };
+    struct async_state {
+        std::once_flag created;
+        std::unique_ptr<AsyncIo> io;
+    };
+
     fs::path m_root_path;
     int m_folder_levels{2};
+    StoreConfig m_config;
+    TransferMode m_import_mode{TransferMode::copy};
+    // serialize packing objects with the same hash prefix, so each gets its own distinguisher. Objects with files
+    // of their own need no lock, see add_object.
+    std::shared_ptr<import_locks> m_import_locks;
+    std::shared_ptr<key_index_state> m_key_index; // nullptr, if not used
+    std::shared_ptr<Catalog> m_catalog;           // nullptr, if not used
+    std::shared_ptr<SourceCache> m_source_cache;  // nullptr, if not used
+    std::shared_ptr<MappingCache> m_mapping_cache; // nullptr, if not used
+    std::shared_ptr<PackStore> m_packs;            // nullptr, if the store has no packs
+    std::uint64_t m_pack_threshold{0};
+    CompressionPolicy m_compression;
+    ChunkingPolicy m_chunking;
+    std::shared_ptr<FileStore> m_chunks; // nullptr, if the store has no chunked objects
+    std::shared_ptr<shard_state> m_shards; // nullptr for fixed folder levels
+    std::shared_ptr<gc_state> m_gc;
+    // Object files are only read in the compressed block format, once the store has objects in it (see
+    // compressed_marker_path), and as chunk manifests, if it has a chunk store. Content that looks like either one
+    // is escaped in the block format, whatever the policy, which marks the store then.
+    std::shared_ptr<std::atomic<bool>> m_compressed_objects;
+    unsigned m_io_queue_depth{64};
+    std::shared_ptr<Metrics> m_metrics;
+    std::shared_ptr<async_state> m_async; // last, so running requests are waited for before the rest is destroyed
+
+    fs::path metadata_path() const { return m_root_path / ".filestore"; }
+    fs::path temp_path() const { return metadata_path() / "tmp"; }
+    fs::path key_index_path() const { return metadata_path() / "keys.idx"; }
+    fs::path catalog_path() const { return metadata_path() / "catalog"; }
+    fs::path source_cache_path() const { return metadata_path() / "sources"; }
+    fs::path packs_path() const { return metadata_path() / "packs"; }
+    fs::path compressed_marker_path() const { return metadata_path() / "compressed"; }
+    fs::path chunks_path() const { return metadata_path() / "chunks"; }
+    fs::path config_path() const { return metadata_path() / "config"; }
+    fs::path shards_path() const { return metadata_path() / "shards"; }
+    fs::path leaves_path(const Key &k) const { return metadata_path() / "leaves" / KeyPath{k, m_folder_levels}.view(); }
 
+    int folder_levels(const Key &k) const { return m_shards ? m_shards->layout->depth(k) : m_folder_levels; }
+    std::uint64_t layout_version() const { return m_shards ? m_shards->layout->version() : 0; }
+    // Maps the file of an object, which may move into a subdirectory meanwhile
+    MappedFile map_object_file(const Key &k) const;
+    bool compressed_objects() const { return m_compressed_objects->load(std::memory_order_acquire); }
+    std::optional<ChunkManifest> parse_manifest(std::span<const std::byte> object_file) const {
+        return m_chunks ? ChunkManifest::parse(object_file) : std::nullopt;
+    }
+    void mark_compressed_objects();
+    // object files may be compressed or chunk manifests, so their sizes are not the sizes of the contents
+    bool encoded_objects() const { return m_chunks || compressed_objects(); }
+    ContentReader content_reader(std::span<const std::byte> object_file, std::shared_ptr<const void> owner = nullptr) const {
+        return ContentReader{object_file, std::move(owner), compressed_objects()};
+    }
+    // Size and, if sample is true, sample hash of the content of an object file
+    Fingerprint object_fingerprint(std::span<const std::byte> object_file, bool sample = true) const;
+    // The file is only read, if the sample hash is needed or the file may be encoded
+    CatalogEntry describe_object(const Key &key, const fs::directory_entry &file, std::int64_t import_time, bool fingerprint, bool may_be_encoded) const;
+    // The key of an object file found depth folders below the root, nullopt for other files
+    std::optional<Key> object_key(const fs::path &file_path, int depth) const;
+    // Counts a new object in its directory and splits that, once it holds more objects than the split threshold
+    void count_object(const Key &k);
+    // Links the objects into the subdirectories first, so they are found at either place until the split is recorded
+    void split_directory(std::span<const std::byte> prefix);
+    void reshard_directory(std::vector<std::byte> &prefix);
     bool key_exists(const Key &k) const;
+    key_index_state &key_index() const;
+    void scan_objects(const std::function<void(const CatalogEntry &)> &f, bool fingerprints = false) const;
+    void scan_files(const std::function<void(const CatalogEntry &)> &f, bool fingerprints) const;
+    // hash_file_content and hash_content with the config of the store, recorded in the metrics
+    ContentHash hash_file(const fs::path &file_path) const;
+    ContentHash hash_data(std::span<const std::byte> data) const;
+    import_result import_file(const fs::path &file_path);
+    // Looks the source up in the source cache, imports it with import_content and records the result otherwise
+    import_result import_source(const fs::path &file_path, const std::optional<SourceState> &state, const std::function<import_result()> &import_content);
+    std::optional<Key> cached_key(const fs::path &file_path, const SourceState &state) const;
+    void remember_source(const fs::path &file_path, const SourceState &state, const import_result &result);
+    AsyncIo &async_io() const;
+    import_result store_file(const fs::path &file_path, Key key);
+    import_result import_copy(const fs::path &file_path);
+    // Hashes the chunks while writing them to a temporary file, next_chunk returns an empty chunk at the end
+    import_result import_stream(const std::function<std::span<const char>()> &next_chunk);
+    // Finds the key for the content, stores it with store_object into a temporary file, if it is not yet known, and
+    // publishes that without replacing an object another store added meanwhile.
+    import_result add_object(Key key, const fs::path &content_path, const std::function<void(const fs::path &)> &store_object);
+    // Finds the key for content below the pack threshold and appends it to a pack, if it is not yet known
+    import_result add_packed(Key key, std::span<const std::byte> content);
+    bool object_equals(const Key &key, const fs::path &content_path, const Fingerprint &fingerprint) const;
+    bool object_equals(const Key &key, std::span<const std::byte> content, const Fingerprint &fingerprint) const;
+    void register_object(const CatalogEntry &entry);
+    // Records the leaf hashes of a new object with more than one leaf
+    import_result store_leaves(const import_result &result, const ContentHash &hash);
+    bool should_pack(std::uint64_t size) const { return m_packs && size < m_pack_threshold; }
+    bool should_chunk(std::uint64_t size) const { return m_chunks && m_chunking.min_file_size > 0 && size >= m_chunking.min_file_size; }
+    // Imports the chunks of the content into the chunk store and writes the manifest to object_path
+    void store_chunks(const fs::path &content_path, const Fingerprint &fingerprint, const fs::path &object_path);
+    const FileStore &chunk_store() const;
+    bool chunks_equal(const ChunkManifest &manifest, std::span<const std::byte> content) const;
+    std::vector<std::byte> assemble(const ChunkManifest &manifest) const;
+    std::mutex &import_lock(const Key &k) const { return (*m_import_locks)[std::to_integer<size_t>(k.data[0])]; }
+    std::shared_mutex &gc_lock(const Key &k) const { return m_gc->locks[std::to_integer<size_t>(k.data[0])]; }
+    // Protects a key an import returns from a collection running meanwhile; under the shared gc_lock of the key
+    void keep_key(const Key &k) const;
+    // Removes the objects not in live, the chunks of the others are added to live_chunks, if given
+    void sweep(const KeyIndex &live, const GcOptions &options, GcReport &report, KeyIndex *live_chunks);
+    // Removes what the store keeps about an object besides its file or pack entry
+    void forget_object(const Key &k);
+    size_t remove_empty_shards(std::vector<fs::path> directories);
 };
 
 Key generate_file_key(const fs::path &file_path);
+Key generate_key(std::span<const std::byte> data);
+Key generate_key(std::istream &input);
+// Keys of many files at once. Small files are hashed in parallel SIMD lanes, if the CPU supports it.
+std::vector<Key> generate_file_keys(std::span<const fs::path> file_paths);
+std::future<Key> generate_file_key_async(AsyncIo &io, const fs::path &file_path);
 
 } // namespace filestore
 
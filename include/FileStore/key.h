@@ -0,0 +1,79 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_KEY_H
+#define FILESTORE_KEY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace filestore {
+
+struct Key {
+    using distinguisher_type = std::uint32_t;
+    static constexpr auto hash_size = 32U;
+    static constexpr auto distinguisher_size = sizeof(distinguisher_type);
+    static constexpr auto bytelength = hash_size + distinguisher_size;
+    static constexpr auto string_length = 2 * bytelength;
+
+    std::array<std::byte, bytelength> data;
+
+    distinguisher_type distinguisher() const {
+        distinguisher_type d;
+        std::memcpy(&d, data.data() + hash_size, distinguisher_size);
+        return d;
+    }
+    void update_distiguisher(distinguisher_type d) { std::memcpy(data.data() + hash_size, &d, distinguisher_size); }
+    bool increment() {
+        auto d = distinguisher();
+        if (d < std::numeric_limits<distinguisher_type>::max()) {
+            update_distiguisher(d + 1);
+            return true;
+        }
+        return false;
+    }
+};
+
+inline bool operator==(const Key &k1, const Key &k2) {
+    return k1.data == k2.data;
+}
+
+// For unordered containers: keys start with a SHA256 hash, so their first bytes are used directly
+struct KeyHash {
+    size_t operator()(const Key &k) const {
+        size_t h;
+        std::memcpy(&h, k.data.data(), sizeof(h));
+        return h ^ k.distinguisher();
+    }
+};
+
+// Hex digits of the key, written to out without allocating memory
+void to_chars(const Key &k, std::span<char, Key::string_length> out);
+std::string to_string(const Key &k);
+// Parses the hex digits written by to_string
+std::optional<Key> from_string(std::string_view s);
+
+// Path of an object relative to the store root: a folder for each of the first folder_levels bytes of the key,
+// the remaining hex digits as file name. Rendered into a fixed buffer, so no memory is allocated.
+class KeyPath {
+public:
+    KeyPath(const Key &k, int folder_levels);
+
+    std::string_view view() const { return {m_buffer.data(), m_length}; }
+private:
+    std::array<char, Key::string_length + Key::bytelength> m_buffer;
+    size_t m_length{0};
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,50 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_KEY_INDEX_H
+#define FILESTORE_KEY_INDEX_H
+
+#include "FileStore/key.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// Set of keys in a flat table with open addressing (linear probing). Keys start with a SHA256 hash, so their first
+// bytes are used as hash value directly.
+class KeyIndex {
+public:
+    KeyIndex() = default;
+
+    bool contains(const Key &k) const;
+    // Returns false, if the key was already contained
+    bool insert(const Key &k);
+    // Returns false, if the key was not contained
+    bool erase(const Key &k);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear();
+
+    // Snapshot of all keys in a binary file
+    void save(const fs::path &file_path) const;
+    static KeyIndex load(const fs::path &file_path);
+private:
+    std::vector<Key> m_slots;
+    std::vector<std::uint8_t> m_used;
+    size_t m_size{0};
+
+    size_t find_slot(const Key &k) const;
+    void grow();
+    static std::uint64_t hash(const Key &k);
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,54 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_MAPPED_FILE_H
+#define FILESTORE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// How mapped data is going to be read, so the system can read ahead or not. Only a hint.
+enum class AccessPattern {
+    normal,
+    sequential, // front to back once: read ahead further and drop pages already read
+    random,     // no read-ahead
+    will_need,  // start reading all of it now
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path &file_path);
+    ~MappedFile();
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::span<const std::byte> data() const { return {m_data, m_size}; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    void advise(AccessPattern pattern) const;
+private:
+    const std::byte *m_data{nullptr};
+    size_t m_size{0};
+#if defined(_WIN32)
+    void *m_mapping{nullptr};
+#endif
+
+    void unmap();
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,45 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_MAPPING_CACHE_H
+#define FILESTORE_MAPPING_CACHE_H
+
+#include "FileStore/key.h"
+#include "FileStore/mapped_file.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace filestore {
+
+// The most recently used mappings of stored objects, so repeated reads of the same objects need no open and mmap.
+// Mappings handed out stay valid, when they are dropped from the cache.
+class MappingCache {
+public:
+    explicit MappingCache(size_t capacity) : m_capacity{capacity} {}
+
+    // nullptr, if the key is not cached
+    std::shared_ptr<const MappedFile> find(const Key &k);
+    // Drops the least recently used mapping, if the cache is full
+    void insert(const Key &k, std::shared_ptr<const MappedFile> mapping);
+    void erase(const Key &k);
+
+    size_t size() const;
+    size_t capacity() const { return m_capacity; }
+private:
+    using entry = std::pair<Key, std::shared_ptr<const MappedFile>>;
+
+    size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::list<entry> m_entries; // most recently used first
+    std::unordered_map<Key, std::list<entry>::iterator, KeyHash> m_index;
+};
+
+} // namespace filestore
+
+#endif
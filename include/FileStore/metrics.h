@@ -0,0 +1,138 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_METRICS_H
+#define FILESTORE_METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace filestore {
+
+// Metrics are only recorded, if the library is built with FILESTORE_METRICS. Otherwise all recording compiles to
+// nothing and snapshots stay empty.
+#if defined(FILESTORE_METRICS)
+inline constexpr bool metrics_enabled = true;
+#else
+inline constexpr bool metrics_enabled = false;
+#endif
+
+struct HistogramSnapshot {
+    // Bucket i holds the values of i bits, i.e. up to 2^i - 1; the last one all larger values as well
+    static constexpr size_t bucket_count = 40;
+    std::array<std::uint64_t, bucket_count> buckets{};
+    std::uint64_t count{0};
+    std::uint64_t sum{0};
+
+    static constexpr size_t bucket(std::uint64_t value) { return std::min<size_t>(std::bit_width(value), bucket_count - 1); }
+    static constexpr std::uint64_t upper_bound(size_t bucket) { return (std::uint64_t{1} << bucket) - 1; }
+};
+
+struct MetricsSnapshot {
+    HistogramSnapshot hash_time;           // nanoseconds hashing content for its key
+    HistogramSnapshot copy_time;           // nanoseconds of each write of content: streaming to a temporary file,
+                                           // or transferring, compressing, chunking or packing a new object
+    HistogramSnapshot compare_time;        // nanoseconds comparing content to a stored object with the same key
+    HistogramSnapshot distinguisher_steps; // keys skipped for each added content, as they hold other contents
+    std::uint64_t key_probes{0};           // lookups whether a key is stored
+    std::uint64_t bytes_hashed{0};
+    std::uint64_t bytes_stored{0};         // content of new objects
+
+    // Prometheus text format, with times in seconds
+    std::string to_prometheus() const;
+    std::string to_json() const;
+};
+
+// Counters of a FileStore (and its chunk store), updated by all threads that use it. Values are counted without
+// synchronizing them with each other, so a snapshot taken during imports may be off by the imports in flight.
+struct Metrics {
+    class Histogram {
+    public:
+        void record(std::uint64_t value) {
+            if constexpr (metrics_enabled) {
+                m_buckets[HistogramSnapshot::bucket(value)].fetch_add(1, std::memory_order_relaxed);
+                m_count.fetch_add(1, std::memory_order_relaxed);
+                m_sum.fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+        HistogramSnapshot snapshot() const;
+    private:
+        std::array<std::atomic<std::uint64_t>, HistogramSnapshot::bucket_count> m_buckets{};
+        std::atomic<std::uint64_t> m_count{0};
+        std::atomic<std::uint64_t> m_sum{0};
+    };
+
+    class Counter {
+    public:
+        void add(std::uint64_t n = 1) {
+            if constexpr (metrics_enabled)
+                m_value.fetch_add(n, std::memory_order_relaxed);
+        }
+        std::uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<std::uint64_t> m_value{0};
+    };
+
+    // Records the time it ran, from construction or in several parts between start and stop, when it is destroyed
+    class Timer {
+    public:
+        explicit Timer(Histogram &histogram, bool running = true) : m_histogram{histogram} {
+            if (running)
+                start();
+        }
+        ~Timer() {
+            stop();
+            if constexpr (metrics_enabled) {
+                if (m_measured)
+                    m_histogram.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(m_elapsed).count()));
+            }
+        }
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+        void start() {
+            if constexpr (metrics_enabled) {
+                m_start = clock::now();
+                m_running = true;
+            }
+        }
+        void stop() {
+            if constexpr (metrics_enabled) {
+                if (!m_running)
+                    return;
+                m_elapsed += clock::now() - m_start;
+                m_running = false;
+                m_measured = true;
+            }
+        }
+    private:
+        using clock = std::chrono::steady_clock;
+
+        Histogram &m_histogram;
+        clock::time_point m_start;
+        clock::duration m_elapsed{0};
+        bool m_running{false};
+        bool m_measured{false};
+    };
+
+    Histogram hash_time;
+    Histogram copy_time;
+    Histogram compare_time;
+    Histogram distinguisher_steps;
+    Counter key_probes;
+    Counter bytes_hashed;
+    Counter bytes_stored;
+
+    MetricsSnapshot snapshot() const;
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,107 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_PACK_H
+#define FILESTORE_PACK_H
+
+#include "FileStore/key.h"
+#include "FileStore/mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+struct PackLocation {
+    std::uint32_t pack{0};
+    std::uint64_t offset{0};
+    std::uint64_t size{0};
+    std::int64_t import_time{0}; // nanoseconds since the Unix epoch
+    std::uint32_t checksum{0};   // CRC-32C of the data
+};
+
+// Contents of a packed object. The data stays valid as long as the mapping is held.
+struct PackedObject {
+    std::shared_ptr<const MappedFile> mapping;
+    std::span<const std::byte> data;
+};
+
+// Small objects appended to large segment files, so storing one costs two appends instead of creating a file and
+// its directories. Each segment (pack-NNNNNN.pack) has an append-only index (pack-NNNNNN.idx) of checksummed
+// records; records torn by a crash are cut off when the packs are opened, like in the catalog. Changes are handed
+// to the file system before add and remove return, so they outlive a crash of the process. Objects are only ever
+// appended to the newest pack; removed objects leave garbage behind, until repack rewrites the pack.
+class PackStore {
+public:
+    static constexpr std::uint64_t default_pack_size = 256U << 20;
+
+    // Opens the packs in directory, creating it, if it does not exist. A new pack is started, once the newest one
+    // reaches max_pack_size.
+    explicit PackStore(const fs::path &directory, std::uint64_t max_pack_size = default_pack_size);
+
+    bool contains(const Key &k) const;
+    std::optional<PackLocation> find(const Key &k) const;
+    // nullopt, if the object is not packed
+    std::optional<PackedObject> read(const Key &k) const;
+
+    // The key must not be packed yet
+    void add(const Key &k, std::span<const std::byte> data, std::int64_t import_time);
+    // Returns false, if the object is not packed
+    bool remove(const Key &k);
+
+    // Calls f for each packed object, in no particular order. f must not change the packs.
+    void for_each(const std::function<void(const Key &, const PackLocation &)> &f) const;
+    size_t size() const;
+    size_t pack_count() const;
+
+    // Rewrites the full packs, of which at least min_garbage (a fraction of the file size) is taken by removed
+    // objects, into the newest pack. Readers and writers are only blocked while one pack is copied. Returns the
+    // number of packs rewritten.
+    size_t repack(double min_garbage = 0.25);
+    // Flushes the packs to the disk
+    void sync();
+
+    const fs::path &directory() const { return m_directory; }
+private:
+    struct pack {
+        std::uint64_t size{0};      // of the data file
+        std::uint64_t live_size{0}; // taken by objects in the index
+        mutable std::mutex mapping_mutex;
+        mutable std::shared_ptr<const MappedFile> mapping; // may be shorter than the data file
+    };
+
+    fs::path m_directory;
+    std::uint64_t m_max_pack_size;
+    mutable std::shared_mutex m_mutex;
+    std::map<std::uint32_t, std::unique_ptr<pack>> m_packs;
+    std::unordered_map<Key, PackLocation, KeyHash> m_index;
+    std::uint32_t m_active{0}; // the pack objects are appended to
+    mutable std::ofstream m_data_output; // flushed, before the newest pack is mapped
+    std::ofstream m_index_output;
+
+    fs::path data_path(std::uint32_t number) const;
+    fs::path index_path(std::uint32_t number) const;
+    void load(std::uint32_t number);
+    void start_pack(std::uint32_t number);
+    void append(const Key &k, std::span<const std::byte> data, std::int64_t import_time);
+    void flush_locked();
+    void sync_locked();
+    std::shared_ptr<const MappedFile> mapping(const pack &p, std::uint32_t number, std::uint64_t end) const;
+};
+
+} // namespace filestore
+
+#endif
@@ -9,6 +9,8 @@
 #include "FileStore/hash.h"
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <span>
 
 namespace filestore {
@@ -16,29 +18,53 @@ namespace filestore {
 class SHA256 {
 public:
     static constexpr auto hash_size = 256U;
+    static constexpr size_t block_size = 64; // bytes = 512 bit
     using hash_type = hash_value<hash_size>;
     using word = uint32_t;
 
-    SHA256();
-
-    void update(std::span<const char> data);
-    hash_type hash();
-private:
-    static constexpr size_t buffer_size = 64; // bytes = 512 bit
+    static constexpr word H0[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
     static constexpr word K[64] = {0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74,
                                    0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d,
                                    0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e,
                                    0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
                                    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
 
+    enum class Implementation {
+        generic, // portable C++ implementation
+        shani,   // x86 SHA extensions
+    };
+
+    SHA256();
+
+    void update(std::span<const char> data);
+    hash_type hash();
+
+    static bool is_supported(Implementation impl);
+    static Implementation implementation();
+    // Select the compression function used by all SHA256 instances. Returns false, if the CPU does not support it.
+    static bool use_implementation(Implementation impl);
+private:
+    static constexpr size_t buffer_size = block_size;
+
+    using compress_function = void (*)(word *state, const char *blocks, size_t num_blocks);
+
     std::array<word, 8> h;
-    std::array<word, 64> W;
+    std::array<char, buffer_size> buffer;
     size_t bytes_stored;
     uint64_t bytes_processed;
 
+    static std::atomic<compress_function> compress;
+
     void process_block();
+    void process_blocks(const char *blocks, size_t num_blocks);
     void finalize();
 
+    static void compress_dispatch(word *state, const char *blocks, size_t num_blocks);
+    static void compress_generic(word *state, const char *blocks, size_t num_blocks);
+    static void compress_shani(word *state, const char *blocks, size_t num_blocks);
+    static compress_function select_compress_function(Implementation impl);
+    static Implementation detect_implementation();
+
     size_t free_buffer_bytes() const { return buffer_size - bytes_stored; }
     bool buffer_full() const { return bytes_stored == buffer_size; }
 
@@ -0,0 +1,73 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_SHARD_LAYOUT_H
+#define FILESTORE_SHARD_LAYOUT_H
+
+#include "FileStore/key.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// The folder levels of the objects of a store whose directories are split as they grow. A split directory holds a
+// subdirectory for each value of the next byte of the keys instead of objects, so the depth of an object is the
+// length of the longest split prefix of its key plus one. The split prefixes are kept as a trie that is read
+// without a lock; splits are added under a lock and never undone.
+class ShardLayout {
+public:
+    // Prefixes of this length are not split further
+    static constexpr size_t max_depth = 16;
+
+    // All directories above folder_levels split, as in a store with fixed folder levels. Each split directory takes
+    // a node of 2 KiB, so at most max_initial_levels are allowed.
+    static constexpr int max_initial_levels = 2;
+    ShardLayout(int folder_levels, std::uint64_t split_threshold);
+    explicit ShardLayout(const fs::path &file_path);
+    ~ShardLayout();
+
+    ShardLayout(const ShardLayout &) = delete;
+    ShardLayout &operator=(const ShardLayout &) = delete;
+
+    int depth(const Key &k) const;
+    bool is_split(std::span<const std::byte> prefix) const;
+    // Records the split of the directory of prefix, whose parent must be split. Returns false, if it is split
+    // already or the prefix is max_depth long.
+    bool split(std::span<const std::byte> prefix);
+    // Incremented by each split, so a path resolved before can be told to be stale
+    std::uint64_t version() const { return m_version.load(std::memory_order_acquire); }
+
+    // Directories with more objects than this are split, 0 for none
+    std::uint64_t split_threshold() const { return m_split_threshold; }
+    void set_split_threshold(std::uint64_t threshold) { m_split_threshold = threshold; }
+
+    // A text file of "name value" lines: the threshold and the hex digits of each split prefix, parents first
+    void save(const fs::path &file_path) const;
+private:
+    struct Node {
+        std::array<std::atomic<Node *>, 256> children{};
+    };
+
+    std::atomic<Node *> m_root{nullptr}; // nullptr, if even the root directory holds the objects
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    std::atomic<std::uint64_t> m_version{0};
+    std::uint64_t m_split_threshold{0};
+    mutable std::mutex m_mutex; // for splits and saving
+
+    const Node *find(std::span<const std::byte> prefix) const;
+};
+
+} // namespace filestore
+
+#endif
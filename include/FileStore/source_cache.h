@@ -0,0 +1,68 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_SOURCE_CACHE_H
+#define FILESTORE_SOURCE_CACHE_H
+
+#include "FileStore/key.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// What identifies an unchanged source file, as far as the file system tells without reading it
+struct SourceState {
+    std::uint64_t size{0};
+    std::int64_t modification_time{0}; // nanoseconds since the Unix epoch
+    std::uint64_t device{0};
+    std::uint64_t inode{0}; // 0, if the platform has no inode numbers
+
+    bool operator==(const SourceState &) const = default;
+};
+
+// Keys of previously imported source files, by absolute path. A file is assumed to be unchanged, if its size,
+// modification time and inode are the same as when it was imported. Stored in an append-only file; the last
+// record for a path wins.
+class SourceCache {
+public:
+    // Opens the cache file, creating an empty one, if it does not exist
+    explicit SourceCache(const fs::path &file_path);
+
+    std::optional<Key> find(const fs::path &source, const SourceState &state) const;
+    void insert(const fs::path &source, const SourceState &state, const Key &key);
+    size_t size() const;
+
+    // Writes buffered records to the file system
+    void flush();
+
+    // nullopt, if the file cannot be examined
+    static std::optional<SourceState> describe(const fs::path &source);
+private:
+    struct Entry {
+        SourceState state;
+        Key key;
+    };
+
+    fs::path m_file_path;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::ofstream m_output;
+
+    void load();
+    void rewrite();
+    static std::string cache_path(const fs::path &source);
+};
+
+} // namespace filestore
+
+#endif
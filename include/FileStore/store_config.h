@@ -0,0 +1,66 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_STORE_CONFIG_H
+#define FILESTORE_STORE_CONFIG_H
+
+#include "FileStore/blake3.h"
+#include "FileStore/sha256.h"
+#include "FileStore/thread_pool.h"
+#include "FileStore/tree_hash.h"
+#include "FileStore/xxhash.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// Keys keep their size whatever the scheme: shorter hashes are padded with zeros
+enum class KeyScheme {
+    sha256,      // SHA256 of the content
+    sha256_tree, // root of a SHA256 tree over leaves of leaf_size bytes (see TreeHash), hashed in parallel
+    blake3,      // BLAKE3, several times faster than SHA256 with SIMD
+    xxh128,      // XXH3 with 128 bits, faster still, but not cryptographic: only for trusted data
+};
+
+// Settings that all keys of a store depend on, so they are fixed when the store is created
+struct StoreConfig {
+    KeyScheme key_scheme{KeyScheme::sha256};
+    std::uint32_t leaf_size{TreeHash::default_leaf_size};
+
+    bool operator==(const StoreConfig &) const = default;
+
+    // A text file of "name value" lines
+    void save(const fs::path &file_path) const;
+    static StoreConfig load(const fs::path &file_path);
+};
+
+struct ContentHash {
+    hash_value<256> hash;
+    std::vector<SHA256::hash_type> leaves; // only for the tree scheme
+};
+
+// Hashes content as the keys of a store with config are made
+class KeyHasher {
+public:
+    explicit KeyHasher(const StoreConfig &config);
+
+    void update(std::span<const char> data);
+    ContentHash hash();
+private:
+    std::variant<SHA256, TreeHash, Blake3, XXH3_128> m_hasher;
+};
+
+ContentHash hash_content(std::span<const std::byte> data, const StoreConfig &config, ThreadPool *pool = nullptr);
+ContentHash hash_file_content(const fs::path &file_path, const StoreConfig &config, ThreadPool *pool = nullptr);
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,93 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_THREAD_POOL_H
+#define FILESTORE_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace filestore {
+
+// Fixed set of worker threads, each with its own task queue. Tasks submitted from a worker go to that worker's
+// queue, idle workers steal from the others.
+class ThreadPool {
+public:
+    using task_type = std::function<void()>;
+
+    // 0 threads: one per hardware thread
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return m_workers.size(); }
+
+    void submit(task_type task);
+    // Blocks until all submitted tasks are finished. Rethrows the first exception thrown by a task.
+    // Must not be called from within a task. To wait for some of the tasks only, submit them with a TaskGroup.
+    void wait();
+private:
+    friend class TaskGroup;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_all_done;
+    std::atomic<size_t> m_queued{0};
+    std::atomic<size_t> m_pending{0};
+    std::atomic<size_t> m_next_queue{0};
+    bool m_stop{false};
+    std::exception_ptr m_exception;
+
+    void run(size_t index);
+    bool pop_task(size_t index, task_type &task);
+    void execute(task_type &task);
+    void finish_task();
+    bool is_current_worker() const;
+    // Runs a queued task on the calling worker; false, if there is none
+    bool run_queued_task();
+};
+
+// Tasks on a pool, that are waited for apart from the other tasks of the pool, so several calls can share a pool.
+// Waiting in a worker of the pool runs queued tasks meanwhile, so a task may wait for a group of its own.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool) : m_pool{pool} {}
+    // Waits for the tasks, their exceptions are dropped
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void submit(ThreadPool::task_type task);
+    // Blocks until the tasks of the group are finished. Rethrows the first exception thrown by one of them.
+    void wait();
+private:
+    ThreadPool &m_pool;
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    size_t m_pending{0};
+    std::exception_ptr m_exception;
+};
+
+} // namespace filestore
+
+#endif
@@ -0,0 +1,59 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_TREE_HASH_H
+#define FILESTORE_TREE_HASH_H
+
+#include "FileStore/sha256.h"
+#include "FileStore/thread_pool.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace filestore {
+
+namespace fs = std::filesystem;
+
+// SHA256 tree hash: the content is split into leaves of leaf_size bytes, which are hashed independently, and the
+// leaf hashes are combined pairwise up to a single root (an odd hash is carried up unchanged). Leaves and inner
+// nodes get different prefixes, so a leaf cannot pass for a node.
+class TreeHash {
+public:
+    using hash_type = SHA256::hash_type;
+    static constexpr std::uint32_t default_leaf_size = 1U << 20;
+
+    explicit TreeHash(std::uint32_t leaf_size = default_leaf_size);
+
+    void update(std::span<const char> data);
+    // The root. leaves() is complete afterwards.
+    hash_type hash();
+    const std::vector<hash_type> &leaves() const { return m_leaves; }
+
+    static hash_type hash_leaf(std::span<const std::byte> data);
+    static hash_type root(std::span<const hash_type> leaves);
+private:
+    std::uint32_t m_leaf_size;
+    SHA256 m_leaf;
+    std::uint64_t m_leaf_bytes{0};
+    std::vector<hash_type> m_leaves;
+
+    void finish_leaf();
+};
+
+struct TreeHashResult {
+    TreeHash::hash_type root;
+    std::vector<TreeHash::hash_type> leaves;
+};
+
+// Hashes the leaves in parallel, on pool and the calling thread. Without a pool, data of a few leaves is hashed on
+// the calling thread only, more on a pool shared by all such calls.
+TreeHashResult tree_hash(std::span<const std::byte> data, std::uint32_t leaf_size, ThreadPool *pool = nullptr);
+TreeHashResult tree_hash_file(const fs::path &file_path, std::uint32_t leaf_size, ThreadPool *pool = nullptr);
+
+} // namespace filestore
+
+#endif
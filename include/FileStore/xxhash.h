@@ -0,0 +1,48 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_XXHASH_H
+#define FILESTORE_XXHASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace filestore {
+
+// XXH64: fast non-cryptographic hash, for fingerprints and sampling, not for keys
+std::uint64_t xxh64(std::span<const std::byte> data, std::uint64_t seed = 0);
+
+struct xxh128_hash {
+    std::uint64_t low;
+    std::uint64_t high;
+
+    bool operator==(const xxh128_hash &) const = default;
+};
+
+// XXH3 with 128 bit output (default secret, no seed), for keys of trusted data only: it is not collision resistant
+// against deliberately crafted content
+xxh128_hash xxh3_128(std::span<const std::byte> data);
+
+class XXH3_128 {
+public:
+    XXH3_128();
+
+    void update(std::span<const char> data);
+    xxh128_hash hash() const;
+private:
+    static constexpr size_t block_size = 1024; // 16 stripes of 64 bytes, after which the accumulators are scrambled
+
+    std::array<std::uint64_t, 8> m_acc;
+    // the last 64 bytes of the data already consumed, followed by up to a block of data not yet consumed
+    std::array<std::byte, 64 + block_size> m_buffer{};
+    size_t m_buffered{0};
+    std::uint64_t m_length{0};
+};
+
+} // namespace filestore
+
+#endif
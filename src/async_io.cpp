@@ -0,0 +1,491 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/async_io.h"
+#include "FileStore/file.h"
+
+#include <algorithm>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// File opened for positional reads or writes. Results are byte counts or negative error numbers.
+class File {
+public:
+    static std::shared_ptr<File> open_read(const fs::path &path) {
+#if defined(_WIN32)
+        return open(::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+#else
+        return open(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+#endif
+    }
+
+    static std::shared_ptr<File> open_write(const fs::path &path) {
+#if defined(_WIN32)
+        return open(::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+#else
+        return open(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+#endif
+    }
+
+#if defined(_WIN32)
+    explicit File(HANDLE handle) : m_handle{handle} {}
+    ~File() { ::CloseHandle(m_handle); }
+
+    std::uint64_t size() const {
+        LARGE_INTEGER size;
+        return ::GetFileSizeEx(m_handle, &size) ? static_cast<std::uint64_t>(size.QuadPart) : 0;
+    }
+
+    std::int64_t read(char *data, size_t length, std::uint64_t offset) const {
+        DWORD transferred = 0;
+        OVERLAPPED position = overlapped(offset);
+        if (!::ReadFile(m_handle, data, static_cast<DWORD>(length), &transferred, &position))
+            return ::GetLastError() == ERROR_HANDLE_EOF ? 0 : -EIO;
+        return transferred;
+    }
+
+    std::int64_t write(const char *data, size_t length, std::uint64_t offset) const {
+        DWORD transferred = 0;
+        OVERLAPPED position = overlapped(offset);
+        if (!::WriteFile(m_handle, data, static_cast<DWORD>(length), &transferred, &position))
+            return -EIO;
+        return transferred;
+    }
+#else
+    explicit File(int fd) : m_fd{fd} {}
+    ~File() { ::close(m_fd); }
+
+    int fd() const { return m_fd; }
+
+    std::uint64_t size() const {
+        struct stat status;
+        return ::fstat(m_fd, &status) == 0 ? static_cast<std::uint64_t>(status.st_size) : 0;
+    }
+
+    std::int64_t read(char *data, size_t length, std::uint64_t offset) const {
+        const auto result = ::pread(m_fd, data, length, static_cast<off_t>(offset));
+        return result < 0 ? -errno : result;
+    }
+
+    std::int64_t write(const char *data, size_t length, std::uint64_t offset) const {
+        const auto result = ::pwrite(m_fd, data, length, static_cast<off_t>(offset));
+        return result < 0 ? -errno : result;
+    }
+#endif
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+private:
+#if defined(_WIN32)
+    HANDLE m_handle;
+
+    static std::shared_ptr<File> open(HANDLE handle) { return handle == INVALID_HANDLE_VALUE ? nullptr : std::make_shared<File>(handle); }
+    static OVERLAPPED overlapped(std::uint64_t offset) {
+        OVERLAPPED result{};
+        result.Offset = static_cast<DWORD>(offset);
+        result.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        return result;
+    }
+#else
+    int m_fd;
+
+    static std::shared_ptr<File> open(int fd) { return fd < 0 ? nullptr : std::make_shared<File>(fd); }
+#endif
+};
+
+} // namespace
+
+struct AsyncIo::Operation {
+    enum Kind { read, write, wake };
+
+    Kind kind{read};
+    std::shared_ptr<File> file;
+    char *data{nullptr};
+    size_t length{0};
+    std::uint64_t offset{0};
+    std::function<void(std::int64_t)> on_complete;
+#if defined(__linux__)
+    iovec buffer{};
+#endif
+
+    std::int64_t run() const { return kind == read ? file->read(data, length, offset) : file->write(data, length, offset); }
+};
+
+// A file read (and written) chunk by chunk, with one operation in flight at a time
+struct AsyncIo::Transfer {
+    fs::path source_path;
+    fs::path target_path;
+    std::shared_ptr<File> source;
+    std::shared_ptr<File> target; // nullptr, if only reading
+    data_handler on_data;
+    done_handler on_done;
+
+    std::unique_ptr<char[]> buffer;
+    size_t buffer_size{0};
+    std::uint64_t size{0}; // when the transfer started
+    std::uint64_t offset{0};
+    size_t length{0};  // of the current chunk
+    size_t written{0}; // of the current chunk
+    bool writing{false};
+};
+
+#if defined(__linux__)
+// Submission and completion queues shared with the kernel, set up without liburing. Submissions must be
+// serialized by the caller, completions are only consumed by one thread.
+class AsyncIo::Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params{};
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        m_entries = params.sq_entries;
+
+        m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        m_sq = map(m_sq_size, IORING_OFF_SQ_RING);
+        m_cq = map(m_cq_size, IORING_OFF_CQ_RING);
+        m_sqes = static_cast<io_uring_sqe *>(map(m_sqes_size, IORING_OFF_SQES));
+        if (m_sq == nullptr || m_cq == nullptr || m_sqes == nullptr) {
+            const auto error = errno;
+            release();
+            throw std::system_error(error, std::system_category(), "io_uring mmap");
+        }
+
+        const auto sq = static_cast<char *>(m_sq);
+        m_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        const auto cq = static_cast<char *>(m_cq);
+        m_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+    ~Ring() { release(); }
+
+    unsigned entries() const { return m_entries; }
+
+    void submit(const io_uring_sqe &sqe) {
+        const auto tail = *m_sq_tail;
+        const auto index = tail & m_sq_mask;
+        m_sqes[index] = sqe;
+        m_sq_array[index] = index;
+        std::atomic_ref{*m_sq_tail}.store(tail + 1, std::memory_order_release);
+        // every call submits the entry just added, so the queue never fills up
+        while (enter(1, 0, 0) < 0) {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                throw std::system_error(errno, std::system_category(), "io_uring_enter");
+        }
+    }
+
+    // Waits for at least one completion and calls f(user_data, result) for each available one
+    template<typename F>
+    void wait(F &&f) {
+        auto head = *m_cq_head;
+        auto tail = std::atomic_ref{*m_cq_tail}.load(std::memory_order_acquire);
+        while (head == tail) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                throw std::system_error(errno, std::system_category(), "io_uring_enter");
+            tail = std::atomic_ref{*m_cq_tail}.load(std::memory_order_acquire);
+        }
+        for (; head != tail; ++head) {
+            const auto &cqe = m_cqes[head & m_cq_mask];
+            const auto user_data = cqe.user_data;
+            const auto result = cqe.res;
+            std::atomic_ref{*m_cq_head}.store(head + 1, std::memory_order_release);
+            f(user_data, result);
+        }
+    }
+private:
+    int m_fd{-1};
+    unsigned m_entries{0};
+    void *m_sq{nullptr};
+    void *m_cq{nullptr};
+    io_uring_sqe *m_sqes{nullptr};
+    size_t m_sq_size{0};
+    size_t m_cq_size{0};
+    size_t m_sqes_size{0};
+    unsigned *m_sq_tail{nullptr};
+    unsigned *m_sq_array{nullptr};
+    unsigned m_sq_mask{0};
+    unsigned *m_cq_head{nullptr};
+    unsigned *m_cq_tail{nullptr};
+    unsigned m_cq_mask{0};
+    io_uring_cqe *m_cqes{nullptr};
+
+    void *map(size_t size, std::uint64_t offset) const {
+        void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, static_cast<off_t>(offset));
+        return data == MAP_FAILED ? nullptr : data;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) const {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, m_fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    void release() {
+        if (m_sqes != nullptr)
+            ::munmap(m_sqes, m_sqes_size);
+        if (m_cq != nullptr)
+            ::munmap(m_cq, m_cq_size);
+        if (m_sq != nullptr)
+            ::munmap(m_sq, m_sq_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+};
+#else
+class AsyncIo::Ring {};
+#endif
+
+AsyncIo::AsyncIo([[maybe_unused]] Backend backend, unsigned queue_depth, size_t threads) : m_pool{threads}, m_queue_depth{std::max(1U, queue_depth)} {
+#if defined(__linux__)
+    if (backend == Backend::io_uring) {
+        try {
+            m_ring = std::make_unique<Ring>(m_queue_depth);
+            m_queue_depth = std::min(m_queue_depth, m_ring->entries());
+            m_completion_thread = std::thread{[this]() { run_completions(); }};
+        } catch (const std::system_error &) {
+            m_ring.reset(); // not supported by the kernel or not permitted
+        }
+    }
+#endif
+}
+
+AsyncIo::~AsyncIo() {
+    try {
+        wait();
+    } catch (...) {
+    }
+    if (m_completion_thread.joinable()) {
+        auto stop = std::make_unique<Operation>();
+        stop->kind = Operation::wake;
+        submit(std::move(stop));
+        m_completion_thread.join();
+    }
+}
+
+void AsyncIo::read_file(const fs::path &path, data_handler on_data, done_handler on_done) {
+    auto transfer = std::make_shared<Transfer>();
+    transfer->source_path = path;
+    transfer->on_data = std::move(on_data);
+    transfer->on_done = std::move(on_done);
+    start_transfer(std::move(transfer));
+}
+
+void AsyncIo::copy_file(const fs::path &source, const fs::path &target, data_handler on_data, done_handler on_done) {
+    auto transfer = std::make_shared<Transfer>();
+    transfer->source_path = source;
+    transfer->target_path = target;
+    transfer->on_data = std::move(on_data);
+    transfer->on_done = std::move(on_done);
+    start_transfer(std::move(transfer));
+}
+
+void AsyncIo::post(std::function<void()> task) {
+    add_pending();
+    m_pool.submit([this, task = std::move(task)]() {
+        run_handler(task);
+        finish_pending();
+    });
+}
+
+void AsyncIo::wait() {
+    std::unique_lock lock{m_mutex};
+    m_all_done.wait(lock, [this]() { return m_pending == 0; });
+    if (m_exception)
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+}
+
+// A transfer is pending from here until its done handler returned
+void AsyncIo::start_transfer(std::shared_ptr<Transfer> transfer) {
+    add_pending();
+    transfer->source = File::open_read(transfer->source_path);
+    if (transfer->source && !transfer->target_path.empty())
+        transfer->target = File::open_write(transfer->target_path);
+
+    if (!transfer->source || (!transfer->target_path.empty() && !transfer->target)) {
+        const auto error = std::make_exception_ptr(transfer->source ? FileError{"Could not create file", transfer->target_path}
+                                                                    : FileError{"Could not open file", transfer->source_path});
+        m_pool.submit([this, transfer, error]() {
+            run_handler([&]() { transfer->on_done(error); });
+            finish_pending();
+        });
+        return;
+    }
+
+    // small files get a small buffer, and are done without reading the end of the file separately
+    transfer->size = transfer->source->size();
+    transfer->buffer_size = static_cast<size_t>(std::clamp<std::uint64_t>(transfer->size, 4096, chunk_size));
+    transfer->buffer = std::make_unique_for_overwrite<char[]>(transfer->buffer_size);
+
+    auto read = std::make_unique<Operation>();
+    read->file = transfer->source;
+    read->data = transfer->buffer.get();
+    read->length = transfer->buffer_size;
+    read->on_complete = [this, transfer](std::int64_t result) { continue_transfer(transfer, result); };
+    submit(std::move(read));
+}
+
+void AsyncIo::continue_transfer(std::shared_ptr<Transfer> transfer, std::int64_t result) {
+    std::exception_ptr error;
+    if (!transfer->writing) {
+        if (result < 0)
+            error = std::make_exception_ptr(FileError{"Error reading input file", transfer->source_path});
+        else if (result > 0) {
+            transfer->length = static_cast<size_t>(result);
+            transfer->written = 0;
+            try {
+                transfer->on_data({transfer->buffer.get(), transfer->length});
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        if (error || result == 0) {
+            run_handler([&]() { transfer->on_done(error); });
+            finish_pending();
+            return;
+        }
+        transfer->writing = transfer->target != nullptr;
+    } else {
+        if (result <= 0) {
+            const auto write_error = std::make_exception_ptr(FileError{"Error writing file", transfer->target_path});
+            run_handler([&]() { transfer->on_done(write_error); });
+            finish_pending();
+            return;
+        }
+        transfer->written += static_cast<size_t>(result);
+        transfer->writing = transfer->written < transfer->length;
+    }
+
+    auto next = std::make_unique<Operation>();
+    if (transfer->writing) {
+        next->kind = Operation::write;
+        next->file = transfer->target;
+        next->data = transfer->buffer.get() + transfer->written;
+        next->length = transfer->length - transfer->written;
+        next->offset = transfer->offset + transfer->written;
+    } else {
+        transfer->offset += transfer->length;
+        if (transfer->offset >= transfer->size) { // no extra read to find the end, if the file did not grow
+            run_handler([&]() { transfer->on_done(nullptr); });
+            finish_pending();
+            return;
+        }
+        next->file = transfer->source;
+        next->data = transfer->buffer.get();
+        next->length = transfer->buffer_size;
+        next->offset = transfer->offset;
+    }
+    next->on_complete = [this, transfer](std::int64_t result) { continue_transfer(transfer, result); };
+    submit(std::move(next));
+}
+
+void AsyncIo::submit(std::unique_ptr<Operation> operation) {
+    if (!m_ring) {
+        m_pool.submit([operation = std::shared_ptr<Operation>(std::move(operation))]() {
+            operation->on_complete(operation->run());
+        });
+        return;
+    }
+
+    std::lock_guard lock{m_submit_mutex};
+    if (m_in_flight < m_queue_depth)
+        submit_to_ring(std::move(operation));
+    else
+        m_backlog.push_back(std::move(operation));
+}
+
+// Called with m_submit_mutex held
+void AsyncIo::submit_to_ring([[maybe_unused]] std::unique_ptr<Operation> operation) {
+#if defined(__linux__)
+    io_uring_sqe sqe{};
+    if (operation->kind == Operation::wake) {
+        sqe.opcode = IORING_OP_NOP;
+    } else {
+        // readv/writev with a single buffer are supported by all io_uring kernels
+        operation->buffer = {operation->data, operation->length};
+        sqe.opcode = operation->kind == Operation::read ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe.fd = operation->file->fd();
+        sqe.addr = reinterpret_cast<std::uint64_t>(&operation->buffer);
+        sqe.len = 1;
+        sqe.off = operation->offset;
+    }
+    sqe.user_data = reinterpret_cast<std::uint64_t>(operation.get());
+    m_ring->submit(sqe);
+    operation.release(); // owned by the kernel until it completes
+    ++m_in_flight;
+#endif
+}
+
+void AsyncIo::run_completions() {
+#if defined(__linux__)
+    bool stop = false;
+    while (!stop) {
+        m_ring->wait([this, &stop](std::uint64_t user_data, std::int32_t result) {
+            std::unique_ptr<Operation> operation{reinterpret_cast<Operation *>(user_data)};
+            {
+                std::lock_guard lock{m_submit_mutex};
+                --m_in_flight;
+                while (!m_backlog.empty() && m_in_flight < m_queue_depth) {
+                    submit_to_ring(std::move(m_backlog.front()));
+                    m_backlog.pop_front();
+                }
+            }
+            if (operation->kind == Operation::wake) {
+                stop = true;
+                return;
+            }
+            m_pool.submit([operation = std::shared_ptr<Operation>(std::move(operation)), result]() { operation->on_complete(result); });
+        });
+    }
+#endif
+}
+
+void AsyncIo::run_handler(const std::function<void()> &handler) {
+    try {
+        handler();
+    } catch (...) {
+        std::lock_guard lock{m_mutex};
+        if (!m_exception)
+            m_exception = std::current_exception();
+    }
+}
+
+void AsyncIo::add_pending() {
+    std::lock_guard lock{m_mutex};
+    ++m_pending;
+}
+
+void AsyncIo::finish_pending() {
+    std::lock_guard lock{m_mutex};
+    if (--m_pending == 0)
+        m_all_done.notify_all();
+}
+
+} // namespace filestore
@@ -0,0 +1,120 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/bin_utils.h"
+#include "FileStore/cpu.h"
+
+#include <cstdint>
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// Value of every hex digit, -1 for other characters
+constexpr auto hex_values = []() {
+    std::array<std::int8_t, 256> values{};
+    values.fill(-1);
+    for (int i = 0; i < 10; ++i)
+        values['0' + i] = static_cast<std::int8_t>(i);
+    for (int i = 0; i < 6; ++i)
+        values['a' + i] = static_cast<std::int8_t>(10 + i);
+    return values;
+}();
+
+void hex_encode_generic(const std::byte *bytes, size_t size, char *out) {
+    for (size_t i = 0; i < size; ++i) {
+        const auto &digits = hex_table[std::to_integer<size_t>(bytes[i])];
+        out[2 * i] = digits[0];
+        out[2 * i + 1] = digits[1];
+    }
+}
+
+bool hex_decode_generic(const char *hex, size_t size, std::byte *bytes) {
+    for (size_t i = 0; i < size; ++i) {
+        const auto high = hex_values[static_cast<unsigned char>(hex[2 * i])];
+        const auto low = hex_values[static_cast<unsigned char>(hex[2 * i + 1])];
+        if ((high | low) < 0)
+            return false;
+        bytes[i] = static_cast<std::byte>(high << 4 | low);
+    }
+    return true;
+}
+
+#if defined(FILESTORE_X86)
+// 16 bytes at a time: the nibbles are looked up in a register with pshufb and interleaved
+FILESTORE_TARGET("ssse3")
+size_t hex_encode_ssse3(const std::byte *bytes, size_t size, char *out) {
+    const auto digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const auto nibble_mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+        const auto high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(value, 4), nibble_mask));
+        const auto low = _mm_shuffle_epi8(digits, _mm_and_si128(value, nibble_mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+// Digit values of 16 characters; all bits of invalid is set for characters, that are no hex digits
+FILESTORE_TARGET("ssse3")
+__m128i hex_digit_values(__m128i chars, __m128i &invalid) {
+    const auto is_digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const auto is_letter = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('f' + 1)));
+    invalid = _mm_or_si128(invalid, _mm_xor_si128(_mm_or_si128(is_digit, is_letter), _mm_set1_epi8(-1)));
+    const auto digit_values = _mm_and_si128(is_digit, _mm_sub_epi8(chars, _mm_set1_epi8('0')));
+    const auto letter_values = _mm_and_si128(is_letter, _mm_sub_epi8(chars, _mm_set1_epi8('a' - 10)));
+    return _mm_or_si128(digit_values, letter_values);
+}
+
+// 32 digits at a time: pairs of digit values are combined to 16*high + low with pmaddubsw
+FILESTORE_TARGET("ssse3")
+size_t hex_decode_ssse3(const char *hex, size_t size, std::byte *bytes, bool &valid) {
+    const auto weights = _mm_set1_epi16(0x0110); // 16 for the high digit (first byte), 1 for the low one
+    auto invalid = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const auto first = hex_digit_values(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hex + 2 * i)), invalid);
+        const auto second = hex_digit_values(_mm_loadu_si128(reinterpret_cast<const __m128i *>(hex + 2 * i + 16)), invalid);
+        const auto combined = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + i), combined);
+    }
+    valid = _mm_movemask_epi8(invalid) == 0;
+    return i;
+}
+#endif
+
+} // namespace
+
+void hex_encode(std::span<const std::byte> bytes, char *out) {
+    size_t done = 0;
+#if defined(FILESTORE_X86)
+    if (cpu().ssse3)
+        done = hex_encode_ssse3(bytes.data(), bytes.size(), out);
+#endif
+    hex_encode_generic(bytes.data() + done, bytes.size() - done, out + 2 * done);
+}
+
+bool hex_decode(std::string_view hex, std::span<std::byte> bytes) {
+    if (hex.size() != 2 * bytes.size())
+        return false;
+    size_t done = 0;
+#if defined(FILESTORE_X86)
+    if (cpu().ssse3) {
+        bool valid;
+        done = hex_decode_ssse3(hex.data(), bytes.size(), bytes.data(), valid);
+        if (!valid)
+            return false;
+    }
+#endif
+    return hex_decode_generic(hex.data() + 2 * done, bytes.size() - done, bytes.data() + done);
+}
+
+} // namespace filestore
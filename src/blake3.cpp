@@ -0,0 +1,271 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/blake3.h"
+#include "FileStore/cpu.h"
+#include "blake3_lanes.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace filestore {
+
+namespace {
+
+using word = Blake3::word;
+constexpr auto block_size = Blake3::block_size;
+constexpr auto chunk_size = Blake3::chunk_size;
+
+// Chunks hashed at once, before they are merged to subtrees
+constexpr size_t max_batch_chunks = 256;
+
+word load_little_endian(const std::byte *data) {
+    word value;
+    std::memcpy(&value, data, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big)
+        return std::byteswap(value);
+    else
+        return value;
+}
+
+// The first 8 words are the chaining value of the block, all 16 are the extended output
+std::array<word, 16> compress(const word *cv, const word *m, std::uint64_t counter, word block_length, word flags) {
+    std::array<word, 16> v{cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7], Blake3::IV[0], Blake3::IV[1], Blake3::IV[2], Blake3::IV[3],
+                           static_cast<word>(counter), static_cast<word>(counter >> 32), block_length, flags};
+    // a lambda, so it is inlined and v stays in registers
+    const auto g = [](word &a, word &b, word &c, word &d, word x, word y) {
+        a = a + b + x;
+        d = std::rotr(d ^ a, 16);
+        c = c + d;
+        b = std::rotr(b ^ c, 12);
+        a = a + b + y;
+        d = std::rotr(d ^ a, 8);
+        c = c + d;
+        b = std::rotr(b ^ c, 7);
+    };
+    for (const auto &s : Blake3::message_schedule) {
+        g(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+        g(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+        g(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+        g(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+        g(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+        g(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        g(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+        g(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        v[i] ^= v[i + 8];
+        v[i + 8] ^= cv[i];
+    }
+    return v;
+}
+
+std::array<word, 16> block_words(const std::byte *block) {
+    std::array<word, 16> m;
+    for (int t = 0; t < 16; ++t)
+        m[t] = load_little_endian(block + 4 * t);
+    return m;
+}
+
+void hash_chunk(const std::byte *chunk, std::uint64_t counter, word *cv) {
+    std::copy(std::begin(Blake3::IV), std::end(Blake3::IV), cv);
+    for (size_t block = 0; block < chunk_size / block_size; ++block) {
+        const word flags = (block == 0 ? static_cast<word>(Blake3::chunk_start) : word{0}) |
+                           (block + 1 == chunk_size / block_size ? static_cast<word>(Blake3::chunk_end) : word{0});
+        const auto output = compress(cv, block_words(chunk + block * block_size).data(), counter, block_size, flags);
+        std::copy_n(output.begin(), 8, cv);
+    }
+}
+
+// Hashes count inputs, found one after the other at data, to the chaining values at cvs: chunks with the counters
+// counter, counter + 1, ..., or parent nodes. The inputs may overlap cvs, as long as cvs does not start after them.
+void hash_many(const std::byte *data, size_t count, bool parents, std::uint64_t counter, word *cvs) {
+    using lanes_function = void (*)(const std::byte *, bool, std::uint64_t, std::uint32_t *);
+    lanes_function hash_lanes = nullptr;
+    size_t lanes = 1;
+#if defined(FILESTORE_X86)
+    switch (Blake3::implementation()) {
+    case Blake3::Implementation::avx2:
+        hash_lanes = &blake3_lanes::hash_many_avx2;
+        lanes = 8;
+        break;
+    case Blake3::Implementation::avx512:
+        hash_lanes = &blake3_lanes::hash_many_avx512;
+        lanes = 16;
+        break;
+    case Blake3::Implementation::generic:
+        break;
+    }
+#endif
+
+    const size_t input_size = parents ? block_size : chunk_size;
+    for (; hash_lanes && count >= lanes; count -= lanes, data += lanes * input_size, counter += lanes, cvs += 8 * lanes)
+        hash_lanes(data, parents, counter, cvs);
+    // a partial group still pays off with the lanes, if it is more than one input
+    if (hash_lanes && count >= 2) {
+        std::array<std::byte, 16 * chunk_size> padded;
+        std::memcpy(padded.data(), data, count * input_size);
+        std::memset(padded.data() + count * input_size, 0, (lanes - count) * input_size);
+        std::array<word, 16 * 8> padded_cvs;
+        hash_lanes(padded.data(), parents, counter, padded_cvs.data());
+        std::copy_n(padded_cvs.begin(), 8 * count, cvs);
+        return;
+    }
+    for (; count > 0; --count, data += input_size, ++counter, cvs += 8) {
+        if (parents) {
+            const auto output = compress(Blake3::IV, block_words(data).data(), 0, block_size, Blake3::parent);
+            std::copy_n(output.begin(), 8, cvs);
+        } else {
+            hash_chunk(data, counter, cvs);
+        }
+    }
+}
+
+} // namespace
+
+std::atomic<int> Blake3::selected{-1};
+
+Blake3::Blake3() {
+    std::copy(std::begin(IV), std::end(IV), m_chunk_cv.begin());
+}
+
+// A block (and a chunk) is only finished, when more data follows, as the last one is the root, if it is the only one
+void Blake3::update(std::span<const char> data) {
+    auto input = std::as_bytes(data);
+    while (!input.empty()) {
+        if (m_block_length == block_size) {
+            const word flags = m_blocks_compressed == 0 ? static_cast<word>(chunk_start) : word{0};
+            if (m_blocks_compressed + 1 == chunk_size / block_size) {
+                const auto output = compress(m_chunk_cv.data(), block_words(m_block.data()).data(), m_chunk_counter, block_size, flags | chunk_end);
+                add_chunk_cv({output[0], output[1], output[2], output[3], output[4], output[5], output[6], output[7]});
+            } else {
+                const auto output = compress(m_chunk_cv.data(), block_words(m_block.data()).data(), m_chunk_counter, block_size, flags);
+                std::copy_n(output.begin(), 8, m_chunk_cv.begin());
+                ++m_blocks_compressed;
+                m_block_length = 0;
+            }
+        }
+        if (m_blocks_compressed == 0 && m_block_length == 0 && input.size() > chunk_size) {
+            const auto chunks = (input.size() - 1) / chunk_size;
+            hash_chunks(input.data(), chunks);
+            input = input.subspan(chunks * chunk_size);
+        }
+        const auto count = std::min(input.size(), block_size - m_block_length);
+        std::memcpy(m_block.data() + m_block_length, input.data(), count);
+        m_block_length += count;
+        input = input.subspan(count);
+    }
+}
+
+Blake3::hash_type Blake3::hash() const {
+    // the last block of the current chunk, then the parents up to the root, which is compressed with the root flag
+    std::array<std::byte, block_size> last_block{};
+    std::memcpy(last_block.data(), m_block.data(), m_block_length);
+    auto m = block_words(last_block.data());
+    chaining_value cv = m_chunk_cv;
+    auto counter = m_chunk_counter;
+    auto length = static_cast<word>(m_block_length);
+    word flags = (m_blocks_compressed == 0 ? static_cast<word>(chunk_start) : word{0}) | chunk_end;
+    for (auto i = m_stack_size; i-- > 0;) {
+        const auto output = compress(cv.data(), m.data(), counter, length, flags);
+        std::copy(m_stack[i].begin(), m_stack[i].end(), m.begin());
+        std::copy_n(output.begin(), 8, m.begin() + 8);
+        std::copy(std::begin(IV), std::end(IV), cv.begin());
+        counter = 0;
+        length = block_size;
+        flags = parent;
+    }
+    const auto output = compress(cv.data(), m.data(), counter, length, flags | root);
+
+    hash_type result;
+    for (int i = 0; i < 8; ++i) {
+        auto value = output[i];
+        if constexpr (std::endian::native == std::endian::big)
+            value = std::byteswap(value);
+        std::memcpy(result.data.data() + 4 * i, &value, sizeof(value));
+    }
+    return result;
+}
+
+// Merges the subtrees completed by the new one: one for each further trailing zero bit of the new chunk count
+void Blake3::add_chunk_cv(chaining_value cv, std::uint64_t chunks) {
+    for (auto subtrees = (m_chunk_counter + chunks) / chunks; (subtrees & 1) == 0; subtrees >>= 1) {
+        std::array<word, 16> m;
+        std::copy(m_stack[m_stack_size - 1].begin(), m_stack[m_stack_size - 1].end(), m.begin());
+        std::copy(cv.begin(), cv.end(), m.begin() + 8);
+        const auto output = compress(IV, m.data(), 0, block_size, parent);
+        std::copy_n(output.begin(), 8, cv.begin());
+        --m_stack_size;
+    }
+    m_stack[m_stack_size++] = cv;
+
+    m_chunk_counter += chunks;
+    std::copy(std::begin(IV), std::end(IV), m_chunk_cv.begin());
+    m_blocks_compressed = 0;
+    m_block_length = 0;
+}
+
+// The chaining values of a batch of chunks are merged to the largest subtrees the chunk counter allows, so the
+// parent nodes are hashed in the lanes, too
+void Blake3::hash_chunks(const std::byte *data, size_t chunks) {
+    std::array<chaining_value, max_batch_chunks> cvs;
+    while (chunks > 0) {
+        const auto count = std::min(chunks, max_batch_chunks);
+        hash_many(data, count, false, m_chunk_counter, cvs[0].data());
+        for (size_t first = 0; first < count;) {
+            auto size = std::bit_floor(count - first);
+            if (m_chunk_counter != 0)
+                size = std::min<size_t>(size, std::uint64_t{1} << std::countr_zero(m_chunk_counter));
+            for (auto n = size; n > 1; n /= 2)
+                hash_many(reinterpret_cast<const std::byte *>(cvs[first].data()), n / 2, true, 0, cvs[first].data());
+            add_chunk_cv(cvs[first], size);
+            first += size;
+        }
+        data += count * chunk_size;
+        chunks -= count;
+    }
+}
+
+bool Blake3::is_supported(Implementation impl) {
+    switch (impl) {
+    case Implementation::generic:
+        return true;
+#if defined(FILESTORE_X86)
+    case Implementation::avx2:
+        return cpu().avx2;
+    case Implementation::avx512:
+        return cpu().avx512f;
+#else
+    default:
+        return false;
+#endif
+    }
+    return false;
+}
+
+Blake3::Implementation Blake3::detect_implementation() {
+    if (is_supported(Implementation::avx512))
+        return Implementation::avx512;
+    if (is_supported(Implementation::avx2))
+        return Implementation::avx2;
+    return Implementation::generic;
+}
+
+Blake3::Implementation Blake3::implementation() {
+    const auto impl = selected.load(std::memory_order_relaxed);
+    if (impl < 0)
+        return detect_implementation();
+    return static_cast<Implementation>(impl);
+}
+
+bool Blake3::use_implementation(Implementation impl) {
+    if (!is_supported(impl))
+        return false;
+    selected.store(static_cast<int>(impl), std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace filestore
@@ -0,0 +1,68 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+// compiled with AVX2 enabled, only called after checking the CPU features
+
+#include "blake3_lanes.h"
+
+#include "FileStore/cpu.h"
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+
+namespace filestore::blake3_lanes {
+
+namespace {
+
+struct avx2 {
+    using type = __m256i;
+    static constexpr int lanes = 8;
+
+    static type load(const std::uint32_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    // The 16 message words of the block at p and of the blocks stride, 2 * stride, ... bytes after it: the
+    // blocks are loaded as rows and transposed in two 8x8 steps
+    static void load_words(const std::byte *p, size_t stride, type *m) {
+        for (int half = 0; half < 2; ++half) {
+            type r[8];
+            for (int lane = 0; lane < 8; ++lane)
+                r[lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + lane * stride + 32 * half));
+            type t[8];
+            for (int i = 0; i < 4; ++i) {
+                t[2 * i] = _mm256_unpacklo_epi32(r[2 * i], r[2 * i + 1]);
+                t[2 * i + 1] = _mm256_unpackhi_epi32(r[2 * i], r[2 * i + 1]);
+            }
+            // u[4 * k + w] holds words w and w + 4 of rows 4 * k to 4 * k + 3
+            type u[8];
+            for (int k = 0; k < 2; ++k) {
+                u[4 * k] = _mm256_unpacklo_epi64(t[4 * k], t[4 * k + 2]);
+                u[4 * k + 1] = _mm256_unpackhi_epi64(t[4 * k], t[4 * k + 2]);
+                u[4 * k + 2] = _mm256_unpacklo_epi64(t[4 * k + 1], t[4 * k + 3]);
+                u[4 * k + 3] = _mm256_unpackhi_epi64(t[4 * k + 1], t[4 * k + 3]);
+            }
+            for (int w = 0; w < 4; ++w) {
+                m[8 * half + w] = _mm256_permute2x128_si256(u[w], u[4 + w], 0x20);
+                m[8 * half + w + 4] = _mm256_permute2x128_si256(u[w], u[4 + w], 0x31);
+            }
+        }
+    }
+    static void store(std::uint32_t *p, type x) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), x); }
+    static type set1(std::uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+    static type add(type x, type y) { return _mm256_add_epi32(x, y); }
+    static type bxor(type x, type y) { return _mm256_xor_si256(x, y); }
+    template<int n>
+    static type rotr(type x) {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+};
+
+} // namespace
+
+void hash_many_avx2(const std::byte *data, bool parents, std::uint64_t counter, std::uint32_t *cvs) {
+    hash_many<avx2>(data, parents, counter, cvs);
+}
+
+} // namespace filestore::blake3_lanes
+
+#endif
@@ -0,0 +1,73 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+// compiled with AVX-512 enabled, only called after checking the CPU features
+
+#include "blake3_lanes.h"
+
+#include "FileStore/cpu.h"
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+
+namespace filestore::blake3_lanes {
+
+namespace {
+
+struct avx512 {
+    using type = __m512i;
+    static constexpr int lanes = 16;
+
+    static type load(const std::uint32_t *p) { return _mm512_loadu_si512(p); }
+    // The 16 message words of the block at p and of the blocks stride, 2 * stride, ... bytes after it: the
+    // blocks are loaded as rows and transposed as 16x16 matrix
+    static void load_words(const std::byte *p, size_t stride, type *m) {
+        type r[16];
+        for (int lane = 0; lane < 16; ++lane)
+            r[lane] = _mm512_loadu_si512(p + lane * stride);
+        type t[16];
+        for (int i = 0; i < 8; ++i) {
+            t[2 * i] = _mm512_unpacklo_epi32(r[2 * i], r[2 * i + 1]);
+            t[2 * i + 1] = _mm512_unpackhi_epi32(r[2 * i], r[2 * i + 1]);
+        }
+        // in its 128 bit lane j, u[4 * k + w] holds word 4 * j + w of rows 4 * k to 4 * k + 3
+        type u[16];
+        for (int k = 0; k < 4; ++k) {
+            u[4 * k] = _mm512_unpacklo_epi64(t[4 * k], t[4 * k + 2]);
+            u[4 * k + 1] = _mm512_unpackhi_epi64(t[4 * k], t[4 * k + 2]);
+            u[4 * k + 2] = _mm512_unpacklo_epi64(t[4 * k + 1], t[4 * k + 3]);
+            u[4 * k + 3] = _mm512_unpackhi_epi64(t[4 * k + 1], t[4 * k + 3]);
+        }
+        // then a 4x4 transpose of the 128 bit lanes
+        for (int w = 0; w < 4; ++w) {
+            const auto x0 = _mm512_shuffle_i32x4(u[w], u[4 + w], 0x44);
+            const auto x1 = _mm512_shuffle_i32x4(u[w], u[4 + w], 0xee);
+            const auto y0 = _mm512_shuffle_i32x4(u[8 + w], u[12 + w], 0x44);
+            const auto y1 = _mm512_shuffle_i32x4(u[8 + w], u[12 + w], 0xee);
+            m[w] = _mm512_shuffle_i32x4(x0, y0, 0x88);
+            m[4 + w] = _mm512_shuffle_i32x4(x0, y0, 0xdd);
+            m[8 + w] = _mm512_shuffle_i32x4(x1, y1, 0x88);
+            m[12 + w] = _mm512_shuffle_i32x4(x1, y1, 0xdd);
+        }
+    }
+    static void store(std::uint32_t *p, type x) { _mm512_storeu_si512(p, x); }
+    static type set1(std::uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+    static type add(type x, type y) { return _mm512_add_epi32(x, y); }
+    static type bxor(type x, type y) { return _mm512_xor_si512(x, y); }
+    template<int n>
+    static type rotr(type x) {
+        return _mm512_ror_epi32(x, n);
+    }
+};
+
+} // namespace
+
+void hash_many_avx512(const std::byte *data, bool parents, std::uint64_t counter, std::uint32_t *cvs) {
+    hash_many<avx512>(data, parents, counter, cvs);
+}
+
+} // namespace filestore::blake3_lanes
+
+#endif
@@ -0,0 +1,95 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_BLAKE3_LANES_H
+#define FILESTORE_BLAKE3_LANES_H
+
+// BLAKE3 chunks or parent nodes hashed N at a time, one in each lane. Each vector holds the same word of all lanes, so each
+// round works on whole vectors. Only instantiated for x86, which is little endian like BLAKE3.
+//
+// As for SHA256, the template is instantiated in translation units compiled for the respective instruction set
+// and lives in an anonymous namespace.
+
+#include "FileStore/blake3.h"
+
+#include <cstdint>
+
+namespace filestore::blake3_lanes {
+
+// Hash N inputs, found one after the other at data, and store the chaining value of input i at cvs[8 * i]. The
+// inputs are full chunks with the chunk counters counter, counter + 1, ..., or parent nodes (a block of two
+// chaining values each).
+void hash_many_avx2(const std::byte *data, bool parents, std::uint64_t counter, std::uint32_t *cvs);   // 8 inputs
+void hash_many_avx512(const std::byte *data, bool parents, std::uint64_t counter, std::uint32_t *cvs); // 16 inputs
+
+namespace {
+
+template<typename V, typename vec = typename V::type>
+inline void g(vec &a, vec &b, vec &c, vec &d, vec x, vec y) {
+    a = V::add(V::add(a, b), x);
+    d = V::template rotr<16>(V::bxor(d, a));
+    c = V::add(c, d);
+    b = V::template rotr<12>(V::bxor(b, c));
+    a = V::add(V::add(a, b), y);
+    d = V::template rotr<8>(V::bxor(d, a));
+    c = V::add(c, d);
+    b = V::template rotr<7>(V::bxor(b, c));
+}
+
+template<typename V>
+inline void hash_many(const std::byte *data, bool parents, std::uint64_t counter, std::uint32_t *cvs) {
+    using vec = typename V::type;
+    constexpr auto N = V::lanes;
+    const size_t blocks = parents ? 1 : Blake3::chunk_size / Blake3::block_size;
+
+    // parents always use the counter 0
+    alignas(64) std::uint32_t words[16 * N];
+    for (int lane = 0; lane < N; ++lane) {
+        const auto lane_counter = parents ? 0 : counter + lane;
+        words[lane] = static_cast<std::uint32_t>(lane_counter);
+        words[N + lane] = static_cast<std::uint32_t>(lane_counter >> 32);
+    }
+    const vec counter_low = V::load(words);
+    const vec counter_high = V::load(words + N);
+
+    vec h[8];
+    for (int i = 0; i < 8; ++i)
+        h[i] = V::set1(Blake3::IV[i]);
+
+    for (size_t block = 0; block < blocks; ++block) {
+        vec m[16];
+        V::load_words(data + block * Blake3::block_size, blocks * Blake3::block_size, m);
+
+        const std::uint32_t flags = parents ? static_cast<std::uint32_t>(Blake3::parent)
+                                            : (block == 0 ? static_cast<std::uint32_t>(Blake3::chunk_start) : 0U) |
+                                                  (block + 1 == blocks ? static_cast<std::uint32_t>(Blake3::chunk_end) : 0U);
+        vec v[16] = {h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], V::set1(Blake3::IV[0]), V::set1(Blake3::IV[1]), V::set1(Blake3::IV[2]), V::set1(Blake3::IV[3]),
+                     counter_low, counter_high, V::set1(Blake3::block_size), V::set1(flags)};
+        for (const auto &s : Blake3::message_schedule) {
+            g<V>(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);
+            g<V>(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);
+            g<V>(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);
+            g<V>(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);
+            g<V>(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);
+            g<V>(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+            g<V>(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);
+            g<V>(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);
+        }
+        for (int i = 0; i < 8; ++i)
+            h[i] = V::bxor(v[i], v[i + 8]);
+    }
+
+    for (int i = 0; i < 8; ++i)
+        V::store(words + i * N, h[i]);
+    for (int lane = 0; lane < N; ++lane)
+        for (int i = 0; i < 8; ++i)
+            cvs[8 * lane + i] = words[i * N + lane];
+}
+
+} // namespace
+
+} // namespace filestore::blake3_lanes
+
+#endif
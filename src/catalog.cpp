@@ -0,0 +1,296 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/catalog.h"
+#include "FileStore/crc32c.h"
+#include "FileStore/file.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// File layout (native byte order): header, followed by fixed size records
+constexpr char catalog_magic[8] = {'F', 'S', 'C', 'A', 'T', 'L', 'O', 'G'};
+constexpr std::uint32_t catalog_version = 2;
+
+struct catalog_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+};
+
+enum record_type : std::uint32_t {
+    added = 1,
+    removed = 2,
+};
+
+struct catalog_record {
+    std::byte key[Key::bytelength];
+    std::uint32_t type;
+    std::uint64_t size;
+    std::int64_t modification_time;
+    std::int64_t import_time;
+    std::uint64_t sample_hash;
+    std::uint32_t reserved;
+    std::uint32_t checksum; // CRC-32C of all preceding bytes
+};
+
+static_assert(sizeof(catalog_header) == 16);
+static_assert(sizeof(catalog_record) == 80);
+
+constexpr auto checksum_offset = offsetof(catalog_record, checksum);
+
+std::uint32_t record_checksum(const catalog_record &record) {
+    return crc32c(std::span(reinterpret_cast<const std::byte *>(&record), checksum_offset));
+}
+
+catalog_record make_record(const CatalogEntry &entry, std::uint32_t type) {
+    catalog_record record{};
+    std::memcpy(record.key, entry.key.data.data(), Key::bytelength);
+    record.type = type;
+    record.size = entry.size;
+    record.modification_time = entry.modification_time;
+    record.import_time = entry.import_time;
+    record.sample_hash = entry.sample_hash;
+    record.checksum = record_checksum(record);
+    return record;
+}
+
+CatalogEntry make_entry(const catalog_record &record) {
+    CatalogEntry entry;
+    std::memcpy(entry.key.data.data(), record.key, Key::bytelength);
+    entry.size = record.size;
+    entry.modification_time = record.modification_time;
+    entry.import_time = record.import_time;
+    entry.sample_hash = record.sample_hash;
+    return entry;
+}
+
+catalog_record read_record(std::span<const std::byte> data, size_t index) {
+    catalog_record record;
+    std::memcpy(&record, data.data() + sizeof(catalog_header) + index * sizeof(catalog_record), sizeof(record));
+    return record;
+}
+
+void write_header(std::ostream &output) {
+    catalog_header header{};
+    std::memcpy(header.magic, catalog_magic, sizeof(catalog_magic));
+    header.version = catalog_version;
+    header.record_size = sizeof(catalog_record);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void flush_to_disk([[maybe_unused]] const fs::path &file_path) {
+#if !defined(_WIN32)
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+} // namespace
+
+// The marker file exists while the catalog is open, so a crash leaves it behind
+Catalog::Catalog(const fs::path &file_path)
+    : m_file_path{file_path}, m_open_marker_path{fs::path{file_path} += ".open"},
+      m_closed_cleanly{!fs::exists(m_open_marker_path)} {
+    open();
+    if (!std::ofstream{m_open_marker_path})
+        throw FileError{"Could not create file", m_open_marker_path};
+}
+
+Catalog::~Catalog() {
+    m_output.close();
+    std::error_code ec;
+    fs::remove(m_open_marker_path, ec);
+}
+
+void Catalog::open() {
+    std::error_code ec;
+    if (fs::file_size(m_file_path, ec) == 0 || ec) {
+        std::ofstream output{m_file_path, std::ios_base::binary | std::ios_base::trunc};
+        write_header(output);
+        if (!output.flush())
+            throw FileError{"Could not create file", m_file_path};
+    }
+    recover();
+
+    m_output.open(m_file_path, std::ios_base::binary | std::ios_base::app);
+    if (!m_output)
+        throw FileError{"Could not open file", m_file_path};
+}
+
+// Counts the valid records and truncates the file after the last one. Only the end of the file can be damaged by a
+// crash during an append, but a damaged record anywhere ends the catalog. The listed objects are replayed from the
+// records.
+void Catalog::recover() {
+    m_mapping = MappedFile{m_file_path};
+    const auto data = m_mapping.data();
+
+    catalog_header header;
+    if (data.size() < sizeof(header))
+        throw FileError{"Invalid catalog", m_file_path};
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, catalog_magic, sizeof(catalog_magic)) != 0 || header.version != catalog_version ||
+        header.record_size != sizeof(catalog_record))
+        throw FileError{"Invalid catalog", m_file_path};
+
+    const auto stored_records = (data.size() - sizeof(header)) / sizeof(catalog_record);
+    m_records = 0;
+    m_removals = 0;
+    m_live.clear();
+    for (; m_records < stored_records; ++m_records) {
+        const auto record = read_record(data, m_records);
+        if (record.checksum != record_checksum(record) || (record.type != added && record.type != removed))
+            break;
+        const auto key = make_entry(record).key;
+        if (record.type == removed) {
+            ++m_removals;
+            m_live.erase(key);
+        } else {
+            m_live.insert(key);
+        }
+    }
+
+    const auto valid_size = sizeof(header) + m_records * sizeof(catalog_record);
+    if (valid_size != data.size()) {
+        m_mapping = MappedFile{};
+        fs::resize_file(m_file_path, valid_size);
+        m_mapping = MappedFile{m_file_path};
+    }
+    m_mapped_records = m_records;
+}
+
+void Catalog::add(const CatalogEntry &entry) {
+    std::lock_guard lock{m_mutex};
+    append(entry, added);
+    m_live.insert(entry.key);
+}
+
+void Catalog::remove(const Key &key) {
+    std::lock_guard lock{m_mutex};
+    append(CatalogEntry{.key = key, .import_time = now()}, removed);
+    ++m_removals;
+    m_live.erase(key);
+    // periodic compaction: when at least half of the records are obsolete
+    if (2 * (m_records - m_live.size()) >= m_records && m_records >= 1024)
+        compact_locked();
+}
+
+// Each record is flushed to the file system, so it is not lost with the buffer, if the process crashes
+void Catalog::append(const CatalogEntry &entry, std::uint32_t type) {
+    const auto record = make_record(entry, type);
+    if (!m_output.write(reinterpret_cast<const char *>(&record), sizeof(record)) || !m_output.flush())
+        throw FileError{"Error writing file", m_file_path};
+    ++m_records;
+}
+
+void Catalog::map() const {
+    if (m_mapped_records == m_records)
+        return;
+    m_mapping = MappedFile{m_file_path};
+    m_mapped_records = m_records;
+}
+
+void Catalog::for_each(const std::function<void(const CatalogEntry &)> &f) const {
+    std::lock_guard lock{m_mutex};
+    scan(f);
+}
+
+void Catalog::scan(const std::function<void(const CatalogEntry &)> &f) const {
+    map();
+    const auto data = m_mapping.data();
+
+    if (m_removals == 0 && m_live.size() == m_records) {
+        for (size_t i = 0; i < m_records; ++i)
+            f(make_entry(read_record(data, i)));
+        return;
+    }
+
+    // an object is listed with its last record, if that one added it
+    std::unordered_map<Key, size_t, KeyHash> last_record;
+    for (size_t i = 0; i < m_records; ++i)
+        last_record[make_entry(read_record(data, i)).key] = i;
+    for (size_t i = 0; i < m_records; ++i) {
+        const auto record = read_record(data, i);
+        if (record.type != added)
+            continue;
+        const auto entry = make_entry(record);
+        if (last_record[entry.key] == i)
+            f(entry);
+    }
+}
+
+std::vector<CatalogEntry> Catalog::entries() const {
+    std::vector<CatalogEntry> result;
+    for_each([&result](const CatalogEntry &entry) { result.push_back(entry); });
+    return result;
+}
+
+size_t Catalog::size() const {
+    std::lock_guard lock{m_mutex};
+    return m_live.size();
+}
+
+void Catalog::sync() {
+    std::lock_guard lock{m_mutex};
+    flush_to_disk(m_file_path);
+}
+
+void Catalog::compact() {
+    std::lock_guard lock{m_mutex};
+    compact_locked();
+}
+
+// The compacted catalog is written next to the current one and replaces it atomically
+void Catalog::compact_locked() {
+    std::vector<CatalogEntry> live;
+    scan([&live](const CatalogEntry &entry) { live.push_back(entry); });
+
+    auto temp_path = m_file_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream output{temp_path, std::ios_base::binary | std::ios_base::trunc};
+        write_header(output);
+        for (const auto &entry : live) {
+            const auto record = make_record(entry, added);
+            output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        }
+        if (!output.flush())
+            throw FileError{"Error writing file", temp_path};
+    }
+    flush_to_disk(temp_path);
+    replace_locked(temp_path);
+}
+
+void Catalog::replace(const fs::path &file_path) {
+    std::lock_guard lock{m_mutex};
+    replace_locked(file_path);
+}
+
+void Catalog::replace_locked(const fs::path &file_path) {
+    m_output.close();
+    m_mapping = MappedFile{};
+    fs::rename(file_path, m_file_path);
+    open();
+}
+
+std::int64_t Catalog::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace filestore
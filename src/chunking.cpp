@@ -0,0 +1,139 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/chunking.h"
+#include "FileStore/crc32c.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace filestore {
+
+namespace {
+
+// Random values for each byte, from splitmix64
+constexpr std::array<std::uint64_t, 256> gear_table = []() {
+    std::array<std::uint64_t, 256> table{};
+    std::uint64_t state = 0x46696c6553746f72ULL;
+    for (auto &value : table) {
+        state += 0x9e3779b97f4a7c15ULL;
+        auto z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+// The hash is shifted left, so its top bits depend on the most bytes
+constexpr std::uint64_t top_bits(int count) {
+    return count <= 0 ? 0 : ~std::uint64_t{0} << (64 - count);
+}
+
+// File layout (native byte order): header, followed by a record per chunk
+constexpr char manifest_magic[8] = {'F', 'S', 'C', 'H', 'U', 'N', 'K', 'M'};
+constexpr std::uint32_t manifest_version = 1;
+
+struct manifest_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t chunk_count;
+    std::uint64_t size;
+    std::uint64_t sample_hash;
+    std::uint32_t reserved;
+    std::uint32_t checksum; // CRC-32C of the preceding bytes and the records
+};
+
+struct manifest_record {
+    std::byte key[Key::bytelength];
+    std::uint32_t size;
+};
+
+static_assert(sizeof(manifest_header) == 40);
+static_assert(sizeof(manifest_record) == 40);
+
+constexpr auto checksum_offset = offsetof(manifest_header, checksum);
+
+std::uint32_t manifest_checksum(std::span<const std::byte> data) {
+    return crc32c(data.subspan(sizeof(manifest_header)), crc32c(data.first(checksum_offset)));
+}
+
+} // namespace
+
+size_t next_chunk_size(std::span<const std::byte> data, const ChunkingPolicy &policy) {
+    if (data.size() <= policy.min_chunk_size)
+        return data.size();
+    const auto max_size = std::min<size_t>(data.size(), policy.max_chunk_size);
+    const auto normal_size = std::min<size_t>(max_size, policy.average_chunk_size);
+    // harder to match before the average size, easier after it, so most chunks are close to the average
+    const auto bits = std::bit_width(policy.average_chunk_size) - 1;
+    const auto small_mask = top_bits(bits + 2);
+    const auto large_mask = top_bits(bits - 2);
+
+    std::uint64_t hash = 0;
+    size_t i = policy.min_chunk_size;
+    for (; i < normal_size; ++i) {
+        hash = (hash << 1) + gear_table[std::to_integer<size_t>(data[i])];
+        if ((hash & small_mask) == 0)
+            return i + 1;
+    }
+    for (; i < max_size; ++i) {
+        hash = (hash << 1) + gear_table[std::to_integer<size_t>(data[i])];
+        if ((hash & large_mask) == 0)
+            return i + 1;
+    }
+    return max_size;
+}
+
+std::vector<std::byte> ChunkManifest::serialize() const {
+    std::vector<std::byte> data(sizeof(manifest_header) + chunks.size() * sizeof(manifest_record));
+    manifest_header header{};
+    std::memcpy(header.magic, manifest_magic, sizeof(manifest_magic));
+    header.version = manifest_version;
+    header.chunk_count = static_cast<std::uint32_t>(chunks.size());
+    header.size = size;
+    header.sample_hash = sample_hash;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        manifest_record record{};
+        std::memcpy(record.key, chunks[i].key.data.data(), Key::bytelength);
+        record.size = chunks[i].size;
+        std::memcpy(data.data() + sizeof(header) + i * sizeof(record), &record, sizeof(record));
+    }
+    std::memcpy(data.data(), &header, sizeof(header));
+    header.checksum = manifest_checksum(data);
+    std::memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+bool ChunkManifest::has_magic(std::span<const std::byte> data) {
+    return data.size() >= sizeof(manifest_magic) && std::memcmp(data.data(), manifest_magic, sizeof(manifest_magic)) == 0;
+}
+
+std::optional<ChunkManifest> ChunkManifest::parse(std::span<const std::byte> data) {
+    manifest_header header;
+    if (data.size() < sizeof(header))
+        return std::nullopt;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, manifest_magic, sizeof(manifest_magic)) != 0 || header.version != manifest_version ||
+        data.size() != sizeof(header) + header.chunk_count * sizeof(manifest_record) || header.checksum != manifest_checksum(data))
+        return std::nullopt;
+
+    ChunkManifest manifest{header.size, header.sample_hash, std::vector<ChunkRef>(header.chunk_count)};
+    std::uint64_t total_size = 0;
+    for (size_t i = 0; i < manifest.chunks.size(); ++i) {
+        manifest_record record;
+        std::memcpy(&record, data.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+        std::memcpy(manifest.chunks[i].key.data.data(), record.key, Key::bytelength);
+        manifest.chunks[i].size = record.size;
+        total_size += record.size;
+    }
+    if (total_size != manifest.size)
+        return std::nullopt;
+    return manifest;
+}
+
+} // namespace filestore
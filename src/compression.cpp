@@ -0,0 +1,256 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/compression.h"
+#include "FileStore/crc32c.h"
+#include "FileStore/mapped_file.h"
+#include "FileStore/xxhash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+#if defined(FILESTORE_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// File layout (native byte order): header, the blocks, and the end offset of each block relative to the first
+// one. A block that is as long as its uncompressed content is stored as it is.
+constexpr char compressed_magic[8] = {'F', 'S', 'B', 'L', 'O', 'C', 'K', 'Z'};
+constexpr std::uint32_t compressed_version = 1;
+
+struct compressed_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t algorithm;
+    std::uint64_t size; // of the content
+    std::uint32_t block_size;
+    std::uint32_t checksum; // CRC-32C of all preceding bytes
+};
+
+static_assert(sizeof(compressed_header) == 32);
+
+constexpr auto checksum_offset = offsetof(compressed_header, checksum);
+constexpr auto no_block = std::numeric_limits<size_t>::max();
+
+std::uint32_t header_checksum(const compressed_header &header) {
+    return crc32c(std::span(reinterpret_cast<const std::byte *>(&header), checksum_offset));
+}
+
+std::span<const char> as_chars(std::span<const std::byte> data) {
+    return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+// The compressed block, nullopt, if it is not shorter than the content
+std::optional<std::span<const std::byte>> compress_block([[maybe_unused]] std::span<const std::byte> block,
+                                                          [[maybe_unused]] std::vector<std::byte> &buffer,
+                                                          [[maybe_unused]] const CompressionPolicy &policy) {
+#if defined(FILESTORE_WITH_ZLIB)
+    if (policy.algorithm == Compression::deflate) {
+        buffer.resize(::compressBound(static_cast<uLong>(block.size())));
+        auto length = static_cast<uLongf>(buffer.size());
+        if (::compress2(reinterpret_cast<Bytef *>(buffer.data()), &length, reinterpret_cast<const Bytef *>(block.data()),
+                        static_cast<uLong>(block.size()), policy.level) == Z_OK &&
+            length < block.size())
+            return std::span<const std::byte>{buffer.data(), length};
+    }
+#endif
+    return std::nullopt;
+}
+
+void decompress_block([[maybe_unused]] std::uint32_t algorithm, [[maybe_unused]] std::span<const std::byte> compressed,
+                      [[maybe_unused]] std::span<std::byte> block) {
+#if defined(FILESTORE_WITH_ZLIB)
+    if (algorithm == static_cast<std::uint32_t>(Compression::deflate)) {
+        auto length = static_cast<uLongf>(block.size());
+        if (::uncompress(reinterpret_cast<Bytef *>(block.data()), &length, reinterpret_cast<const Bytef *>(compressed.data()),
+                         static_cast<uLong>(compressed.size())) != Z_OK ||
+            length != block.size())
+            throw FileError{"Invalid compressed object", {}};
+        return;
+    }
+#endif
+    throw FileError{"Compression not supported", {}};
+}
+
+} // namespace
+
+bool compression_available(Compression algorithm) {
+#if defined(FILESTORE_WITH_ZLIB)
+    return algorithm == Compression::none || algorithm == Compression::deflate;
+#else
+    return algorithm == Compression::none;
+#endif
+}
+
+bool compress_file(const fs::path &source, TempFile &target, const CompressionPolicy &policy, bool escape) {
+    const MappedFile input{source};
+    const auto content = input.data();
+    const bool must_compress = escape || is_compressed(content);
+    if (content.empty() || (policy.algorithm == Compression::none && !must_compress))
+        return false;
+
+    compressed_header header{};
+    std::memcpy(header.magic, compressed_magic, sizeof(compressed_magic));
+    header.version = compressed_version;
+    header.algorithm = static_cast<std::uint32_t>(policy.algorithm);
+    header.size = content.size();
+    header.block_size = policy.block_size;
+    header.checksum = header_checksum(header);
+    target.write({reinterpret_cast<const char *>(&header), sizeof(header)});
+
+    std::vector<std::uint64_t> ends;
+    std::vector<std::byte> buffer;
+    std::uint64_t written = 0;
+    const auto too_large = [&](std::uint64_t content_size) {
+        return !must_compress && static_cast<double>(written) > policy.max_ratio * static_cast<double>(content_size);
+    };
+    for (size_t offset = 0; offset < content.size(); offset += policy.block_size) {
+        const auto block = content.subspan(offset, std::min<size_t>(policy.block_size, content.size() - offset));
+        const auto data = compress_block(block, buffer, policy).value_or(block);
+        target.write(as_chars(data));
+        written += data.size();
+        ends.push_back(written);
+        // incompressible content is recognized by its first block
+        if (offset == 0 && too_large(block.size()))
+            return false;
+    }
+    target.write(as_chars(std::as_bytes(std::span{ends})));
+    written += ends.size() * sizeof(std::uint64_t) + sizeof(header);
+    return !too_large(content.size());
+}
+
+bool is_compressed(std::span<const std::byte> data) {
+    compressed_header header;
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    return std::memcmp(header.magic, compressed_magic, sizeof(compressed_magic)) == 0 && header.checksum == header_checksum(header) &&
+           header.version == compressed_version && header.block_size > 0;
+}
+
+ContentReader::ContentReader(const fs::path &file_path) {
+    auto mapping = std::make_shared<const MappedFile>(file_path);
+    const auto data = mapping->data();
+    *this = ContentReader{data, std::move(mapping)};
+}
+
+ContentReader::ContentReader(std::span<const std::byte> data, std::shared_ptr<const void> owner, bool may_be_compressed)
+    : m_owner{std::move(owner)}, m_data{data}, m_size{data.size()}, m_cached_block{no_block} {
+    if (!may_be_compressed || !is_compressed(data))
+        return;
+
+    compressed_header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    m_compressed = true;
+    m_size = header.size;
+    m_block_size = header.block_size;
+    m_block_count = static_cast<size_t>((m_size + m_block_size - 1) / m_block_size);
+    m_blocks = data.subspan(sizeof(header));
+
+    // the end offsets must be ascending and the last one where the table starts
+    const auto table_size = m_block_count * sizeof(std::uint64_t);
+    if (m_blocks.size() < table_size)
+        throw FileError{"Invalid compressed object", {}};
+    std::uint64_t previous_end = 0;
+    for (size_t i = 0; i < m_block_count; ++i) {
+        std::uint64_t end;
+        std::memcpy(&end, m_blocks.data() + m_blocks.size() - table_size + i * sizeof(end), sizeof(end));
+        if (end < previous_end)
+            throw FileError{"Invalid compressed object", {}};
+        previous_end = end;
+    }
+    if (previous_end != m_blocks.size() - table_size)
+        throw FileError{"Invalid compressed object", {}};
+    m_blocks = m_blocks.first(m_blocks.size() - table_size);
+}
+
+std::span<const std::byte> ContentReader::block(size_t index) const {
+    const auto table = m_data.data() + m_data.size() - m_block_count * sizeof(std::uint64_t);
+    std::uint64_t begin = 0;
+    std::uint64_t end;
+    if (index > 0)
+        std::memcpy(&begin, table + (index - 1) * sizeof(begin), sizeof(begin));
+    std::memcpy(&end, table + index * sizeof(end), sizeof(end));
+
+    const auto stored = m_blocks.subspan(begin, end - begin);
+    const auto length = std::min<std::uint64_t>(m_block_size, m_size - static_cast<std::uint64_t>(index) * m_block_size);
+    if (stored.size() == length)
+        return stored;
+    if (m_cached_block != index) {
+        compressed_header header;
+        std::memcpy(&header, m_data.data(), sizeof(header));
+        m_block.resize(length);
+        m_cached_block = no_block;
+        decompress_block(header.algorithm, stored, m_block);
+        m_cached_block = index;
+    }
+    return m_block;
+}
+
+size_t ContentReader::read(std::uint64_t offset, std::span<std::byte> buffer) const {
+    if (offset >= m_size)
+        return 0;
+    const auto length = static_cast<size_t>(std::min<std::uint64_t>(buffer.size(), m_size - offset));
+    if (!m_compressed) {
+        std::memcpy(buffer.data(), m_data.data() + offset, length);
+        return length;
+    }
+    for (size_t copied = 0; copied < length;) {
+        const auto position = offset + copied;
+        const auto data = block(static_cast<size_t>(position / m_block_size)).subspan(static_cast<size_t>(position % m_block_size));
+        const auto count = std::min(data.size(), length - copied);
+        std::memcpy(buffer.data() + copied, data.data(), count);
+        copied += count;
+    }
+    return length;
+}
+
+void ContentReader::for_each_block(const std::function<void(std::span<const std::byte>)> &f) const {
+    if (!m_compressed) {
+        if (!m_data.empty())
+            f(m_data);
+        return;
+    }
+    for (size_t i = 0; i < m_block_count; ++i)
+        f(block(i));
+}
+
+std::vector<std::byte> ContentReader::read_all() const {
+    std::vector<std::byte> content(static_cast<size_t>(m_size));
+    read(0, content);
+    return content;
+}
+
+bool ContentReader::equals(std::span<const std::byte> data) const {
+    if (data.size() != m_size)
+        return false;
+    if (!m_compressed)
+        return data.empty() || std::memcmp(m_data.data(), data.data(), data.size()) == 0;
+    for (size_t i = 0; i < m_block_count; ++i) {
+        const auto content = block(i);
+        if (std::memcmp(content.data(), data.data() + i * static_cast<size_t>(m_block_size), content.size()) != 0)
+            return false;
+    }
+    return true;
+}
+
+Fingerprint ContentReader::fingerprint() const {
+    if (!m_compressed)
+        return fingerprint_data(m_data);
+    const auto head_size = std::min<std::uint64_t>(m_size, Fingerprint::sample_size);
+    const auto tail_size = std::min<std::uint64_t>(m_size - head_size, Fingerprint::sample_size);
+    std::vector<std::byte> sample(static_cast<size_t>(head_size + tail_size));
+    read(0, std::span{sample}.first(static_cast<size_t>(head_size)));
+    read(m_size - tail_size, std::span{sample}.subspan(static_cast<size_t>(head_size)));
+    return Fingerprint{m_size, xxh64(sample)};
+}
+
+} // namespace filestore
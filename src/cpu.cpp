@@ -0,0 +1,96 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/cpu.h"
+
+#include <cstdint>
+
+#if defined(FILESTORE_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace filestore {
+
+#if defined(FILESTORE_X86)
+namespace {
+
+struct cpuid_regs {
+    std::uint32_t eax{0}, ebx{0}, ecx{0}, edx{0};
+};
+
+cpuid_regs cpuid(std::uint32_t leaf, std::uint32_t subleaf = 0) {
+    cpuid_regs r;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+    r.eax = regs[0];
+    r.ebx = regs[1];
+    r.ecx = regs[2];
+    r.edx = regs[3];
+#else
+    __cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+#endif
+    return r;
+}
+
+std::uint64_t xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    std::uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+bool bit(std::uint32_t reg, int n) {
+    return (reg >> n) & 1U;
+}
+
+cpu_features detect_features() {
+    cpu_features features;
+
+    const auto max_leaf = cpuid(0).eax;
+    if (max_leaf < 1)
+        return features;
+
+    const auto leaf1 = cpuid(1);
+    features.ssse3 = bit(leaf1.ecx, 9);
+    features.sse41 = bit(leaf1.ecx, 19);
+    features.sse42 = bit(leaf1.ecx, 20);
+
+    // AVX state has to be enabled by the operating system
+    const bool osxsave = bit(leaf1.ecx, 27);
+    const auto xcr0 = osxsave ? xgetbv() : 0;
+    const bool ymm_enabled = (xcr0 & 0x06) == 0x06;
+    const bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+
+    if (max_leaf >= 7) {
+        const auto leaf7 = cpuid(7);
+        features.avx2 = ymm_enabled && bit(leaf7.ebx, 5);
+        features.avx512f = zmm_enabled && bit(leaf7.ebx, 16);
+        features.sha = bit(leaf7.ebx, 29);
+    }
+    return features;
+}
+
+} // namespace
+#endif
+
+const cpu_features &cpu() {
+#if defined(FILESTORE_X86)
+    static const cpu_features features = detect_features();
+#else
+    static const cpu_features features{};
+#endif
+    return features;
+}
+
+} // namespace filestore
@@ -0,0 +1,68 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/crc32c.h"
+#include "FileStore/cpu.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+constexpr std::uint32_t polynomial = 0x82f63b78; // reversed Castagnoli polynomial
+
+constexpr std::array<std::uint32_t, 256> make_table() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr auto table = make_table();
+
+std::uint32_t crc32c_generic(const std::byte *data, size_t size, std::uint32_t crc) {
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ std::to_integer<std::uint32_t>(data[i])) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+FILESTORE_TARGET("sse4.2")
+std::uint32_t crc32c_sse42(const std::byte *data, size_t size, std::uint32_t crc) {
+    std::uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        std::uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    for (; size > 0; --size, ++data)
+        crc = _mm_crc32_u8(crc, std::to_integer<unsigned char>(*data));
+    return crc;
+}
+#endif
+
+} // namespace
+
+std::uint32_t crc32c(std::span<const std::byte> data, std::uint32_t crc) {
+    crc = ~crc;
+#if defined(__x86_64__) || defined(_M_X64)
+    if (cpu().sse42)
+        return ~crc32c_sse42(data.data(), data.size(), crc);
+#endif
+    return ~crc32c_generic(data.data(), data.size(), crc);
+}
+
+} // namespace filestore
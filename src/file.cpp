@@ -4,40 +4,465 @@
  * ******************************************************* */
 
 #include "FileStore/file.h"
+#include "FileStore/bin_utils.h"
+#include "FileStore/mapped_file.h"
+#include "FileStore/xxhash.h"
+#include <algorithm>
 #include <fstream>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
 #include <vector>
 
+#if defined(__linux__)
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#endif
+
 namespace filestore {
 
+Fingerprint fingerprint_file(const fs::path &file_path) {
+    std::ifstream input{file_path, std::ios_base::binary | std::ios_base::ate};
+    if (!input)
+        throw FileError{"Could not open file", file_path};
+
+    Fingerprint fingerprint;
+    fingerprint.size = static_cast<std::uint64_t>(input.tellg());
+
+    // small files are sampled completely, otherwise head and tail
+    const auto head_size = std::min(fingerprint.size, Fingerprint::sample_size);
+    const auto tail_size = std::min(fingerprint.size - head_size, Fingerprint::sample_size);
+    std::vector<char> sample(head_size + tail_size);
+    input.seekg(0);
+    input.read(sample.data(), static_cast<std::streamsize>(head_size));
+    input.seekg(static_cast<std::streamoff>(fingerprint.size - tail_size));
+    input.read(sample.data() + head_size, static_cast<std::streamsize>(tail_size));
+    if (!input)
+        throw FileError{"Error reading input file", file_path};
+
+    fingerprint.sample_hash = xxh64(std::as_bytes(std::span{sample}));
+    return fingerprint;
+}
+
+Fingerprint fingerprint_data(std::span<const std::byte> data) {
+    const auto head_size = std::min<std::uint64_t>(data.size(), Fingerprint::sample_size);
+    const auto tail_size = std::min<std::uint64_t>(data.size() - head_size, Fingerprint::sample_size);
+    if (tail_size == 0)
+        return Fingerprint{data.size(), xxh64(data)};
+
+    std::vector<std::byte> sample(head_size + tail_size);
+    std::memcpy(sample.data(), data.data(), head_size);
+    std::memcpy(sample.data() + head_size, data.data() + data.size() - tail_size, tail_size);
+    return Fingerprint{data.size(), xxh64(sample)};
+}
+
 bool files_have_same_size(const fs::path &path1, const fs::path &path2) {
     auto size1 = fs::file_size(path1);
     auto size2 = fs::file_size(path2);
     return size1 == size2;
 }
 
+// Both files are mapped and compared block by block with memcmp. Large files are probed at a few places spread
+// over the file first, as files of the same size usually differ all over, and most mismatches are found without
+// reading them completely. The files are compared as they are, even if one is compressed.
 bool files_are_equal(const fs::path &existing_file, const fs::path &candidate_file) {
-    constexpr std::streamsize BufferSize = 65536u;
+    constexpr size_t BufferSize = 1u << 20;
+    constexpr size_t SampleSize = 4096u;
+    constexpr size_t SampleCount = 8u;
 
-    if (!files_have_same_size(existing_file, candidate_file))
+    const MappedFile file1{existing_file};
+    const MappedFile file2{candidate_file};
+    if (file1.size() != file2.size())
         return false;
 
-    std::ifstream file1(existing_file, std::ios_base::binary);
-    std::ifstream file2(candidate_file, std::ios_base::binary);
+    const auto data1 = file1.data();
+    const auto data2 = file2.data();
+    const auto size = data1.size();
+    const auto equal = [&](size_t offset, size_t length) {
+        return std::memcmp(data1.data() + offset, data2.data() + offset, length) == 0;
+    };
 
-    if (!file1.is_open())
-        throw FileError{"Could not open file", existing_file};
-    if (!file2.is_open())
-        throw FileError{"Could not open file", candidate_file};
+    if (size >= 4 * BufferSize) {
+        for (size_t i = 1; i <= SampleCount; ++i) {
+            const auto offset = (size - SampleSize) / SampleCount * i;
+            if (!equal(offset, SampleSize))
+                return false;
+        }
+    }
 
-    if (!std::equal(std::istreambuf_iterator<char>(file1), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(file2)))
-        return false;
+    file1.advise(AccessPattern::sequential);
+    file2.advise(AccessPattern::sequential);
+    for (size_t offset = 0; offset < size; offset += BufferSize) {
+        if (!equal(offset, std::min(BufferSize, size - offset)))
+            return false;
+    }
+    return true;
+}
+
+bool file_has_contents(const fs::path &file_path, std::span<const std::byte> data) {
+    const MappedFile file{file_path};
+    return std::ranges::equal(file.data(), data);
+}
+
+std::vector<char> read_file(const fs::path &file_path) {
+    std::ifstream input{file_path, std::ios_base::binary | std::ios_base::ate};
+    if (!input)
+        throw FileError{"Could not open file", file_path};
+
+    std::vector<char> data(static_cast<size_t>(input.tellg()));
+    input.seekg(0);
+    if (!input.read(data.data(), static_cast<std::streamsize>(data.size())))
+        throw FileError{"Error reading input file", file_path};
+    return data;
+}
+
+namespace {
+
+std::string unique_file_name() {
+    thread_local std::mt19937_64 rng{std::random_device{}()};
+    const auto value = rng();
+    const auto bytes = std::bit_cast<std::array<std::byte, sizeof(value)>>(value);
+    return bytes_to_hex(bytes.begin(), bytes.end()) + ".tmp";
+}
+
+} // namespace
+
+TempFile::TempFile(const fs::path &directory) {
+    fs::create_directories(directory);
+    for (int attempt = 0; attempt < 16 && !m_stream.is_open(); ++attempt) {
+        m_path = directory / unique_file_name();
+        m_stream.open(m_path, std::ios_base::binary | std::ios_base::noreplace);
+    }
+    if (!m_stream.is_open())
+        throw FileError{"Could not create file", m_path};
+}
+
+TempFile::~TempFile() {
+    if (m_committed)
+        return;
+    m_stream.close();
+    std::error_code ec;
+    fs::remove(m_path, ec);
+}
+
+void TempFile::write(std::span<const char> data) {
+    if (!m_stream.write(data.data(), static_cast<std::streamsize>(data.size())))
+        throw FileError{"Error writing file", m_path};
+}
+
+void TempFile::close() {
+    if (!m_stream.is_open())
+        return;
+    m_stream.close();
+    if (!m_stream)
+        throw FileError{"Error writing file", m_path};
+}
+
+void TempFile::commit(const fs::path &target) {
+    close();
+    fs::create_directories(target.parent_path());
+    fs::rename(m_path, target);
+    m_committed = true;
+}
+
+bool TempFile::try_commit(const fs::path &target) {
+    close();
+    m_committed = publish_file(m_path, target);
+    return m_committed;
+}
 
-    if (file1.bad())
-        throw FileError{"Error reading input file", existing_file};
-    if (file2.bad())
-        throw FileError{"Error reading input file", candidate_file};
+namespace {
 
+#if defined(__linux__)
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd) : m_fd{fd} {}
+    ~FileDescriptor() {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+    int get() const { return m_fd; }
+    explicit operator bool() const { return m_fd >= 0; }
+private:
+    int m_fd;
+};
+
+bool is_unsupported(int error) {
+    return error == EXDEV || error == ENOSYS || error == EINVAL || error == EOPNOTSUPP || error == ENOTTY || error == EPERM;
+}
+
+// Returns false, if the kernel cannot copy between these files. Errors after the first chunk are real errors.
+bool kernel_copy(int source, int target, const fs::path &target_path) {
+    bool use_copy_file_range = true;
+    bool started = false;
+    while (true) {
+        static constexpr size_t chunk_size = 1U << 30;
+        const auto copied = use_copy_file_range ? ::copy_file_range(source, nullptr, target, nullptr, chunk_size, 0) : ::sendfile(target, source, nullptr, chunk_size);
+        if (copied == 0)
+            return true;
+        if (copied > 0) {
+            started = true;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (!started && is_unsupported(errno)) {
+            if (!use_copy_file_range)
+                return false;
+            use_copy_file_range = false;
+            continue;
+        }
+        throw FileError{"Error copying file", target_path};
+    }
+}
+
+void user_copy(int source, int target, const fs::path &source_path, const fs::path &target_path) {
+    static constexpr size_t buffer_size = 1U << 20;
+    std::vector<char> buffer(buffer_size);
+    while (true) {
+        const auto bytes_read = ::read(source, buffer.data(), buffer.size());
+        if (bytes_read == 0)
+            return;
+        if (bytes_read < 0) {
+            if (errno == EINTR)
+                continue;
+            throw FileError{"Error reading input file", source_path};
+        }
+        for (ssize_t written = 0; written < bytes_read;) {
+            const auto result = ::write(target, buffer.data() + written, static_cast<size_t>(bytes_read - written));
+            if (result < 0 && errno != EINTR)
+                throw FileError{"Error writing file", target_path};
+            if (result > 0)
+                written += result;
+        }
+    }
+}
+
+TransferMode copy_contents(const fs::path &source, const fs::path &target, TransferMode mode) {
+    FileDescriptor input{::open(source.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!input)
+        throw FileError{"Could not open file", source};
+    struct stat status;
+    if (::fstat(input.get(), &status) != 0)
+        throw FileError{"Could not open file", source};
+
+    FileDescriptor output{::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, status.st_mode & 07777)};
+    if (!output)
+        throw FileError{"Could not create file", target};
+
+    try {
+        if (mode >= TransferMode::reflink && ::ioctl(output.get(), FICLONE, input.get()) == 0)
+            return TransferMode::reflink;
+        if (mode >= TransferMode::kernel_copy && kernel_copy(input.get(), output.get(), target))
+            return TransferMode::kernel_copy;
+        user_copy(input.get(), output.get(), source, target);
+        return TransferMode::copy;
+    } catch (...) {
+        std::error_code ec;
+        fs::remove(target, ec);
+        throw;
+    }
+}
+
+// The record getdents64 fills in, which older C libraries have no declaration for
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Reads the entries in batches of the buffer size. Subdirectories are listed after the directory, so the buffer is
+// shared by all of them.
+void list_directory(int dir_fd, const fs::path &dir_path, std::vector<char> &buffer, std::vector<DirectoryFile> &files,
+                    std::vector<fs::path> *unreadable) {
+    std::vector<std::string> subdirectories;
+    while (true) {
+        const auto length = ::syscall(SYS_getdents64, dir_fd, buffer.data(), buffer.size());
+        if (length == 0)
+            break;
+        if (length < 0) {
+            if (!unreadable)
+                throw FileError{"Could not read directory", dir_path};
+            unreadable->push_back(dir_path);
+            return;
+        }
+        for (long offset = 0; offset < length;) {
+            const auto *entry = reinterpret_cast<const linux_dirent64 *>(buffer.data() + offset);
+            offset += entry->d_reclen;
+            const std::string_view name{entry->d_name};
+            if (name == "." || name == "..")
+                continue;
+            auto type = entry->d_type;
+            if (type == DT_UNKNOWN) { // not every file system records the type in the directory
+                struct stat status;
+                if (::fstatat(dir_fd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) != 0)
+                    continue;
+                type = S_ISREG(status.st_mode) ? DT_REG : S_ISDIR(status.st_mode) ? DT_DIR : DT_UNKNOWN;
+            }
+            if (type == DT_REG)
+                files.push_back(DirectoryFile{dir_path / name, entry->d_ino});
+            else if (type == DT_DIR)
+                subdirectories.emplace_back(name);
+        }
+    }
+    for (const auto &name : subdirectories) {
+        FileDescriptor subdirectory{::openat(dir_fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)};
+        if (subdirectory)
+            list_directory(subdirectory.get(), dir_path / name, buffer, files, unreadable);
+        else if (unreadable)
+            unreadable->push_back(dir_path / name);
+        else
+            throw FileError{"Could not open directory", dir_path / name};
+    }
+}
+#else
+TransferMode copy_contents(const fs::path &source, const fs::path &target, TransferMode) {
+    fs::copy_file(source, target);
+    return TransferMode::copy;
+}
+#endif
+
+} // namespace
+
+TransferMode transfer_file(const fs::path &source, const fs::path &target, TransferMode mode) {
+    std::error_code ec;
+    if (mode == TransferMode::move) {
+        fs::rename(source, target, ec);
+        if (!ec)
+            return TransferMode::move;
+    }
+    if (mode == TransferMode::hardlink) {
+        fs::create_hard_link(source, target, ec);
+        if (!ec)
+            return TransferMode::hardlink;
+    }
+
+    const auto used_mode = copy_contents(source, target, mode);
+    if (mode == TransferMode::move)
+        fs::remove(source, ec); // the file is stored, a source that cannot be removed is no reason to fail
+    return used_mode;
+}
+
+// A rename that does not replace the target, where the file system supports it, a hard link otherwise. Both fail,
+// if the target exists.
+bool publish_file(const fs::path &source, const fs::path &target) {
+    fs::create_directories(target.parent_path());
+#if defined(__linux__)
+    if (::renameat2(AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str(), RENAME_NOREPLACE) == 0)
+        return true;
+    if (errno == EEXIST)
+        return false;
+    if (!is_unsupported(errno))
+        throw FileError{"Could not move file", target};
+#endif
+    std::error_code ec;
+    fs::create_hard_link(source, target, ec);
+    if (ec == std::errc::file_exists)
+        return false;
+    if (ec)
+        throw FileError{"Could not create file", target};
+    fs::remove(source, ec);
     return true;
 }
 
+std::vector<DirectoryFile> list_files(const fs::path &directory, std::vector<fs::path> *unreadable) {
+    std::vector<DirectoryFile> files;
+#if defined(__linux__)
+    FileDescriptor dir{::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (!dir)
+        throw FileError{"Could not open directory", directory};
+    std::vector<char> buffer(256 * 1024);
+    list_directory(dir.get(), directory, buffer, files, unreadable);
+#else
+    if (!fs::is_directory(directory))
+        throw FileError{"Could not open directory", directory};
+    // directories that cannot be read are skipped without being reported here
+    (void)unreadable;
+    for (const auto &entry : fs::recursive_directory_iterator{directory, fs::directory_options::skip_permission_denied}) {
+        if (entry.is_regular_file() && !entry.is_symlink())
+            files.push_back(DirectoryFile{entry.path(), 0});
+    }
+#endif
+    return files;
+}
+
+void prefetch_file(const fs::path &file_path) {
+#if defined(__linux__)
+    const FileDescriptor file{::open(file_path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file)
+        ::posix_fadvise(file.get(), 0, 0, POSIX_FADV_WILLNEED);
+#else
+    (void)file_path;
+#endif
+}
+
+FileRemover::~FileRemover() {
+#if defined(__linux__)
+    if (m_directory_fd >= 0)
+        ::close(m_directory_fd);
+#endif
+}
+
+bool FileRemover::remove(const fs::path &file_path) {
+    auto directory = file_path.parent_path();
+    if (m_directories.empty() || directory != m_directories.back())
+        m_directories.push_back(directory);
+#if defined(__linux__)
+    if (m_directory_fd < 0 || directory != m_directory) {
+        if (m_directory_fd >= 0)
+            ::close(m_directory_fd);
+        m_directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        m_directory = std::move(directory);
+        if (m_directory_fd < 0) {
+            if (errno == ENOENT)
+                return false;
+            throw FileError{"Could not open directory", m_directory};
+        }
+    }
+    if (::unlinkat(m_directory_fd, file_path.filename().c_str(), 0) == 0)
+        return true;
+    if (errno == ENOENT)
+        return false;
+    throw FileError{"Could not remove file", file_path};
+#else
+    std::error_code ec;
+    const auto removed = fs::remove(file_path, ec);
+    if (ec)
+        throw FileError{"Could not remove file", file_path};
+    return removed;
+#endif
+}
+
+// Deepest first, so directories emptied by removing their subdirectories are removed, too
+size_t remove_empty_directories(std::vector<fs::path> directories, const fs::path &root) {
+    std::ranges::sort(directories, std::greater{}, [](const fs::path &dir) { return std::distance(dir.begin(), dir.end()); });
+    size_t removed = 0;
+    for (auto directory : directories) {
+        if (std::ranges::mismatch(root, directory).in1 != root.end())
+            continue;
+        std::error_code ec;
+        while (directory != root && fs::remove(directory, ec)) {
+            ++removed;
+            directory = directory.parent_path();
+        }
+    }
+    return removed;
+}
+
 } // namespace filestore
@@ -5,52 +5,1602 @@
 
 #include "FileStore/filestore.h"
 #include "FileStore/bin_utils.h"
+#include "FileStore/catalog.h"
 #include "FileStore/file.h"
 #include "FileStore/hash.h"
+#include "FileStore/sha256_multi.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace filestore {
 
-FileStore::FileStore(const fs::path &root, int folder_levels) : m_root_path{root}, m_folder_levels{folder_levels} {
+namespace {
+
+Key key_from_hash(const SHA256::hash_type &hash) {
+    Key key{};
+    std::memcpy(key.data.data(), hash.data.data(), hash.bytelength);
+    return key;
+}
+
+// The key of an object from the end of its path: folder_levels folders of two digits and the file name. The
+// digits are collected in a fixed buffer, so no memory is allocated.
+template<typename CharT>
+std::optional<Key> key_from_path(std::basic_string_view<CharT> path, int folder_levels) {
+    const auto is_separator = [](CharT c) { return c == CharT('/') || c == CharT(fs::path::preferred_separator); };
+    if (folder_levels < 0 || 2 * static_cast<size_t>(folder_levels) >= Key::string_length)
+        return std::nullopt;
+
+    std::array<char, Key::string_length> digits;
+    auto end = path.size();
+    auto filled = digits.size();
+    for (int i = 0; i <= folder_levels; ++i) {
+        const size_t length = i == 0 ? Key::string_length - 2 * folder_levels : 2;
+        if (end < length + 1 || !is_separator(path[end - length - 1]))
+            return std::nullopt;
+        for (size_t j = 0; j < length; ++j) {
+            const auto c = path[end - length + j];
+            if (c < CharT('0') || c > CharT('f'))
+                return std::nullopt;
+            digits[filled - length + j] = static_cast<char>(c);
+        }
+        filled -= length;
+        end -= length + 1;
+    }
+    return from_string({digits.data(), digits.size()});
+}
+
+// The directory of the objects whose keys start with prefix, if it is not split
+fs::path prefix_path(const fs::path &root, std::span<const std::byte> prefix) {
+    auto path = root;
+    for (const auto b : prefix)
+        path /= byte_to_hex(b);
+    return path;
+}
+
+std::int64_t to_unix_nanoseconds(fs::file_time_type time) {
+    const auto system_time = std::chrono::file_clock::to_sys(time);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(system_time.time_since_epoch()).count();
+}
+
+constexpr size_t read_buffer_size = 1U << 20;
+
+// Returns the chunks of a stream, an empty one at its end
+std::function<std::span<const char>()> read_chunks(std::istream &input, const fs::path &file_path) {
+    auto buffer = std::make_shared<std::vector<char>>(read_buffer_size);
+    return [&input, file_path, buffer]() {
+        if (!input)
+            return std::span<const char>{};
+        input.read(buffer->data(), static_cast<std::streamsize>(buffer->size()));
+        if (input.bad())
+            throw FileError("Error reading input file", file_path);
+        return std::span<const char>{buffer->data(), static_cast<size_t>(input.gcount())};
+    };
+}
+
+std::function<std::span<const char>()> read_chunks(int fd) {
+    auto buffer = std::make_shared<std::vector<char>>(read_buffer_size);
+    return [fd, buffer]() {
+        while (true) {
+#if defined(_WIN32)
+            const auto result = ::_read(fd, buffer->data(), static_cast<unsigned>(buffer->size()));
+#else
+            const auto result = ::read(fd, buffer->data(), buffer->size());
+#endif
+            if (result >= 0)
+                return std::span<const char>{buffer->data(), static_cast<size_t>(result)};
+            if (errno != EINTR)
+                throw FileError("Error reading input file", {});
+        }
+    };
+}
+
+// Whether raw content would be taken for an encoded object file, so it must be escaped in the block format. Only
+// the first bytes are read, unless they are those of a manifest.
+bool looks_encoded(const fs::path &content_path) {
+    std::array<std::byte, 64> header;
+    std::ifstream input{content_path, std::ios_base::binary};
+    input.read(reinterpret_cast<char *>(header.data()), header.size());
+    const auto data = std::span{header}.first(static_cast<size_t>(input.gcount()));
+    return is_compressed(data) || (ChunkManifest::has_magic(data) && ChunkManifest::parse(MappedFile{content_path}.data()));
+}
+
+// Leaves files: the header, followed by the leaf hashes
+struct leaves_header {
+    char magic[8];
+    std::uint32_t leaf_size;
+    std::uint32_t reserved;
+    std::uint64_t count;
+};
+
+// The leaf hashes, if the file has them for content of size bytes in leaves of leaf_size bytes
+std::optional<std::vector<TreeHash::hash_type>> read_leaves(const fs::path &file_path, std::uint32_t leaf_size, std::uint64_t size) {
+    std::ifstream input{file_path, std::ifstream::binary};
+    leaves_header header{};
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return std::nullopt;
+    if (std::string_view{header.magic, sizeof(header.magic)} != "FSLEAVES" || header.leaf_size != leaf_size || header.count != (size + leaf_size - 1) / leaf_size)
+        return std::nullopt;
+    std::vector<TreeHash::hash_type> leaves(header.count);
+    if (!input.read(reinterpret_cast<char *>(leaves.data()), static_cast<std::streamsize>(leaves.size() * sizeof(TreeHash::hash_type))))
+        return std::nullopt;
+    return leaves;
+}
+
+bool key_matches(const Key &key, const hash_value<256> &hash) {
+    return std::memcmp(hash.data.data(), key.data.data(), hash.bytelength) == 0;
+}
+
+// Whether path is dir or below it
+bool is_within(const fs::path &path, const fs::path &dir) {
+    return std::ranges::mismatch(dir, path).in1 == dir.end();
+}
+
+// Spreads reads over time, so no more than bytes_per_second are read on average by all threads together. Each read
+// gets the next free slot of time; the thread waits until it begins.
+class Throttle {
+public:
+    explicit Throttle(std::uint64_t bytes_per_second) : m_bytes_per_second{bytes_per_second} {}
+
+    void wait(std::uint64_t bytes) {
+        if (m_bytes_per_second == 0)
+            return;
+        const auto duration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>{static_cast<double>(bytes) / static_cast<double>(m_bytes_per_second)});
+        clock::time_point start;
+        {
+            std::lock_guard lock{m_mutex};
+            m_next = std::max(m_next, clock::now());
+            start = m_next;
+            m_next += duration;
+        }
+        std::this_thread::sleep_until(start);
+    }
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::uint64_t m_bytes_per_second;
+    std::mutex m_mutex;
+    clock::time_point m_next{};
+};
+
+// A KeyHasher, that records its time and the data in the metrics
+class MeasuredHasher {
+public:
+    MeasuredHasher(const StoreConfig &config, Metrics &metrics) : m_hasher{config}, m_metrics{metrics}, m_timer{metrics.hash_time, false} {}
+
+    void update(std::span<const char> data) {
+        m_timer.start();
+        m_hasher.update(data);
+        m_timer.stop();
+        m_metrics.bytes_hashed.add(data.size());
+    }
+    ContentHash hash() {
+        m_timer.start();
+        auto result = m_hasher.hash();
+        m_timer.stop();
+        return result;
+    }
+private:
+    KeyHasher m_hasher;
+    Metrics &m_metrics;
+    Metrics::Timer m_timer;
+};
+
+} // namespace
+
+FileStore::FileStore(const fs::path &root, int folder_levels) : FileStore{root, StoreOptions{.folder_levels = folder_levels}} {}
+
+FileStore::FileStore(const fs::path &root, const StoreOptions &options)
+    : m_root_path{root}, m_folder_levels{options.folder_levels}, m_import_mode{options.import_mode}, m_import_locks{std::make_shared<import_locks>()},
+      m_pack_threshold{options.pack_threshold}, m_compression{options.compression}, m_gc{std::make_shared<gc_state>()}, m_io_queue_depth{options.io_queue_depth},
+      m_metrics{std::make_shared<Metrics>()}, m_async{std::make_shared<async_state>()} {
+    // objects of existing stores were keyed without a recorded config, so only new stores get another one
+    std::error_code ec;
+    const bool new_store = !fs::exists(m_root_path, ec) || fs::is_empty(m_root_path, ec);
     // no need to check, if m_root_path exists. In that case, the call does nothing
     fs::create_directories(m_root_path);
+    if (fs::exists(config_path())) {
+        m_config = StoreConfig::load(config_path());
+    } else if (new_store && options.config != StoreConfig{}) {
+        fs::create_directories(metadata_path());
+        options.config.save(config_path());
+        m_config = options.config;
+    }
+    if (options.config != StoreConfig{} && options.config != m_config)
+        throw std::invalid_argument{"Store was created with another key scheme"};
+    if (options.shard_split_threshold > 0 || fs::exists(shards_path())) {
+        m_shards = std::make_shared<shard_state>();
+        if (fs::exists(shards_path())) {
+            m_shards->layout = std::make_unique<ShardLayout>(shards_path());
+            if (options.shard_split_threshold > 0 && options.shard_split_threshold != m_shards->layout->split_threshold()) {
+                m_shards->layout->set_split_threshold(options.shard_split_threshold);
+                m_shards->layout->save(shards_path());
+            }
+        } else {
+            // the objects of a store with fixed folder levels are where this layout expects them
+            fs::create_directories(metadata_path());
+            m_shards->layout = std::make_unique<ShardLayout>(m_folder_levels, options.shard_split_threshold);
+            m_shards->layout->save(shards_path());
+        }
+    }
+    // packs written before are read, even if no new objects are packed
+    if (options.pack_threshold > 0 || fs::exists(packs_path()))
+        m_packs = std::make_shared<PackStore>(packs_path());
+    // the marker stays, so stores opened later know to look into the object files
+    if (m_compression.algorithm != Compression::none) {
+        if (!compression_available(m_compression.algorithm))
+            throw std::invalid_argument{"Compression algorithm not available"};
+        fs::create_directories(metadata_path());
+        std::ofstream{compressed_marker_path(), std::ios_base::app};
+    }
+    m_chunking = options.chunking;
+    if (m_chunking.min_file_size > 0 || fs::exists(chunks_path())) {
+        // the chunks are objects of a store of their own, stored like the other objects
+        m_chunks = std::make_shared<FileStore>(chunks_path(), StoreOptions{.folder_levels = options.folder_levels,
+                                                                           .key_index = options.key_index,
+                                                                           .pack_threshold = options.pack_threshold,
+                                                                           .compression = options.compression,
+                                                                           .shard_split_threshold = options.shard_split_threshold});
+        m_chunks->m_metrics = m_metrics;
+    }
+    m_compressed_objects = std::make_shared<std::atomic<bool>>(fs::exists(compressed_marker_path()));
+    if (options.key_index)
+        m_key_index = std::make_shared<key_index_state>();
+    if (options.catalog) {
+        fs::create_directories(metadata_path());
+        bool valid = fs::exists(catalog_path());
+        try {
+            m_catalog = std::make_shared<Catalog>(catalog_path());
+        } catch (const FileError &) { // written by an older version
+            fs::remove(catalog_path());
+            m_catalog = std::make_shared<Catalog>(catalog_path());
+            valid = false;
+        }
+        // the store may already contain objects, or objects the catalog missed, if it was not closed
+        if (!valid || !m_catalog->closed_cleanly())
+            rebuild_catalog();
+    }
+    if (options.mapping_cache_size > 0)
+        m_mapping_cache = std::make_shared<MappingCache>(options.mapping_cache_size);
+    if (options.trust_source_cache) {
+        fs::create_directories(metadata_path());
+        m_source_cache = std::make_shared<SourceCache>(source_cache_path());
+    }
 }
 
 FileStore::import_result FileStore::import(const fs::path &file_path) {
-    auto key = generate_file_key(file_path);
+    if (m_source_cache)
+        return import_source(file_path, SourceCache::describe(file_path), [&]() { return import_file(file_path); });
+    return import_file(file_path);
+}
+
+ContentHash FileStore::hash_file(const fs::path &file_path) const {
+    const Metrics::Timer timer{m_metrics->hash_time};
+    auto hash = hash_file_content(file_path, m_config);
+    if constexpr (metrics_enabled) {
+        std::error_code ec;
+        if (const auto size = fs::file_size(file_path, ec); !ec)
+            m_metrics->bytes_hashed.add(size);
+    }
+    return hash;
+}
+
+ContentHash FileStore::hash_data(std::span<const std::byte> data) const {
+    const Metrics::Timer timer{m_metrics->hash_time};
+    m_metrics->bytes_hashed.add(data.size());
+    return hash_content(data, m_config);
+}
+
+FileStore::import_result FileStore::import_file(const fs::path &file_path) {
+    if (m_import_mode == TransferMode::copy)
+        return import_copy(file_path);
+    const auto hash = hash_file(file_path);
+    return store_leaves(store_file(file_path, key_from_hash(hash.hash)), hash);
+}
+
+std::vector<FileStore::import_result> FileStore::import_many(std::span<const fs::path> file_paths, const ImportOptions &options) {
+    std::vector<import_result> results(file_paths.size());
+    std::vector<std::exception_ptr> errors(file_paths.size());
+
+    // each task hashes as many files as the SHA256 engine has lanes, copies are hashed while copying
+    const auto batch_size = SHA256Multi::lanes();
+    const auto import_batch = [&](size_t begin) {
+        const auto files = file_paths.subspan(begin, std::min(batch_size, file_paths.size() - begin));
+        // files known from the source cache are not read at all
+        std::vector<std::optional<SourceState>> states(files.size());
+        std::vector<std::optional<Key>> cached(files.size());
+        std::vector<fs::path> uncached;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (m_source_cache && (states[i] = SourceCache::describe(files[i])))
+                cached[i] = cached_key(files[i], *states[i]);
+            if (!cached[i])
+                uncached.push_back(files[i]);
+        }
+
+        std::vector<Key> keys;
+        if (m_import_mode != TransferMode::copy && m_config.key_scheme == KeyScheme::sha256 && !uncached.empty()) {
+            try {
+                const Metrics::Timer timer{m_metrics->hash_time};
+                keys = generate_file_keys(uncached);
+                if constexpr (metrics_enabled) {
+                    std::error_code ec;
+                    for (const auto &file : uncached)
+                        if (const auto size = fs::file_size(file, ec); !ec)
+                            m_metrics->bytes_hashed.add(size);
+                }
+            } catch (...) {
+                // import the files one by one below, so the error is reported for the file that caused it
+            }
+        }
+        for (size_t i = 0, next_key = 0; i < files.size(); ++i) {
+            try {
+                if (cached[i])
+                    results[begin + i] = std::unexpected(*cached[i]);
+                else if (keys.empty() && m_source_cache)
+                    results[begin + i] = import_source(files[i], states[i], [&]() { return import_file(files[i]); });
+                else if (keys.empty())
+                    results[begin + i] = import_file(files[i]);
+                else if (m_source_cache)
+                    results[begin + i] = import_source(files[i], states[i], [&, key = keys[next_key++]]() { return store_file(files[i], key); });
+                else
+                    results[begin + i] = store_file(files[i], keys[next_key++]);
+            } catch (...) {
+                errors[begin + i] = std::current_exception();
+            }
+        }
+    };
+
+    std::optional<ThreadPool> own_pool;
+    auto *pool = options.pool;
+    if (pool == nullptr)
+        pool = &own_pool.emplace(options.threads);
+
+    TaskGroup tasks{*pool};
+    for (size_t begin = 0; begin < file_paths.size(); begin += batch_size)
+        tasks.submit([&import_batch, begin]() { import_batch(begin); });
+    tasks.wait();
+
+    for (const auto &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+    return results;
+}
+
+TreeImportReport FileStore::import_tree(const fs::path &directory, const TreeImportOptions &options) {
+    TreeImportReport report;
+    auto files = list_files(directory, &report.failed);
+    // the store, relative to the tree
+    const auto store_path = fs::weakly_canonical(m_root_path).lexically_relative(fs::weakly_canonical(directory));
+    if (!store_path.empty() && *store_path.begin() != "..") {
+        const auto store_dir = (directory / store_path).lexically_normal();
+        std::erase_if(files, [&store_dir](const DirectoryFile &file) { return is_within(file.path.lexically_normal(), store_dir); });
+    }
+    // a stable sort, so files keep the directory order where the platform has no inodes
+    std::ranges::stable_sort(files, {}, &DirectoryFile::inode);
+
+    std::vector<std::optional<import_result>> results(files.size());
+    const auto read_ahead = std::min(options.read_ahead, files.size());
+    for (size_t i = 0; i < read_ahead; ++i)
+        prefetch_file(files[i].path);
+
+    std::optional<ThreadPool> own_pool;
+    auto *pool = options.pool;
+    if (pool == nullptr)
+        pool = &own_pool.emplace(options.threads);
+    // the workers take the files in order from a shared index, as the pool does not run its tasks in order
+    std::atomic<size_t> next_file{0};
+    const auto import_files = [&]() {
+        for (auto i = next_file++; i < files.size(); i = next_file++) {
+            if (read_ahead > 0 && i + read_ahead < files.size())
+                prefetch_file(files[i + read_ahead].path);
+            try {
+                results[i] = import(files[i].path);
+            } catch (...) {
+                // reported as failed below
+            }
+        }
+    };
+    TaskGroup tasks{*pool};
+    for (size_t worker = 0; worker < std::min(pool->size(), files.size()); ++worker)
+        tasks.submit(import_files);
+    tasks.wait();
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!results[i])
+            report.failed.push_back(std::move(files[i].path));
+        else if (results[i]->has_value())
+            report.added.push_back(TreeImportEntry{std::move(files[i].path), results[i]->value()});
+        else
+            report.duplicates.push_back(TreeImportEntry{std::move(files[i].path), results[i]->error()});
+    }
+    return report;
+}
+
+// state is taken before the source is read, nullopt, if it cannot be examined
+FileStore::import_result FileStore::import_source(const fs::path &file_path, const std::optional<SourceState> &state,
+                                                  const std::function<import_result()> &import_content) {
+    if (const auto key = state ? cached_key(file_path, *state) : std::nullopt)
+        return std::unexpected(*key);
+
+    auto result = import_content();
+    if (state)
+        remember_source(file_path, *state, result);
+    return result;
+}
+
+// The source is examined again, as state is taken before it is read
+void FileStore::remember_source(const fs::path &file_path, const SourceState &state, const import_result &result) {
+    // a moved source is gone, a source that changed while it was imported may not match the stored content
+    if (m_import_mode != TransferMode::move && SourceCache::describe(file_path) == state)
+        m_source_cache->insert(file_path, state, result ? *result : result.error());
+}
+
+std::optional<Key> FileStore::cached_key(const fs::path &file_path, const SourceState &state) const {
+    const auto key = m_source_cache->find(file_path, state);
+    if (!key)
+        return std::nullopt;
+    std::shared_lock gc{gc_lock(*key)};
+    if (!key_exists(*key))
+        return std::nullopt;
+    keep_key(*key);
+    return key;
+}
+
+// Sources to be moved are linked into the store instead, so they are only removed, once the object is published
+FileStore::import_result FileStore::store_file(const fs::path &file_path, Key key) {
+    const auto mode = m_import_mode == TransferMode::move ? TransferMode::hardlink : m_import_mode;
+    const auto result = add_object(key, file_path, [&](const fs::path &object_path) {
+        const Metrics::Timer timer{m_metrics->copy_time};
+        transfer_file(file_path, object_path, mode);
+    });
+    if (result && m_import_mode == TransferMode::move) {
+        std::error_code ec;
+        fs::remove(file_path, ec); // the object is stored, a source that cannot be removed is no reason to fail
+    }
+    return result;
+}
+
+// The source is read only once: the data is hashed while it is written to a temporary file in the store, which
+// is moved to its place once the key is known.
+FileStore::import_result FileStore::import_copy(const fs::path &file_path) {
+    const bool tree_keys = m_config.key_scheme == KeyScheme::sha256_tree;
+    // small files are read at once and packed without a temporary file
+    if (m_packs || m_chunks || tree_keys) {
+        std::error_code ec;
+        const auto size = fs::file_size(file_path, ec);
+        if (!ec && should_pack(size)) {
+            const auto content = read_file(file_path);
+            const auto data = std::as_bytes(std::span{content});
+            const auto hash = hash_data(data);
+            return store_leaves(add_packed(key_from_hash(hash.hash), data), hash);
+        }
+        // only new chunks are written, so there is no copy of the whole file. Files of several leaves are read
+        // twice instead, as hashing the leaves in parallel is faster than hashing while copying.
+        if (!ec && (should_chunk(size) || (tree_keys && size > m_config.leaf_size))) {
+            const auto hash = hash_file(file_path);
+            return store_leaves(store_file(file_path, key_from_hash(hash.hash)), hash);
+        }
+    }
+    std::ifstream input{file_path, std::ifstream::binary};
+    if (!input)
+        throw FileError("Could not open file", file_path);
+    return import_stream(read_chunks(input, file_path));
+}
+
+FileStore::import_result FileStore::import(std::span<const std::byte> data) {
+    static constexpr size_t chunk_size = 1U << 20;
+    if (should_pack(data.size())) {
+        const auto hash = hash_data(data);
+        return store_leaves(add_packed(key_from_hash(hash.hash), data), hash);
+    }
+    return import_stream([data]() mutable {
+        const auto chunk = data.first(std::min(chunk_size, data.size()));
+        data = data.subspan(chunk.size());
+        return std::span{reinterpret_cast<const char *>(chunk.data()), chunk.size()};
+    });
+}
+
+FileStore::import_result FileStore::import(std::istream &input) {
+    return import_stream(read_chunks(input, {}));
+}
+
+FileStore::import_result FileStore::import_fd(int fd) {
+    return import_stream(read_chunks(fd));
+}
+
+FileStore::import_result FileStore::import_stream(const std::function<std::span<const char>()> &next_chunk) {
+    TempFile temp{temp_path()};
+    MeasuredHasher hasher{m_config, *m_metrics};
+    {
+        Metrics::Timer copy_timer{m_metrics->copy_time, false};
+        for (auto data = next_chunk(); !data.empty(); data = next_chunk()) {
+            hasher.update(data);
+            copy_timer.start();
+            temp.write(data);
+            copy_timer.stop();
+        }
+        copy_timer.start();
+        temp.close();
+    }
+
+    const auto hash = hasher.hash();
+    return store_leaves(add_object(key_from_hash(hash.hash), temp.path(), [&temp](const fs::path &object_path) { temp.commit(object_path); }), hash);
+}
+
+FileStore::import_result FileStore::add_object(Key key, const fs::path &content_path, const std::function<void(const fs::path &)> &store_object) {
+    const auto size = fs::file_size(content_path);
+    if (should_pack(size)) {
+        const MappedFile content{content_path};
+        return add_packed(key, content.data());
+    }
+
+    // store_object may move the content, the staged file has it then
+    auto compared_path = content_path;
+    // objects whose fingerprint differs cannot be equal, so most new contents need no full comparison
+    std::optional<Fingerprint> fingerprint;
+    const auto content_fingerprint = [&]() -> const Fingerprint & {
+        if (!fingerprint)
+            fingerprint = fingerprint_file(compared_path);
+        return *fingerprint;
+    };
+    // Moves key to the first one, that holds the content or is free. Returns true, if the content is found; it is
+    // kept by a collection running meanwhile then. The distinguisher is not in the first byte, so gc_lock stays.
+    // After a failed publish, the files are checked, too: a key index misses objects published by other stores on
+    // the root or before a crash.
+    std::uint64_t steps = 0;
+    const auto key_taken = [&](bool check_files) {
+        if (key_exists(key))
+            return true;
+        if (!check_files || !fs::exists(get_file_path(key)))
+            return false;
+        if (m_key_index) {
+            auto &index = key_index();
+            std::unique_lock lock{index.mutex};
+            index.keys.insert(key);
+        }
+        return true;
+    };
+    const auto find_content = [&](bool check_files) {
+        std::shared_lock gc{gc_lock(key)};
+        while (key_taken(check_files)) {
+            if (object_equals(key, compared_path, content_fingerprint())) {
+                keep_key(key);
+                return true;
+            }
+            if (!key.increment()) {
+                throw FileError("Key space exhausted", content_path);
+            }
+            ++steps;
+        }
+        return false;
+    };
+    if (find_content(false)) {
+        m_metrics->distinguisher_steps.record(steps);
+        return std::unexpected(key);
+    }
+
+    // The object is created under a temporary name and published under the key with publish_file, which fails,
+    // if another thread or process published an object with the key in the meantime. There is no lock across
+    // processes: the keys are probed again then.
+    TempFile staged{temp_path()};
+    staged.close();
+    fs::remove(staged.path());
+    bool encoded = false;
+    if (should_chunk(size)) {
+        store_chunks(content_path, content_fingerprint(), staged.path());
+        encoded = true;
+    } else if (const bool escape = looks_encoded(content_path); escape || m_compression.algorithm != Compression::none) {
+        const Metrics::Timer timer{m_metrics->copy_time};
+        TempFile temp{temp_path()};
+        encoded = compress_file(content_path, temp, m_compression, escape);
+        if (encoded) {
+            mark_compressed_objects();
+            temp.commit(staged.path());
+        }
+    }
+    if (!encoded) {
+        store_object(staged.path());
+        compared_path = staged.path();
+    }
+    // a directory is not split, while an object is published into it
+    const auto publish = [&]() -> std::optional<CatalogEntry> {
+        std::shared_lock<std::shared_mutex> shard_lock;
+        if (m_shards)
+            shard_lock = std::shared_lock{m_shards->mutex};
+        std::shared_lock gc{gc_lock(key)};
+        const auto path = get_file_path(key);
+        if (!staged.try_commit(path))
+            return std::nullopt;
+        keep_key(key);
+        return describe_object(key, fs::directory_entry{path}, Catalog::now(), true, encoded);
+    };
+    auto entry = publish();
+    while (!entry) {
+        if (find_content(true)) {
+            m_metrics->distinguisher_steps.record(steps);
+            return std::unexpected(key);
+        }
+        entry = publish();
+    }
+    m_metrics->distinguisher_steps.record(steps);
+    // the chunk store records the chunks it adds itself
+    if (!should_chunk(size))
+        m_metrics->bytes_stored.add(size);
+    register_object(*entry);
+    if (m_shards)
+        count_object(key);
+    return key;
+}
+
+void FileStore::store_chunks(const fs::path &content_path, const Fingerprint &fingerprint, const fs::path &object_path) {
+    const MappedFile content{content_path};
+    content.advise(AccessPattern::sequential);
+    ChunkManifest manifest{content.size(), fingerprint.sample_hash, {}};
+    for (auto data = content.data(); !data.empty();) {
+        const auto chunk = data.first(next_chunk_size(data, m_chunking));
+        const auto result = m_chunks->import(chunk);
+        manifest.chunks.push_back(ChunkRef{result ? *result : result.error(), static_cast<std::uint32_t>(chunk.size())});
+        data = data.subspan(chunk.size());
+    }
+
+    TempFile temp{temp_path()};
+    const auto serialized = manifest.serialize();
+    temp.write({reinterpret_cast<const char *>(serialized.data()), serialized.size()});
+    temp.commit(object_path);
+}
+
+bool FileStore::chunks_equal(const ChunkManifest &manifest, std::span<const std::byte> content) const {
+    if (manifest.size != content.size())
+        return false;
+    for (const auto &chunk : manifest.chunks) {
+        if (!chunk_store().read(chunk.key).equals(content.first(chunk.size)))
+            return false;
+        content = content.subspan(chunk.size);
+    }
+    return true;
+}
+
+const FileStore &FileStore::chunk_store() const {
+    if (!m_chunks)
+        throw FileError{"Chunk store missing", chunks_path()};
+    return *m_chunks;
+}
+
+std::vector<std::byte> FileStore::assemble(const ChunkManifest &manifest) const {
+    std::vector<std::byte> content;
+    content.reserve(manifest.size);
+    for (const auto &chunk : manifest.chunks)
+        chunk_store().read_stream(chunk.key, [&content](std::span<const std::byte> data) { content.insert(content.end(), data.begin(), data.end()); });
+    return content;
+}
+
+FileStore::import_result FileStore::add_packed(Key key, std::span<const std::byte> content) {
+    std::lock_guard lock{import_lock(key)};
+    std::shared_lock gc{gc_lock(key)};
+    const auto fingerprint = fingerprint_data(content);
+    std::uint64_t steps = 0;
     while (key_exists(key)) {
-        if (files_are_equal(get_file_path(key), file_path))
+        if (object_equals(key, content, fingerprint)) {
+            m_metrics->distinguisher_steps.record(steps);
+            keep_key(key);
             return std::unexpected(key);
+        }
         if (!key.increment()) {
-            throw FileError("Key space exhausted", file_path);
+            throw FileError("Key space exhausted", {});
         }
+        ++steps;
+    }
+    m_metrics->distinguisher_steps.record(steps);
+    const auto now = Catalog::now();
+    {
+        const Metrics::Timer timer{m_metrics->copy_time};
+        m_packs->add(key, content, now);
     }
-    const auto path = get_file_path(key);
-    fs::create_directories(path.parent_path());
-    fs::copy(file_path, path);
+    m_metrics->bytes_stored.add(content.size());
+    register_object(CatalogEntry{key, content.size(), now, now, fingerprint.sample_hash});
+    keep_key(key);
     return key;
 }
 
+// The stored object may be packed or not, whichever way the new content would be stored
+bool FileStore::object_equals(const Key &key, const fs::path &content_path, const Fingerprint &fingerprint) const {
+    const Metrics::Timer timer{m_metrics->compare_time};
+    if (const auto packed = m_packs ? m_packs->read(key) : std::nullopt)
+        return fingerprint_data(packed->data) == fingerprint && file_has_contents(content_path, packed->data);
+    const auto existing = map_object_file(key);
+    if (const auto manifest = parse_manifest(existing.data()))
+        return manifest->fingerprint() == fingerprint && chunks_equal(*manifest, MappedFile{content_path}.data());
+    const auto reader = content_reader(existing.data());
+    if (reader.fingerprint() != fingerprint)
+        return false;
+    return reader.compressed() ? reader.equals(MappedFile{content_path}.data()) : files_are_equal(get_file_path(key), content_path);
+}
+
+bool FileStore::object_equals(const Key &key, std::span<const std::byte> content, const Fingerprint &fingerprint) const {
+    const Metrics::Timer timer{m_metrics->compare_time};
+    if (const auto packed = m_packs ? m_packs->read(key) : std::nullopt)
+        return fingerprint_data(packed->data) == fingerprint && std::ranges::equal(packed->data, content);
+    const auto existing = map_object_file(key);
+    if (const auto manifest = parse_manifest(existing.data()))
+        return manifest->fingerprint() == fingerprint && chunks_equal(*manifest, content);
+    const auto reader = content_reader(existing.data());
+    return reader.fingerprint() == fingerprint && reader.equals(content);
+}
+
+void FileStore::register_object(const CatalogEntry &entry) {
+    if (m_catalog)
+        m_catalog->add(entry);
+    if (m_key_index) {
+        std::unique_lock index_lock{m_key_index->mutex};
+        m_key_index->keys.insert(entry.key);
+    }
+}
+
+FileStore::import_result FileStore::store_leaves(const import_result &result, const ContentHash &hash) {
+    if (!result || hash.leaves.size() < 2)
+        return result;
+    const leaves_header header{{'F', 'S', 'L', 'E', 'A', 'V', 'E', 'S'}, m_config.leaf_size, 0, hash.leaves.size()};
+    TempFile temp{temp_path()};
+    temp.write({reinterpret_cast<const char *>(&header), sizeof(header)});
+    temp.write({reinterpret_cast<const char *>(hash.leaves.data()), hash.leaves.size() * sizeof(TreeHash::hash_type)});
+    temp.close();
+    temp.commit(leaves_path(*result));
+    return result;
+}
+
+std::future<FileStore::import_result> FileStore::import_async(const fs::path &file_path) {
+    auto result = std::make_shared<std::promise<import_result>>();
+    auto future = result->get_future();
+
+    std::optional<SourceState> source_state;
+    if (m_source_cache) {
+        source_state = SourceCache::describe(file_path);
+        if (const auto key = source_state ? cached_key(file_path, *source_state) : std::nullopt) {
+            result->set_value(std::unexpected(*key));
+            return future;
+        }
+    }
+
+    // the object is added, once all data is read
+    auto hasher = std::make_shared<MeasuredHasher>(m_config, *m_metrics);
+    std::shared_ptr<TempFile> temp;
+    if (m_import_mode == TransferMode::copy) {
+        temp = std::make_shared<TempFile>(temp_path());
+        temp->close();
+    }
+    const auto on_data = [hasher](std::span<const char> data) { hasher->update(data); };
+    const auto on_done = [this, file_path, source_state, hasher, temp, result](std::exception_ptr error) {
+        if (error) {
+            result->set_exception(error);
+            return;
+        }
+        try {
+            const auto hash = hasher->hash();
+            const auto key = key_from_hash(hash.hash);
+            const auto imported = store_leaves(temp ? add_object(key, temp->path(), [&temp](const fs::path &object_path) { temp->commit(object_path); })
+                                                    : store_file(file_path, key),
+                                               hash);
+            if (source_state)
+                remember_source(file_path, *source_state, imported);
+            result->set_value(imported);
+        } catch (...) {
+            result->set_exception(std::current_exception());
+        }
+    };
+
+    if (temp)
+        async_io().copy_file(file_path, temp->path(), on_data, on_done);
+    else
+        async_io().read_file(file_path, on_data, on_done);
+    return future;
+}
+
+std::future<std::vector<char>> FileStore::read_async(const Key &file_key) const {
+    auto result = std::make_shared<std::promise<std::vector<char>>>();
+    // packed objects are mapped already
+    if (const auto packed = m_packs ? m_packs->read(file_key) : std::nullopt) {
+        const auto data = packed->data;
+        result->set_value(std::vector<char>{reinterpret_cast<const char *>(data.data()), reinterpret_cast<const char *>(data.data() + data.size())});
+        return result->get_future();
+    }
+    auto content = std::make_shared<std::vector<char>>();
+    async_io().read_file(
+        get_file_path(file_key), [content](std::span<const char> data) { content->insert(content->end(), data.begin(), data.end()); },
+        [this, content, result](std::exception_ptr error) {
+            if (error) {
+                result->set_exception(error);
+                return;
+            }
+            try {
+                if (const auto manifest = parse_manifest(std::as_bytes(std::span{*content}))) {
+                    const auto data = assemble(*manifest);
+                    content->assign(reinterpret_cast<const char *>(data.data()), reinterpret_cast<const char *>(data.data() + data.size()));
+                } else if (const auto reader = content_reader(std::as_bytes(std::span{*content})); reader.compressed()) {
+                    const auto data = reader.read_all();
+                    content->assign(reinterpret_cast<const char *>(data.data()), reinterpret_cast<const char *>(data.data() + data.size()));
+                }
+                result->set_value(std::move(*content));
+            } catch (...) {
+                result->set_exception(std::current_exception());
+            }
+        });
+    return result->get_future();
+}
+
+AsyncIo &FileStore::async_io() const {
+    std::call_once(m_async->created, [this]() { m_async->io = std::make_unique<AsyncIo>(AsyncIo::Backend::io_uring, m_io_queue_depth); });
+    return *m_async->io;
+}
+
+ObjectView FileStore::open(const Key &file_key, AccessPattern pattern) const {
+    if (m_packs) {
+        if (auto packed = m_packs->read(file_key))
+            return ObjectView{std::move(packed->mapping), packed->data};
+    }
+    if (m_mapping_cache) {
+        if (auto mapping = m_mapping_cache->find(file_key))
+            return ObjectView{std::move(mapping)};
+    }
+    std::shared_ptr<const MappedFile> mapping;
+    try {
+        mapping = std::make_shared<const MappedFile>(map_object_file(file_key));
+    } catch (const FileError &) {
+        // moved into a pack in the meantime
+        auto packed = m_packs ? m_packs->read(file_key) : std::nullopt;
+        if (!packed)
+            throw;
+        return ObjectView{std::move(packed->mapping), packed->data};
+    }
+    if (const auto manifest = parse_manifest(mapping->data())) {
+        auto content = std::make_shared<const std::vector<std::byte>>(assemble(*manifest));
+        return ObjectView{content, std::span{*content}};
+    }
+    if (const auto reader = content_reader(mapping->data()); reader.compressed()) {
+        auto content = std::make_shared<const std::vector<std::byte>>(reader.read_all());
+        return ObjectView{content, std::span{*content}};
+    }
+    mapping->advise(pattern);
+    if (m_mapping_cache)
+        m_mapping_cache->insert(file_key, mapping);
+    return ObjectView{std::move(mapping)};
+}
+
+ContentReader FileStore::read(const Key &file_key) const {
+    // packed and assembled contents are never compressed
+    if (auto packed = m_packs ? m_packs->read(file_key) : std::nullopt)
+        return ContentReader{packed->data, std::move(packed->mapping), false};
+    auto mapping = std::make_shared<const MappedFile>(map_object_file(file_key));
+    if (const auto manifest = parse_manifest(mapping->data())) {
+        auto content = std::make_shared<const std::vector<std::byte>>(assemble(*manifest));
+        return ContentReader{*content, content, false};
+    }
+    const auto data = mapping->data();
+    return content_reader(data, std::move(mapping));
+}
+
+// Objects with files of their own are read ahead, as they are read front to back
+void FileStore::read_stream(const Key &file_key, const std::function<void(std::span<const std::byte>)> &f) const {
+    if (!is_packed(file_key)) {
+        auto object_file = std::make_shared<const MappedFile>(map_object_file(file_key));
+        if (const auto manifest = parse_manifest(object_file->data())) {
+            for (const auto &chunk : manifest->chunks)
+                chunk_store().read_stream(chunk.key, f);
+            return;
+        }
+        object_file->advise(AccessPattern::sequential);
+        const auto data = object_file->data();
+        content_reader(data, std::move(object_file)).for_each_block(f);
+        return;
+    }
+    read(file_key).for_each_block(f);
+}
+
+bool FileStore::verify(const Key &file_key, std::uint64_t offset, std::uint64_t length) const {
+    const auto matches = [&file_key](const TreeHash::hash_type &hash) { return key_matches(file_key, hash); };
+    const auto content = read(file_key);
+    if (m_config.key_scheme == KeyScheme::sha256_tree && offset < content.size()) {
+        // the recorded leaves are only used, if they make up the key, so a damaged leaves file is noticed as well
+        if (const auto leaves = read_leaves(leaves_path(file_key), m_config.leaf_size, content.size()); leaves && matches(TreeHash::root(*leaves))) {
+            const auto first = offset / m_config.leaf_size;
+            const auto end = std::min(content.size(), offset + std::min(length, content.size() - offset));
+            std::vector<std::byte> buffer(m_config.leaf_size);
+            for (auto i = first; i * m_config.leaf_size < end; ++i) {
+                const auto leaf = std::span{buffer}.first(content.read(i * m_config.leaf_size, buffer));
+                if (TreeHash::hash_leaf(leaf).data != (*leaves)[i].data)
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    KeyHasher hasher{m_config};
+    read_stream(file_key, [&hasher](std::span<const std::byte> data) { hasher.update({reinterpret_cast<const char *>(data.data()), data.size()}); });
+    return matches(hasher.hash().hash);
+}
+
+// The objects are checked in batches; the checkpoint holds the last key of the last finished batch
+ScrubReport FileStore::scrub(const ScrubOptions &options) const {
+    static constexpr size_t batch_per_thread = 16;
+
+    ScrubReport report;
+    std::vector<Key> keys;
+    for (auto it = fs::recursive_directory_iterator{m_root_path}; it != fs::recursive_directory_iterator{}; ++it) {
+        if (it.depth() == 0 && it->path().filename().string().starts_with('.')) { // metadata of the store
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (!it->is_regular_file())
+            continue;
+        if (const auto key = object_key(it->path(), it.depth()))
+            keys.push_back(*key);
+        else
+            report.orphans.push_back(it->path());
+    }
+    if (m_packs)
+        m_packs->for_each([&keys](const Key &key, const PackLocation &) { keys.push_back(key); });
+    // objects being repacked are in both places
+    std::ranges::sort(keys, {}, &Key::data);
+    keys.erase(std::ranges::unique(keys).begin(), keys.end());
+
+    // leaves of objects that are gone
+    if (const auto leaves_root = metadata_path() / "leaves"; fs::exists(leaves_root)) {
+        for (const auto &entry : fs::recursive_directory_iterator{leaves_root}) {
+            if (!entry.is_regular_file())
+                continue;
+            const auto key = key_from_path(std::basic_string_view{entry.path().native()}, m_folder_levels);
+            if (!key || !std::ranges::binary_search(keys, key->data, {}, &Key::data))
+                report.orphans.push_back(entry.path());
+        }
+    }
+
+    auto next = keys.begin();
+    if (!options.checkpoint_path.empty() && fs::exists(options.checkpoint_path)) {
+        std::ifstream input{options.checkpoint_path};
+        std::string last;
+        input >> last;
+        if (const auto key = from_string(last))
+            next = std::ranges::upper_bound(keys, key->data, {}, &Key::data);
+    }
+
+    std::optional<ThreadPool> own_pool;
+    auto *pool = options.pool;
+    if (pool == nullptr)
+        pool = &own_pool.emplace(options.threads);
+    Throttle throttle{options.max_bytes_per_second};
+    std::mutex report_mutex;
+    const auto check = [&](const Key &key) {
+        KeyHasher hasher{m_config};
+        std::uint64_t bytes = 0;
+        bool valid = false;
+        try {
+            read_stream(key, [&](std::span<const std::byte> data) {
+                throttle.wait(data.size());
+                hasher.update({reinterpret_cast<const char *>(data.data()), data.size()});
+                bytes += data.size();
+            });
+            valid = key_matches(key, hasher.hash().hash);
+        } catch (const FileError &) {
+            // unreadable, e.g. truncated, or a chunk is missing
+        }
+        std::lock_guard lock{report_mutex};
+        ++report.objects;
+        report.bytes += bytes;
+        if (!valid)
+            report.mismatches.push_back(key);
+    };
+
+    const auto batch_size = batch_per_thread * pool->size();
+    TaskGroup tasks{*pool};
+    while (next != keys.end()) {
+        if (options.stop && options.stop())
+            return report;
+        const auto end = next + static_cast<std::ptrdiff_t>(std::min<size_t>(batch_size, keys.end() - next));
+        for (auto it = next; it != end; ++it)
+            tasks.submit([&check, &key = *it]() { check(key); });
+        tasks.wait();
+        next = end;
+        if (!options.checkpoint_path.empty()) {
+            auto temp_checkpoint_path = options.checkpoint_path;
+            temp_checkpoint_path += ".tmp";
+            {
+                std::ofstream output{temp_checkpoint_path, std::ios_base::trunc};
+                output << to_string(*(end - 1)) << '\n';
+                if (!output.flush())
+                    throw FileError{"Error writing file", temp_checkpoint_path};
+            }
+            fs::rename(temp_checkpoint_path, options.checkpoint_path);
+        }
+    }
+    if (!options.checkpoint_path.empty())
+        fs::remove(options.checkpoint_path);
+    std::ranges::sort(report.mismatches, {}, &Key::data);
+    report.complete = true;
+    return report;
+}
+
 fs::path FileStore::get_file_path(const Key &file_key) const {
-    const auto file_name = to_string(file_key);
-    fs::path file_path = root_path();
-    for (int i = 0; i < m_folder_levels; ++i)
-        file_path /= file_name.substr(2 * i, 2);
-    return file_path / file_name.substr(m_folder_levels * 2);
+    return root_path() / KeyPath{file_key, folder_levels(file_key)}.view();
 }
 
-Key generate_file_key(const fs::path &file_path) {
-    const auto hash = hash_file<SHA256>(file_path);
-    Key key{};
-    std::memcpy(key.data.data(), hash.data.data(), hash.bytelength);
+Fingerprint FileStore::object_fingerprint(std::span<const std::byte> object_file, bool sample) const {
+    if (const auto manifest = parse_manifest(object_file))
+        return manifest->fingerprint();
+    const auto content = content_reader(object_file);
+    return sample ? content.fingerprint() : Fingerprint{content.size(), 0};
+}
+
+// An encoded file is read, as its size is not the size of the content
+CatalogEntry FileStore::describe_object(const Key &key, const fs::directory_entry &file, std::int64_t import_time, bool fingerprint,
+                                        bool may_be_encoded) const {
+    const auto modification_time = to_unix_nanoseconds(file.last_write_time());
+    Fingerprint content{file.file_size(), 0};
+    if (fingerprint || may_be_encoded)
+        content = object_fingerprint(MappedFile{file.path()}.data(), fingerprint);
+    return CatalogEntry{key, content.size, modification_time, import_time == 0 ? modification_time : import_time, content.sample_hash};
+}
+
+// Before the first escaped object is published, so no store reads it as it is
+void FileStore::mark_compressed_objects() {
+    if (compressed_objects())
+        return;
+    fs::create_directories(metadata_path());
+    std::ofstream{compressed_marker_path(), std::ios_base::app};
+    m_compressed_objects->store(true, std::memory_order_release);
+}
+
+MappedFile FileStore::map_object_file(const Key &k) const {
+    const auto version = layout_version();
+    try {
+        return MappedFile{get_file_path(k)};
+    } catch (const FileError &) {
+        // moved into a subdirectory in the meantime
+        if (layout_version() == version)
+            throw;
+        return MappedFile{get_file_path(k)};
+    }
+}
+
+std::optional<Key> FileStore::object_key(const fs::path &file_path, int depth) const {
+    const auto key = key_from_path(std::basic_string_view{file_path.native()}, depth);
+    if (!key || folder_levels(*key) != depth)
+        return std::nullopt;
     return key;
 }
 
+void FileStore::count_object(const Key &k) {
+    const auto threshold = m_shards->layout->split_threshold();
+    if (threshold == 0)
+        return;
+    const auto depth = folder_levels(k);
+    const auto directory = get_file_path(k).parent_path();
+    {
+        std::lock_guard lock{m_shards->counts_mutex};
+        auto [count, inserted] = m_shards->counts.try_emplace(directory.native(), 0);
+        if (inserted) // the new object is among them
+            count->second = static_cast<std::uint64_t>(std::distance(fs::directory_iterator{directory}, fs::directory_iterator{}));
+        else
+            ++count->second;
+        if (count->second <= threshold)
+            return;
+    }
+    split_directory(std::span{k.data}.first(depth));
+}
+
+void FileStore::split_directory(std::span<const std::byte> prefix) {
+    std::unique_lock lock{m_shards->mutex};
+    auto &layout = *m_shards->layout;
+    // split by another thread, or as deep as it gets
+    if (layout.is_split(prefix) || prefix.size() >= ShardLayout::max_depth)
+        return;
+
+    const auto depth = static_cast<int>(prefix.size());
+    const auto directory = prefix_path(m_root_path, prefix);
+    std::vector<fs::path> linked;
+    std::unordered_map<fs::path::string_type, std::uint64_t> counts;
+    for (const auto &entry : fs::directory_iterator{directory}) {
+        if (!entry.is_regular_file())
+            continue;
+        const auto key = key_from_path(std::basic_string_view{entry.path().native()}, depth);
+        if (!key)
+            continue;
+        const auto target = m_root_path / KeyPath{*key, depth + 1}.view();
+        fs::create_directories(target.parent_path());
+        std::error_code ec;
+        fs::create_hard_link(entry.path(), target, ec);
+        if (ec && ec != std::errc::file_exists) // left by a split that was interrupted
+            throw FileError{"Could not create file", target};
+        linked.push_back(entry.path());
+        ++counts[target.parent_path().native()];
+    }
+    layout.split(prefix);
+    layout.save(shards_path());
+    for (const auto &path : linked) {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+
+    std::lock_guard counts_lock{m_shards->counts_mutex};
+    m_shards->counts.erase(directory.native());
+    for (const auto &[subdirectory, count] : counts)
+        m_shards->counts[subdirectory] = count;
+}
+
+void FileStore::reshard() {
+    if (!m_shards || m_shards->layout->split_threshold() == 0)
+        return;
+    std::vector<std::byte> prefix;
+    reshard_directory(prefix);
+}
+
+// Splits the directory of prefix, if it holds too many objects, and continues with its subdirectories
+void FileStore::reshard_directory(std::vector<std::byte> &prefix) {
+    const auto directory = prefix_path(m_root_path, prefix);
+    if (!m_shards->layout->is_split(prefix)) {
+        const auto count = static_cast<std::uint64_t>(std::distance(fs::directory_iterator{directory}, fs::directory_iterator{}));
+        if (count <= m_shards->layout->split_threshold())
+            return;
+        split_directory(prefix);
+        if (!m_shards->layout->is_split(prefix))
+            return;
+    }
+    for (const auto &entry : fs::directory_iterator{directory}) {
+        std::array<std::byte, 1> next;
+        // other directories, like the metadata of the store, are not named after a byte
+        if (!entry.is_directory() || !hex_decode(entry.path().filename().string(), next))
+            continue;
+        prefix.push_back(next[0]);
+        reshard_directory(prefix);
+        prefix.pop_back();
+    }
+}
+
+Key generate_file_key(const fs::path &file_path) {
+    return key_from_hash(hash_file<SHA256>(file_path));
+}
+
+Key generate_key(std::span<const std::byte> data) {
+    SHA256 sha;
+    sha.update({reinterpret_cast<const char *>(data.data()), data.size()});
+    return key_from_hash(sha.hash());
+}
+
+Key generate_key(std::istream &input) {
+    SHA256 sha;
+    const auto next_chunk = read_chunks(input, {});
+    for (auto data = next_chunk(); !data.empty(); data = next_chunk())
+        sha.update(data);
+    return key_from_hash(sha.hash());
+}
+
+std::vector<Key> generate_file_keys(std::span<const fs::path> file_paths) {
+    static constexpr std::uintmax_t max_lane_file_size = 1U << 20; // larger files are hashed on their own
+    static constexpr std::uintmax_t max_batch_size = 64U << 20;    // memory used for file contents
+
+    std::vector<Key> keys(file_paths.size());
+    if (SHA256Multi::lanes() == 1) {
+        std::transform(file_paths.begin(), file_paths.end(), keys.begin(), generate_file_key);
+        return keys;
+    }
+
+    std::vector<size_t> batch_indices;
+    std::vector<std::vector<char>> batch_contents;
+    std::uintmax_t batch_size = 0;
+
+    const auto hash_batch = [&]() {
+        const std::vector<std::span<const char>> messages(batch_contents.begin(), batch_contents.end());
+        const auto hashes = SHA256Multi::hash(messages);
+        for (size_t i = 0; i < hashes.size(); ++i)
+            keys[batch_indices[i]] = key_from_hash(hashes[i]);
+        batch_indices.clear();
+        batch_contents.clear();
+        batch_size = 0;
+    };
+
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+        std::error_code ec;
+        const auto size = fs::file_size(file_paths[i], ec);
+        if (ec || size > max_lane_file_size) {
+            keys[i] = generate_file_key(file_paths[i]);
+            continue;
+        }
+
+        batch_indices.push_back(i);
+        batch_contents.push_back(read_file(file_paths[i]));
+        batch_size += size;
+        if (batch_size >= max_batch_size)
+            hash_batch();
+    }
+    if (!batch_indices.empty())
+        hash_batch();
+
+    return keys;
+}
+
+std::future<Key> generate_file_key_async(AsyncIo &io, const fs::path &file_path) {
+    auto result = std::make_shared<std::promise<Key>>();
+    auto sha = std::make_shared<SHA256>();
+    io.read_file(
+        file_path, [sha](std::span<const char> data) { sha->update(data); },
+        [sha, result](std::exception_ptr error) {
+            if (error)
+                result->set_exception(error);
+            else
+                result->set_value(key_from_hash(sha->hash()));
+        });
+    return result->get_future();
+}
+
 bool FileStore::key_exists(const Key &k) const {
-    return fs::exists(get_file_path(k));
+    m_metrics->key_probes.add();
+    if (m_key_index) {
+        auto &index = key_index();
+        std::shared_lock lock{index.mutex};
+        return index.keys.contains(k);
+    }
+    if (is_packed(k))
+        return true;
+    const auto version = layout_version();
+    if (fs::exists(get_file_path(k)))
+        return true;
+    // moved into a subdirectory in the meantime
+    return layout_version() != version && fs::exists(get_file_path(k));
+}
+
+// The index is built on first use: from the snapshot, if there is one, by scanning the directories otherwise.
+// A snapshot is consumed when loading it, so it cannot get stale, if the store is changed without writing a new one.
+FileStore::key_index_state &FileStore::key_index() const {
+    std::call_once(m_key_index->loaded, [this]() {
+        const auto snapshot_path = key_index_path();
+        std::error_code ec;
+        if (fs::exists(snapshot_path, ec)) {
+            try {
+                m_key_index->keys = KeyIndex::load(snapshot_path);
+            } catch (const FileError &) {
+                for_each_object([this](const CatalogEntry &entry) { m_key_index->keys.insert(entry.key); });
+            }
+            fs::remove(snapshot_path, ec);
+        } else {
+            for_each_object([this](const CatalogEntry &entry) { m_key_index->keys.insert(entry.key); });
+        }
+    });
+    return *m_key_index;
+}
+
+void FileStore::for_each_object(const std::function<void(const CatalogEntry &)> &f) const {
+    if (m_catalog)
+        m_catalog->for_each(f);
+    else
+        scan_objects(f);
+}
+
+size_t FileStore::object_count() const {
+    if (m_catalog)
+        return m_catalog->size();
+    size_t count = 0;
+    scan_objects([&count](const CatalogEntry &) { ++count; });
+    return count;
+}
+
+void FileStore::rebuild_catalog() {
+    if (!m_catalog)
+        return;
+    auto temp_catalog_path = catalog_path();
+    temp_catalog_path += ".new";
+    fs::remove(temp_catalog_path);
+    {
+        Catalog catalog{temp_catalog_path};
+        scan_objects([&catalog](const CatalogEntry &entry) { catalog.add(entry); }, true);
+        catalog.sync();
+    }
+    // in place, so copies of the store see the new catalog as well
+    m_catalog->replace(temp_catalog_path);
+}
+
+void FileStore::scan_objects(const std::function<void(const CatalogEntry &)> &f, bool fingerprints) const {
+    scan_files(f, fingerprints);
+    if (!m_packs)
+        return;
+    // f may read the packs
+    std::vector<std::pair<Key, PackLocation>> packed;
+    m_packs->for_each([&packed](const Key &key, const PackLocation &location) { packed.emplace_back(key, location); });
+    for (const auto &[key, location] : packed) {
+        std::uint64_t sample_hash = 0;
+        if (fingerprints) {
+            if (const auto object = m_packs->read(key))
+                sample_hash = fingerprint_data(object->data).sample_hash;
+        }
+        f(CatalogEntry{key, location.size, location.import_time, location.import_time, sample_hash});
+    }
+}
+
+// Walks the shard directories. Files that are not named after a key are ignored.
+void FileStore::scan_files(const std::function<void(const CatalogEntry &)> &f, bool fingerprints) const {
+    for (auto it = fs::recursive_directory_iterator{m_root_path}; it != fs::recursive_directory_iterator{}; ++it) {
+        if (it.depth() == 0 && it->path().filename().string().starts_with('.')) { // metadata of the store
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (!it->is_regular_file())
+            continue;
+
+        if (const auto key = object_key(it->path(), it.depth()))
+            f(describe_object(*key, *it, 0, fingerprints, encoded_objects()));
+    }
+}
+
+void FileStore::repack(double min_garbage) {
+    if (!m_packs)
+        return;
+    if (m_pack_threshold > 0) {
+        std::vector<CatalogEntry> small_objects;
+        scan_files([&](const CatalogEntry &entry) {
+            if (entry.size < m_pack_threshold)
+                small_objects.push_back(entry);
+        }, false);
+        // Under the gc_lock, so a collection does not remove the file meanwhile. If it does before the file is
+        // removed here, the packed copy is removed as well.
+        std::erase_if(small_objects, [this](const CatalogEntry &entry) {
+            std::lock_guard lock{import_lock(entry.key)};
+            std::shared_lock gc{gc_lock(entry.key)};
+            if (!fs::exists(get_file_path(entry.key)))
+                return true;
+            if (!m_packs->contains(entry.key))
+                m_packs->add(entry.key, read(entry.key).read_all(), entry.import_time);
+            return false;
+        });
+        // the files are only removed, once the packs are on the disk
+        m_packs->sync();
+        for (const auto &entry : small_objects) {
+            std::shared_lock gc{gc_lock(entry.key)};
+            if (!fs::remove(get_file_path(entry.key)))
+                m_packs->remove(entry.key);
+        }
+    }
+    m_packs->repack(min_garbage);
+}
+
+GcReport FileStore::collect_garbage(std::span<const Key> roots, const GcOptions &options) {
+    std::lock_guard collection_lock{m_gc->collection_mutex};
+    KeyIndex live;
+    for (const auto &key : roots)
+        live.insert(key);
+
+    // Imports keep their keys from here on, until all is swept. The chunk store keeps new chunks, too, as the
+    // objects using them may be added after the sweep of the store listed its objects.
+    class collection {
+    public:
+        explicit collection(std::vector<gc_state *> states) : m_states{std::move(states)} { set(true); }
+        ~collection() { set(false); }
+        collection(const collection &) = delete;
+        collection &operator=(const collection &) = delete;
+    private:
+        std::vector<gc_state *> m_states;
+
+        void set(bool collecting) {
+            for (auto *state : m_states) {
+                std::lock_guard lock{state->kept_mutex};
+                state->kept.clear();
+                state->collecting.store(collecting, std::memory_order_release);
+            }
+        }
+    };
+    const collection running{m_chunks ? std::vector{m_gc.get(), m_chunks->m_gc.get()} : std::vector{m_gc.get()}};
+
+    GcReport report;
+    KeyIndex live_chunks;
+    sweep(live, options, report, m_chunks ? &live_chunks : nullptr);
+    if (m_chunks) {
+        GcReport chunk_report;
+        m_chunks->sweep(live_chunks, options, chunk_report, nullptr);
+        report.chunks_removed = chunk_report.objects_removed;
+        report.directories_removed += chunk_report.directories_removed;
+    }
+    return report;
+}
+
+// Each directory below the root is listed and swept by a task of its own. Objects are removed in batches of keys
+// with the same first byte, under their gc_lock, so an import either keeps its key before or stores it again after.
+void FileStore::sweep(const KeyIndex &live, const GcOptions &options, GcReport &report, KeyIndex *live_chunks) {
+    std::mutex report_mutex;
+    std::vector<fs::path> emptied;
+    // chunked objects are never packed
+    const auto keep_chunks = [&](const Key &k) {
+        if (!live_chunks || is_packed(k))
+            return;
+        const auto object = map_object_file(k);
+        if (const auto manifest = parse_manifest(object.data())) {
+            std::lock_guard lock{report_mutex};
+            for (const auto &chunk : manifest->chunks)
+                live_chunks->insert(chunk.key);
+        }
+    };
+    // garbage holds the candidates not in live, with an empty path for packed objects
+    const auto remove_garbage = [&](std::vector<std::pair<Key, fs::path>> garbage, size_t kept) {
+        FileRemover remover;
+        size_t removed = 0;
+        for (size_t begin = 0; begin < garbage.size();) {
+            std::shared_lock<std::shared_mutex> shard_lock;
+            if (m_shards)
+                shard_lock = std::shared_lock{m_shards->mutex};
+            std::unique_lock gc{gc_lock(garbage[begin].first)};
+            const auto first_byte = garbage[begin].first.data[0];
+            auto end = begin;
+            for (; end < garbage.size() && end - begin < std::max<size_t>(options.batch_size, 1) && garbage[end].first.data[0] == first_byte; ++end) {
+                const auto &[key, path] = garbage[end];
+                bool returned_meanwhile;
+                {
+                    std::lock_guard lock{m_gc->kept_mutex};
+                    returned_meanwhile = m_gc->kept.contains(key);
+                }
+                if (returned_meanwhile) {
+                    keep_chunks(key);
+                    ++kept;
+                } else if (path.empty() ? m_packs->remove(key) : remover.remove(path)) {
+                    forget_object(key);
+                    ++removed;
+                }
+            }
+            begin = end;
+        }
+        std::lock_guard lock{report_mutex};
+        report.objects_kept += kept;
+        report.objects_removed += removed;
+        emptied.insert(emptied.end(), remover.directories().begin(), remover.directories().end());
+    };
+    // the files sorted by path, so those of a directory are removed together
+    const auto sweep_files = [&](std::vector<DirectoryFile> files) {
+        std::ranges::sort(files, {}, &DirectoryFile::path);
+        const auto root_length = (m_root_path / "").native().size();
+        std::vector<std::pair<Key, fs::path>> garbage;
+        size_t kept = 0;
+        for (auto &file : files) {
+            const auto &native = file.path.native();
+            const auto depth = static_cast<int>(std::count(native.begin() + static_cast<std::ptrdiff_t>(root_length), native.end(), fs::path::preferred_separator));
+            const auto key = object_key(file.path, depth);
+            if (!key)
+                continue;
+            if (live.contains(*key)) {
+                keep_chunks(*key);
+                ++kept;
+            } else {
+                garbage.emplace_back(*key, std::move(file.path));
+            }
+        }
+        remove_garbage(std::move(garbage), kept);
+    };
+
+    if (m_packs) {
+        std::vector<std::pair<Key, fs::path>> garbage;
+        size_t kept = 0;
+        m_packs->for_each([&](const Key &key, const PackLocation &) {
+            if (live.contains(key))
+                ++kept;
+            else
+                garbage.emplace_back(key, fs::path{});
+        });
+        std::ranges::sort(garbage, {}, [](const auto &candidate) { return candidate.first.data; });
+        remove_garbage(std::move(garbage), kept);
+    }
+
+    std::vector<fs::path> directories;
+    std::vector<DirectoryFile> root_files;
+    for (const auto &entry : fs::directory_iterator{m_root_path}) {
+        std::array<std::byte, 1> byte;
+        // other directories, like the metadata of the store, are not named after a byte
+        if (entry.is_directory() && hex_decode(entry.path().filename().string(), byte))
+            directories.push_back(entry.path());
+        else if (entry.is_regular_file())
+            root_files.push_back(DirectoryFile{entry.path(), 0});
+    }
+    sweep_files(std::move(root_files));
+
+    std::optional<ThreadPool> own_pool;
+    auto *pool = options.pool;
+    if (pool == nullptr)
+        pool = &own_pool.emplace(options.threads);
+    TaskGroup tasks{*pool};
+    for (const auto &directory : directories)
+        tasks.submit([&sweep_files, &directory]() { sweep_files(list_files(directory)); });
+    tasks.wait();
+
+    report.directories_removed += remove_empty_shards(std::move(emptied));
+}
+
+size_t FileStore::remove(std::span<const Key> keys) {
+    std::vector<std::pair<fs::path, Key>> files;
+    size_t removed = 0;
+    for (const auto &key : keys) {
+        std::unique_lock gc{gc_lock(key)};
+        if (m_packs && m_packs->remove(key)) {
+            forget_object(key);
+            ++removed;
+        } else {
+            files.emplace_back(get_file_path(key), key);
+        }
+    }
+    // so those of a directory are removed together
+    std::ranges::sort(files, {}, &std::pair<fs::path, Key>::first);
+    FileRemover remover;
+    for (const auto &[path, key] : files) {
+        std::shared_lock<std::shared_mutex> shard_lock;
+        if (m_shards)
+            shard_lock = std::shared_lock{m_shards->mutex};
+        std::unique_lock gc{gc_lock(key)};
+        if (remover.remove(get_file_path(key))) {
+            forget_object(key);
+            ++removed;
+        }
+    }
+    remove_empty_shards(remover.directories());
+    return removed;
+}
+
+void FileStore::forget_object(const Key &k) {
+    if (m_catalog)
+        m_catalog->remove(k);
+    if (m_key_index) {
+        auto &index = key_index();
+        std::unique_lock lock{index.mutex};
+        index.keys.erase(k);
+    }
+    if (m_mapping_cache)
+        m_mapping_cache->erase(k);
+    if (m_config.key_scheme == KeyScheme::sha256_tree) {
+        std::error_code ec;
+        fs::remove(leaves_path(k), ec);
+    }
+}
+
+void FileStore::keep_key(const Key &k) const {
+    if (!m_gc->collecting.load(std::memory_order_acquire))
+        return;
+    std::lock_guard lock{m_gc->kept_mutex};
+    m_gc->kept.insert(k);
+}
+
+// Objects are published into a directory right after it is created, so no import may run meanwhile
+size_t FileStore::remove_empty_shards(std::vector<fs::path> directories) {
+    std::shared_lock<std::shared_mutex> shard_lock;
+    if (m_shards)
+        shard_lock = std::shared_lock{m_shards->mutex};
+    std::vector<std::unique_lock<std::shared_mutex>> gc;
+    for (auto &lock : m_gc->locks)
+        gc.emplace_back(lock);
+    const auto removed = remove_empty_directories(directories, m_root_path);
+    // the counts of directories created again start from scratch
+    if (m_shards && removed > 0) {
+        std::lock_guard lock{m_shards->counts_mutex};
+        std::error_code ec;
+        for (const auto &directory : directories)
+            if (!fs::exists(directory, ec))
+                m_shards->counts.erase(directory.native());
+    }
+    return removed;
 }
 
-std::string to_string(const Key &k) {
-    return bytes_to_hex(std::begin(k.data), std::end(k.data));
+void FileStore::save_key_index() const {
+    if (!m_key_index)
+        return;
+    auto &index = key_index();
+    std::shared_lock lock{index.mutex};
+    fs::create_directories(metadata_path());
+    const auto snapshot_path = key_index_path();
+    auto temp_snapshot_path = snapshot_path;
+    temp_snapshot_path += ".tmp";
+    index.keys.save(temp_snapshot_path);
+    fs::rename(temp_snapshot_path, snapshot_path);
 }
 
 } // namespace filestore
@@ -0,0 +1,46 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/key.h"
+#include "FileStore/bin_utils.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+namespace filestore {
+
+void to_chars(const Key &k, std::span<char, Key::string_length> out) {
+    hex_encode(k.data, out.data());
+}
+
+std::string to_string(const Key &k) {
+    std::string result(Key::string_length, '\0');
+    to_chars(k, std::span<char, Key::string_length>{result.data(), Key::string_length});
+    return result;
+}
+
+std::optional<Key> from_string(std::string_view s) {
+    Key key;
+    if (!hex_decode(s, key.data))
+        return std::nullopt;
+    return key;
+}
+
+KeyPath::KeyPath(const Key &k, int folder_levels) {
+    if (folder_levels < 0 || static_cast<size_t>(folder_levels) > Key::bytelength)
+        throw std::out_of_range("Invalid number of folder levels");
+
+    // the digits are written to the end of the buffer first, then the folders are moved to the front
+    auto *digits = m_buffer.data() + folder_levels;
+    to_chars(k, std::span<char, Key::string_length>{digits, Key::string_length});
+    for (int i = 0; i < folder_levels; ++i) {
+        m_buffer[3 * i] = digits[2 * i];
+        m_buffer[3 * i + 1] = digits[2 * i + 1];
+        m_buffer[3 * i + 2] = static_cast<char>(std::filesystem::path::preferred_separator);
+    }
+    m_length = Key::string_length + folder_levels;
+}
+
+} // namespace filestore
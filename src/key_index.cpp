@@ -0,0 +1,146 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/key_index.h"
+#include "FileStore/file.h"
+
+#include <fstream>
+
+namespace filestore {
+
+namespace {
+
+constexpr char snapshot_magic[8] = {'F', 'S', 'K', 'E', 'Y', 'I', 'D', 'X'};
+constexpr std::uint32_t snapshot_version = 1;
+
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t key_size;
+    std::uint64_t count;
+};
+
+} // namespace
+
+std::uint64_t KeyIndex::hash(const Key &k) {
+    std::uint64_t prefix;
+    std::memcpy(&prefix, k.data.data(), sizeof(prefix));
+    // keys with the same hash only differ in the distinguisher
+    return prefix ^ (static_cast<std::uint64_t>(k.distinguisher()) * 0x9e3779b97f4a7c15ULL);
+}
+
+size_t KeyIndex::find_slot(const Key &k) const {
+    const auto mask = m_slots.size() - 1;
+    auto slot = static_cast<size_t>(hash(k)) & mask;
+    while (m_used[slot] && !(m_slots[slot] == k))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+bool KeyIndex::contains(const Key &k) const {
+    if (m_size == 0)
+        return false;
+    return m_used[find_slot(k)] != 0;
+}
+
+bool KeyIndex::insert(const Key &k) {
+    // keep the load factor below 3/4
+    if (4 * (m_size + 1) > 3 * m_slots.size())
+        grow();
+
+    const auto slot = find_slot(k);
+    if (m_used[slot])
+        return false;
+    m_slots[slot] = k;
+    m_used[slot] = 1;
+    ++m_size;
+    return true;
+}
+
+// The keys after the gap in the probe sequence are moved back, so lookups do not stop at it
+bool KeyIndex::erase(const Key &k) {
+    if (m_size == 0)
+        return false;
+    auto slot = find_slot(k);
+    if (!m_used[slot])
+        return false;
+
+    const auto mask = m_slots.size() - 1;
+    for (auto next = (slot + 1) & mask; m_used[next]; next = (next + 1) & mask) {
+        // a key may fill the gap, if the gap is between its home slot and its slot
+        const auto home = static_cast<size_t>(hash(m_slots[next])) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            m_slots[slot] = m_slots[next];
+            slot = next;
+        }
+    }
+    m_used[slot] = 0;
+    --m_size;
+    return true;
+}
+
+void KeyIndex::clear() {
+    m_slots.clear();
+    m_used.clear();
+    m_size = 0;
+}
+
+void KeyIndex::grow() {
+    std::vector<Key> old_slots(std::max<size_t>(64, 2 * m_slots.size()));
+    std::vector<std::uint8_t> old_used(old_slots.size(), 0);
+    std::swap(m_slots, old_slots);
+    std::swap(m_used, old_used);
+
+    for (size_t i = 0; i < old_slots.size(); ++i) {
+        if (!old_used[i])
+            continue;
+        const auto slot = find_slot(old_slots[i]);
+        m_slots[slot] = old_slots[i];
+        m_used[slot] = 1;
+    }
+}
+
+void KeyIndex::save(const fs::path &file_path) const {
+    std::ofstream output{file_path, std::ios_base::binary | std::ios_base::trunc};
+    if (!output)
+        throw FileError{"Could not create file", file_path};
+
+    snapshot_header header{};
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = snapshot_version;
+    header.key_size = Key::bytelength;
+    header.count = m_size;
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (size_t i = 0; i < m_slots.size(); ++i)
+        if (m_used[i])
+            output.write(reinterpret_cast<const char *>(m_slots[i].data.data()), Key::bytelength);
+
+    output.close();
+    if (!output)
+        throw FileError{"Error writing file", file_path};
+}
+
+KeyIndex KeyIndex::load(const fs::path &file_path) {
+    std::ifstream input{file_path, std::ios_base::binary};
+    if (!input)
+        throw FileError{"Could not open file", file_path};
+
+    snapshot_header header{};
+    input.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!input || std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || header.version != snapshot_version ||
+        header.key_size != Key::bytelength)
+        throw FileError{"Invalid key index", file_path};
+
+    KeyIndex index;
+    Key key{};
+    for (std::uint64_t i = 0; i < header.count; ++i) {
+        if (!input.read(reinterpret_cast<char *>(key.data.data()), Key::bytelength))
+            throw FileError{"Invalid key index", file_path};
+        index.insert(key);
+    }
+    return index;
+}
+
+} // namespace filestore
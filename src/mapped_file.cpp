@@ -0,0 +1,132 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/mapped_file.h"
+#include "FileStore/file.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace filestore {
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const fs::path &file_path) {
+    HANDLE file = ::CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw FileError{"Could not open file", file_path};
+
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(file, &size)) {
+        ::CloseHandle(file);
+        throw FileError{"Could not open file", file_path};
+    }
+    if (size.QuadPart > 0) {
+        m_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping != nullptr)
+            m_data = static_cast<const std::byte *>(::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    ::CloseHandle(file);
+    if (size.QuadPart > 0 && m_data == nullptr) {
+        unmap();
+        throw FileError{"Could not map file", file_path};
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+}
+
+void MappedFile::unmap() {
+    if (m_data != nullptr)
+        ::UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        ::CloseHandle(m_mapping);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data{std::exchange(other.m_data, nullptr)}, m_size{std::exchange(other.m_size, 0)}, m_mapping{std::exchange(other.m_mapping, nullptr)} {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+    }
+    return *this;
+}
+#else
+MappedFile::MappedFile(const fs::path &file_path) {
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw FileError{"Could not open file", file_path};
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        throw FileError{"Could not open file", file_path};
+    }
+    if (status.st_size > 0) {
+        void *data = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            throw FileError{"Could not map file", file_path};
+        }
+        m_data = static_cast<const std::byte *>(data);
+        m_size = static_cast<size_t>(status.st_size);
+    }
+    // the mapping stays valid without the descriptor
+    ::close(fd);
+}
+
+void MappedFile::unmap() {
+    if (m_data != nullptr)
+        ::munmap(const_cast<std::byte *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept : m_data{std::exchange(other.m_data, nullptr)}, m_size{std::exchange(other.m_size, 0)} {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+#endif
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::advise([[maybe_unused]] AccessPattern pattern) const {
+#if !defined(_WIN32)
+    if (m_data == nullptr)
+        return;
+    int advice = MADV_NORMAL;
+    switch (pattern) {
+    case AccessPattern::normal: advice = MADV_NORMAL; break;
+    case AccessPattern::sequential: advice = MADV_SEQUENTIAL; break;
+    case AccessPattern::random: advice = MADV_RANDOM; break;
+    case AccessPattern::will_need: advice = MADV_WILLNEED; break;
+    }
+    ::madvise(const_cast<std::byte *>(m_data), m_size, advice);
+#endif
+}
+
+} // namespace filestore
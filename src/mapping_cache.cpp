@@ -0,0 +1,49 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/mapping_cache.h"
+
+namespace filestore {
+
+std::shared_ptr<const MappedFile> MappingCache::find(const Key &k) {
+    std::lock_guard lock{m_mutex};
+    const auto it = m_index.find(k);
+    if (it == m_index.end())
+        return nullptr;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->second;
+}
+
+void MappingCache::insert(const Key &k, std::shared_ptr<const MappedFile> mapping) {
+    if (m_capacity == 0)
+        return;
+    std::lock_guard lock{m_mutex};
+    if (const auto it = m_index.find(k); it != m_index.end()) {
+        it->second->second = std::move(mapping);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+    if (m_entries.size() == m_capacity) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    m_entries.emplace_front(k, std::move(mapping));
+    m_index.emplace(k, m_entries.begin());
+}
+
+void MappingCache::erase(const Key &k) {
+    std::lock_guard lock{m_mutex};
+    if (const auto it = m_index.find(k); it != m_index.end()) {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+}
+
+size_t MappingCache::size() const {
+    std::lock_guard lock{m_mutex};
+    return m_entries.size();
+}
+
+} // namespace filestore
@@ -0,0 +1,109 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/metrics.h"
+
+#include <cstdio>
+#include <string_view>
+
+namespace filestore {
+
+namespace {
+
+void append_line(std::string &out, std::string_view name, std::string_view labels, std::uint64_t value) {
+    out += name;
+    out += labels;
+    out += ' ';
+    out += std::to_string(value);
+    out += '\n';
+}
+
+// Cumulative buckets, as Prometheus expects them; scale converts the values to the unit of the bounds
+void append_histogram(std::string &out, std::string_view name, std::string_view help, const HistogramSnapshot &histogram, double scale) {
+    const std::string metric{name};
+    out += "# HELP " + metric + ' ' + std::string{help} + '\n';
+    out += "# TYPE " + metric + " histogram\n";
+    std::uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < HistogramSnapshot::bucket_count; ++i) {
+        cumulative += histogram.buckets[i];
+        char bound[32];
+        std::snprintf(bound, sizeof(bound), "%g", static_cast<double>(HistogramSnapshot::upper_bound(i)) * scale);
+        append_line(out, metric + "_bucket", "{le=\"" + std::string{bound} + "\"}", cumulative);
+    }
+    append_line(out, metric + "_bucket", "{le=\"+Inf\"}", histogram.count);
+    char sum[32];
+    std::snprintf(sum, sizeof(sum), "%.9g", static_cast<double>(histogram.sum) * scale);
+    out += metric + "_sum " + sum + '\n';
+    append_line(out, metric + "_count", "", histogram.count);
+}
+
+void append_counter(std::string &out, std::string_view name, std::string_view help, std::uint64_t value) {
+    const std::string metric{name};
+    out += "# HELP " + metric + ' ' + std::string{help} + '\n';
+    out += "# TYPE " + metric + " counter\n";
+    append_line(out, metric, "", value);
+}
+
+void append_json(std::string &out, std::string_view name, const HistogramSnapshot &histogram) {
+    out += '"';
+    out += name;
+    out += "\":{\"count\":" + std::to_string(histogram.count) + ",\"sum\":" + std::to_string(histogram.sum) + ",\"buckets\":[";
+    for (size_t i = 0; i < HistogramSnapshot::bucket_count; ++i) {
+        if (i > 0)
+            out += ',';
+        out += std::to_string(histogram.buckets[i]);
+    }
+    out += "]},";
+}
+
+void append_json(std::string &out, std::string_view name, std::uint64_t value) {
+    out += '"';
+    out += name;
+    out += "\":" + std::to_string(value) + ',';
+}
+
+} // namespace
+
+HistogramSnapshot Metrics::Histogram::snapshot() const {
+    HistogramSnapshot result;
+    for (size_t i = 0; i < m_buckets.size(); ++i)
+        result.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    result.count = m_count.load(std::memory_order_relaxed);
+    result.sum = m_sum.load(std::memory_order_relaxed);
+    return result;
+}
+
+MetricsSnapshot Metrics::snapshot() const {
+    return MetricsSnapshot{hash_time.snapshot(), copy_time.snapshot(),  compare_time.snapshot(), distinguisher_steps.snapshot(),
+                           key_probes.value(),    bytes_hashed.value(), bytes_stored.value()};
+}
+
+std::string MetricsSnapshot::to_prometheus() const {
+    std::string out;
+    append_histogram(out, "filestore_hash_seconds", "Time hashing content for its key.", hash_time, 1e-9);
+    append_histogram(out, "filestore_copy_seconds", "Time writing content into the store.", copy_time, 1e-9);
+    append_histogram(out, "filestore_compare_seconds", "Time comparing content to stored objects with the same key.", compare_time, 1e-9);
+    append_histogram(out, "filestore_distinguisher_steps", "Keys skipped for an added content, as they hold other contents.", distinguisher_steps, 1);
+    append_counter(out, "filestore_key_probes_total", "Lookups whether a key is stored.", key_probes);
+    append_counter(out, "filestore_hashed_bytes_total", "Bytes hashed for keys.", bytes_hashed);
+    append_counter(out, "filestore_stored_bytes_total", "Content bytes of new objects.", bytes_stored);
+    return out;
+}
+
+// Histograms with their buckets as in HistogramSnapshot, not cumulative, and times in nanoseconds
+std::string MetricsSnapshot::to_json() const {
+    std::string out = "{";
+    append_json(out, "hash_time_ns", hash_time);
+    append_json(out, "copy_time_ns", copy_time);
+    append_json(out, "compare_time_ns", compare_time);
+    append_json(out, "distinguisher_steps", distinguisher_steps);
+    append_json(out, "key_probes", key_probes);
+    append_json(out, "bytes_hashed", bytes_hashed);
+    append_json(out, "bytes_stored", bytes_stored);
+    out.back() = '}';
+    return out;
+}
+
+} // namespace filestore
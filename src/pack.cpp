@@ -0,0 +1,380 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/pack.h"
+#include "FileStore/crc32c.h"
+#include "FileStore/file.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// Index layout (native byte order): header, followed by fixed size records. The data files have no header.
+constexpr char index_magic[8] = {'F', 'S', 'P', 'A', 'C', 'K', 'I', 'X'};
+constexpr std::uint32_t index_version = 1;
+
+struct index_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+};
+
+enum record_type : std::uint32_t {
+    added = 1,
+    removed = 2,
+};
+
+struct index_record {
+    std::byte key[Key::bytelength];
+    std::uint32_t type;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::int64_t import_time;
+    std::uint32_t data_checksum; // CRC-32C of the object
+    std::uint32_t checksum;      // CRC-32C of all preceding bytes
+};
+
+static_assert(sizeof(index_header) == 16);
+static_assert(sizeof(index_record) == 72);
+
+constexpr auto checksum_offset = offsetof(index_record, checksum);
+
+std::uint32_t record_checksum(const index_record &record) {
+    return crc32c(std::span(reinterpret_cast<const std::byte *>(&record), checksum_offset));
+}
+
+index_record make_record(const Key &k, const PackLocation &location, std::uint32_t type) {
+    index_record record{};
+    std::memcpy(record.key, k.data.data(), Key::bytelength);
+    record.type = type;
+    record.offset = location.offset;
+    record.size = location.size;
+    record.import_time = location.import_time;
+    record.data_checksum = location.checksum;
+    record.checksum = record_checksum(record);
+    return record;
+}
+
+void write_record(std::ostream &output, const index_record &record, const fs::path &file_path) {
+    if (!output.write(reinterpret_cast<const char *>(&record), sizeof(record)))
+        throw FileError{"Error writing file", file_path};
+}
+
+void write_header(std::ostream &output) {
+    index_header header{};
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.record_size = sizeof(index_record);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void flush_to_disk([[maybe_unused]] const fs::path &file_path) {
+#if !defined(_WIN32)
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+// pack-NNNNNN.idx
+std::optional<std::uint32_t> pack_number(const fs::path &index_path) {
+    if (index_path.extension() != ".idx")
+        return std::nullopt;
+    const auto name = index_path.stem().string();
+    if (!name.starts_with("pack-"))
+        return std::nullopt;
+    std::uint32_t number = 0;
+    const auto [end, ec] = std::from_chars(name.data() + 5, name.data() + name.size(), number);
+    if (ec != std::errc{} || end != name.data() + name.size())
+        return std::nullopt;
+    return number;
+}
+
+} // namespace
+
+PackStore::PackStore(const fs::path &directory, std::uint64_t max_pack_size) : m_directory{directory}, m_max_pack_size{max_pack_size} {
+    fs::create_directories(m_directory);
+
+    std::vector<std::uint32_t> numbers;
+    for (const auto &entry : fs::directory_iterator{m_directory})
+        if (const auto number = pack_number(entry.path()))
+            numbers.push_back(*number);
+    std::sort(numbers.begin(), numbers.end());
+    // later packs take precedence, as objects are only moved to newer packs
+    for (const auto number : numbers)
+        load(number);
+    for (const auto &[key, location] : m_index)
+        m_packs[location.pack]->live_size += location.size;
+
+    if (m_packs.empty())
+        start_pack(1);
+    else if (m_packs.rbegin()->second->size >= m_max_pack_size)
+        start_pack(m_packs.rbegin()->first + 1);
+    else
+        start_pack(m_packs.rbegin()->first);
+}
+
+fs::path PackStore::data_path(std::uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "pack-%06u.pack", number);
+    return m_directory / name;
+}
+
+fs::path PackStore::index_path(std::uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "pack-%06u.idx", number);
+    return m_directory / name;
+}
+
+// Reads the index of a pack. Records after a damaged one, or that point past the end of the data file (which was
+// not written completely), are cut off.
+void PackStore::load(std::uint32_t number) {
+    const auto file_path = index_path(number);
+    std::error_code ec;
+    auto data_size = fs::file_size(data_path(number), ec);
+    if (ec)
+        data_size = 0;
+
+    const auto content = read_file(file_path);
+    const auto data = std::as_bytes(std::span{content});
+    index_header header;
+    if (data.size() < sizeof(header)) {
+        // a crash while the pack was started
+        std::ofstream output{file_path, std::ios_base::binary | std::ios_base::trunc};
+        write_header(output);
+        if (!output.flush())
+            throw FileError{"Could not create file", file_path};
+        m_packs[number] = std::make_unique<pack>();
+        m_packs[number]->size = data_size;
+        return;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, index_magic, sizeof(index_magic)) != 0 || header.version != index_version ||
+        header.record_size != sizeof(index_record))
+        throw FileError{"Invalid pack index", file_path};
+
+    const auto stored_records = (data.size() - sizeof(header)) / sizeof(index_record);
+    size_t records = 0;
+    for (; records < stored_records; ++records) {
+        index_record record;
+        std::memcpy(&record, data.data() + sizeof(header) + records * sizeof(index_record), sizeof(record));
+        if (record.checksum != record_checksum(record) || (record.type != added && record.type != removed) ||
+            (record.type == added && record.offset + record.size > data_size))
+            break;
+
+        Key key;
+        std::memcpy(key.data.data(), record.key, Key::bytelength);
+        if (record.type == added) {
+            m_index[key] = PackLocation{number, record.offset, record.size, record.import_time, record.data_checksum};
+        } else if (const auto it = m_index.find(key); it != m_index.end() && it->second.pack == number) {
+            m_index.erase(it);
+        }
+    }
+
+    const auto valid_size = sizeof(header) + records * sizeof(index_record);
+    if (valid_size != data.size())
+        fs::resize_file(file_path, valid_size);
+    m_packs[number] = std::make_unique<pack>();
+    m_packs[number]->size = data_size;
+}
+
+void PackStore::start_pack(std::uint32_t number) {
+    if (m_data_output.is_open()) {
+        m_data_output.close();
+        m_index_output.close();
+        flush_to_disk(data_path(m_active));
+        flush_to_disk(index_path(m_active));
+    }
+
+    const auto file_path = index_path(number);
+    if (!fs::exists(file_path)) {
+        std::ofstream output{file_path, std::ios_base::binary | std::ios_base::trunc};
+        write_header(output);
+        if (!output.flush())
+            throw FileError{"Could not create file", file_path};
+    }
+    auto &p = m_packs[number];
+    if (!p) {
+        p = std::make_unique<pack>();
+        std::error_code ec;
+        p->size = fs::file_size(data_path(number), ec);
+        if (ec)
+            p->size = 0;
+    }
+
+    m_data_output.open(data_path(number), std::ios_base::binary | std::ios_base::app);
+    if (!m_data_output)
+        throw FileError{"Could not open file", data_path(number)};
+    m_index_output.open(file_path, std::ios_base::binary | std::ios_base::app);
+    if (!m_index_output)
+        throw FileError{"Could not open file", file_path};
+    m_active = number;
+}
+
+bool PackStore::contains(const Key &k) const {
+    std::shared_lock lock{m_mutex};
+    return m_index.contains(k);
+}
+
+std::optional<PackLocation> PackStore::find(const Key &k) const {
+    std::shared_lock lock{m_mutex};
+    const auto it = m_index.find(k);
+    if (it == m_index.end())
+        return std::nullopt;
+    return it->second;
+}
+
+std::optional<PackedObject> PackStore::read(const Key &k) const {
+    std::shared_lock lock{m_mutex};
+    const auto it = m_index.find(k);
+    if (it == m_index.end())
+        return std::nullopt;
+    const auto &location = it->second;
+    auto data_mapping = mapping(*m_packs.at(location.pack), location.pack, location.offset + location.size);
+    const auto data = data_mapping->data().subspan(location.offset, location.size);
+    return PackedObject{std::move(data_mapping), data};
+}
+
+// The newest pack grows, so it is mapped again, when an object past the end of the mapping is read. Mappings
+// handed out before stay valid.
+std::shared_ptr<const MappedFile> PackStore::mapping(const pack &p, std::uint32_t number, std::uint64_t end) const {
+    std::lock_guard lock{p.mapping_mutex};
+    if (!p.mapping || p.mapping->size() < end) {
+        if (number == m_active)
+            m_data_output.flush();
+        p.mapping = std::make_shared<const MappedFile>(data_path(number));
+        if (p.mapping->size() < end)
+            throw FileError{"Pack file is truncated", data_path(number)};
+    }
+    return p.mapping;
+}
+
+void PackStore::add(const Key &k, std::span<const std::byte> data, std::int64_t import_time) {
+    std::unique_lock lock{m_mutex};
+    append(k, data, import_time);
+    flush_locked();
+}
+
+void PackStore::append(const Key &k, std::span<const std::byte> data, std::int64_t import_time) {
+    if (m_packs.at(m_active)->size > 0 && m_packs.at(m_active)->size + data.size() > m_max_pack_size)
+        start_pack(m_active + 1);
+
+    auto &p = *m_packs.at(m_active);
+    const PackLocation location{m_active, p.size, data.size(), import_time, crc32c(data)};
+    // the data is written before its record, so a record never points to missing data
+    if (!m_data_output.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size())))
+        throw FileError{"Error writing file", data_path(m_active)};
+    write_record(m_index_output, make_record(k, location, added), index_path(m_active));
+
+    p.size += data.size();
+    p.live_size += data.size();
+    if (const auto it = m_index.find(k); it != m_index.end())
+        m_packs.at(it->second.pack)->live_size -= it->second.size;
+    m_index[k] = location;
+}
+
+bool PackStore::remove(const Key &k) {
+    std::unique_lock lock{m_mutex};
+    const auto it = m_index.find(k);
+    if (it == m_index.end())
+        return false;
+
+    const auto &location = it->second;
+    const auto record = make_record(k, location, removed);
+    if (location.pack == m_active) {
+        write_record(m_index_output, record, index_path(m_active));
+        flush_locked();
+    } else {
+        std::ofstream output{index_path(location.pack), std::ios_base::binary | std::ios_base::app};
+        write_record(output, record, index_path(location.pack));
+    }
+    m_packs.at(location.pack)->live_size -= location.size;
+    m_index.erase(it);
+    return true;
+}
+
+void PackStore::for_each(const std::function<void(const Key &, const PackLocation &)> &f) const {
+    std::shared_lock lock{m_mutex};
+    for (const auto &[key, location] : m_index)
+        f(key, location);
+}
+
+size_t PackStore::size() const {
+    std::shared_lock lock{m_mutex};
+    return m_index.size();
+}
+
+size_t PackStore::pack_count() const {
+    std::shared_lock lock{m_mutex};
+    return m_packs.size();
+}
+
+size_t PackStore::repack(double min_garbage) {
+    size_t rewritten = 0;
+    while (true) {
+        std::unique_lock lock{m_mutex};
+        const auto it = std::find_if(m_packs.begin(), m_packs.end(), [&](const auto &entry) {
+            const auto &p = *entry.second;
+            return entry.first != m_active && static_cast<double>(p.size - p.live_size) >= min_garbage * static_cast<double>(p.size);
+        });
+        if (it == m_packs.end())
+            break;
+        const auto number = it->first;
+
+        std::vector<std::pair<Key, PackLocation>> objects;
+        for (const auto &[key, location] : m_index)
+            if (location.pack == number)
+                objects.emplace_back(key, location);
+        if (!objects.empty()) {
+            const MappedFile source{data_path(number)};
+            for (const auto &[key, location] : objects)
+                append(key, source.data().subspan(location.offset, location.size), location.import_time);
+            // the copies must be on the disk, before the originals are gone
+            sync_locked();
+        }
+
+        m_packs.erase(it);
+        std::error_code ec;
+        fs::remove(index_path(number), ec);
+        fs::remove(data_path(number), ec);
+        ++rewritten;
+    }
+    return rewritten;
+}
+
+void PackStore::sync() {
+    std::unique_lock lock{m_mutex};
+    sync_locked();
+}
+
+// The data before the index, so a record written by a crash never points to missing data
+void PackStore::flush_locked() {
+    if (!m_data_output.flush())
+        throw FileError{"Error writing file", data_path(m_active)};
+    if (!m_index_output.flush())
+        throw FileError{"Error writing file", index_path(m_active)};
+}
+
+void PackStore::sync_locked() {
+    flush_locked();
+    flush_to_disk(data_path(m_active));
+    flush_to_disk(index_path(m_active));
+}
+
+} // namespace filestore
@@ -4,127 +4,263 @@
  * ******************************************************* */
 
 #include "FileStore/sha256.h"
-#include <cassert>
+#include "FileStore/cpu.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+#endif
 
 namespace filestore {
 
 SHA256::SHA256() {
-    h[0] = 0x6a09e667;
-    h[1] = 0xbb67ae85;
-    h[2] = 0x3c6ef372;
-    h[3] = 0xa54ff53a;
-    h[4] = 0x510e527f;
-    h[5] = 0x9b05688c;
-    h[6] = 0x1f83d9ab;
-    h[7] = 0x5be0cd19;
+    std::copy(std::begin(H0), std::end(H0), h.begin());
     bytes_stored = 0;
     bytes_processed = 0;
 }
 
 void SHA256::update(std::span<const char> data) {
+    const char *input = data.data();
     auto size = data.size();
-    char *buffer = std::bit_cast<char *>(W.data());
-    size_t data_offset = 0;
 
-    while (size > 0) {
+    // complete a partially filled block first
+    if (bytes_stored > 0) {
         const auto bytes_to_copy = std::min(size, free_buffer_bytes());
-        std::memcpy(buffer + bytes_stored, data.data() + data_offset, bytes_to_copy);
+        std::memcpy(buffer.data() + bytes_stored, input, bytes_to_copy);
         bytes_stored += bytes_to_copy;
+        input += bytes_to_copy;
         size -= bytes_to_copy;
-        data_offset += bytes_to_copy;
 
-        if (buffer_full())
-            process_block();
+        if (!buffer_full())
+            return;
+        process_block();
+    }
+
+    // full blocks are processed directly from the input without copying
+    const auto num_blocks = size / buffer_size;
+    if (num_blocks > 0) {
+        process_blocks(input, num_blocks);
+        input += num_blocks * buffer_size;
+        size -= num_blocks * buffer_size;
     }
+
+    std::memcpy(buffer.data(), input, size);
+    bytes_stored = size;
 }
 
-SHA256::word byte_swap(SHA256::word w) {
-    SHA256::word r = w & 0xff;
-    r = (r << 8) | (w >> 8) & 0xff;
-    r = (r << 8) | (w >> 16) & 0xff;
-    r = (r << 8) | (w >> 24) & 0xff;
-    return r;
+namespace {
+
+template<typename T>
+T to_big_endian(T value) {
+    if constexpr (std::endian::native == std::endian::little)
+        return std::byteswap(value);
+    else
+        return value;
 }
 
-uint64_t byte_swap(uint64_t w) {
-    uint64_t r = w & 0xff;
-    r = (r << 8) | (w >> 8) & 0xff;
-    r = (r << 8) | (w >> 16) & 0xff;
-    r = (r << 8) | (w >> 24) & 0xff;
-    r = (r << 8) | (w >> 32) & 0xff;
-    r = (r << 8) | (w >> 40) & 0xff;
-    r = (r << 8) | (w >> 48) & 0xff;
-    r = (r << 8) | (w >> 56) & 0xff;
-    return r;
+template<typename T>
+T load_big_endian(const char *data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return to_big_endian(value);
 }
 
+} // namespace
+
 SHA256::hash_type SHA256::hash() {
     static_assert(SHA256::hash_size == sizeof(h) * 8);
 
     finalize();
     hash_type hash_value;
     for (int i = 0; i < 8; ++i) {
-        word w = byte_swap(h[i]);
+        word w = to_big_endian(h[i]);
         std::memcpy(hash_value.data.data() + sizeof(w) * i, &w, sizeof(w));
     }
     return hash_value;
 }
 
 void SHA256::process_block() {
-    for (int i = 0; i < 16; ++i)
-        W[i] = byte_swap(W[i]); // byte to number type conversion (byte order/endianess)
-
-    for (int t = 16; t < 64; ++t)
-        W[t] = sigma1(W[t - 2]) + W[t - 7] + sigma0(W[t - 15]) + W[t - 16];
-
-    word w_tmp[8];
-    std::copy(std::begin(h), std::end(h), std::begin(w_tmp));
-
-    for (int t = 0; t < 64; ++t) {
-        word T1 = w_tmp[7] + Sigma1(w_tmp[4]) + Ch(w_tmp[4], w_tmp[5], w_tmp[6]) + K[t] + W[t];
-        word T2 = Sigma0(w_tmp[0]) + Maj(w_tmp[0], w_tmp[1], w_tmp[2]);
-        w_tmp[7] = w_tmp[6];
-        w_tmp[6] = w_tmp[5];
-        w_tmp[5] = w_tmp[4];
-        w_tmp[4] = w_tmp[3] + T1;
-        w_tmp[3] = w_tmp[2];
-        w_tmp[2] = w_tmp[1];
-        w_tmp[1] = w_tmp[0];
-        w_tmp[0] = T1 + T2;
-    }
-
-    for (int i = 0; i < 8; ++i)
-        h[i] += w_tmp[i];
-
-    bytes_processed += buffer_size;
+    process_blocks(buffer.data(), 1);
     bytes_stored = 0;
 }
 
+void SHA256::process_blocks(const char *blocks, size_t num_blocks) {
+    compress.load(std::memory_order_relaxed)(h.data(), blocks, num_blocks);
+    bytes_processed += num_blocks * buffer_size;
+}
+
 void SHA256::finalize() {
     uint64_t message_bit_length = (bytes_processed + bytes_stored) * 8;
 
-    char *buffer = std::bit_cast<char *>(W.data());
-
     // append single 1-bit to the data
     // cannot be full, because then it would have already been processed and emptied again
-    buffer[bytes_stored] = (uint8_t)0x80;
+    buffer[bytes_stored] = static_cast<char>(0x80);
     ++bytes_stored;
 
     // fill remainder of the block with 0
-    std::memset(buffer + bytes_stored, 0, free_buffer_bytes());
+    std::memset(buffer.data() + bytes_stored, 0, free_buffer_bytes());
 
     if (free_buffer_bytes() < 8) { // not enough room to store message length
         // start a new block
         process_block();
-        memset(buffer, 0, buffer_size);
+        std::memset(buffer.data(), 0, buffer_size);
     }
 
     // put message length at end of block
-    uint64_t L = byte_swap(message_bit_length); // number type to bytes conversion (byte order/endianess)
-    std::memcpy(buffer + buffer_size - sizeof(L), &L, sizeof(L));
+    uint64_t L = to_big_endian(message_bit_length); // number type to bytes conversion (byte order/endianess)
+    std::memcpy(buffer.data() + buffer_size - sizeof(L), &L, sizeof(L));
     process_block();
 }
 
+void SHA256::compress_generic(word *state, const char *blocks, size_t num_blocks) {
+    std::array<word, 64> W;
+
+    for (size_t block = 0; block < num_blocks; ++block, blocks += buffer_size) {
+        for (int i = 0; i < 16; ++i)
+            W[i] = load_big_endian<word>(blocks + i * sizeof(word)); // byte to number type conversion (byte order/endianess)
+
+        for (int t = 16; t < 64; ++t)
+            W[t] = sigma1(W[t - 2]) + W[t - 7] + sigma0(W[t - 15]) + W[t - 16];
+
+        word w_tmp[8];
+        std::copy(state, state + 8, std::begin(w_tmp));
+
+        for (int t = 0; t < 64; ++t) {
+            word T1 = w_tmp[7] + Sigma1(w_tmp[4]) + Ch(w_tmp[4], w_tmp[5], w_tmp[6]) + K[t] + W[t];
+            word T2 = Sigma0(w_tmp[0]) + Maj(w_tmp[0], w_tmp[1], w_tmp[2]);
+            w_tmp[7] = w_tmp[6];
+            w_tmp[6] = w_tmp[5];
+            w_tmp[5] = w_tmp[4];
+            w_tmp[4] = w_tmp[3] + T1;
+            w_tmp[3] = w_tmp[2];
+            w_tmp[2] = w_tmp[1];
+            w_tmp[1] = w_tmp[0];
+            w_tmp[0] = T1 + T2;
+        }
+
+        for (int i = 0; i < 8; ++i)
+            state[i] += w_tmp[i];
+    }
+}
+
+#if defined(FILESTORE_X86)
+FILESTORE_TARGET("sha,sse4.1,ssse3")
+void SHA256::compress_shani(word *state, const char *blocks, size_t num_blocks) {
+    const __m128i byte_order_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // the sha256rnds2 instruction expects the state as ABEF/CDGH
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4));
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);            // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1b);      // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);   // CDGH
+
+    for (size_t block = 0; block < num_blocks; ++block, blocks += buffer_size) {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+
+        // message schedule: msg[i % 4] holds W[4i..4i+3]
+        __m128i msg[4];
+        for (int i = 0; i < 4; ++i)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * i)), byte_order_mask);
+
+#if defined(__clang__)
+#pragma unroll
+#elif defined(__GNUC__)
+#pragma GCC unroll 16
+#endif
+        for (int i = 0; i < 16; ++i) {
+            __m128i &current = msg[i % 4];
+            __m128i &previous = msg[(i + 3) % 4];
+
+            __m128i wk = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i *>(K + 4 * i)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            if (i >= 3 && i < 15) {
+                __m128i &next = msg[(i + 1) % 4];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+            wk = _mm_shuffle_epi32(wk, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+            if (i >= 1 && i < 13)
+                previous = _mm_sha256msg1_epu32(previous, current);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);       // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);    // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), state1);
+}
+#else
+void SHA256::compress_shani(word *state, const char *blocks, size_t num_blocks) {
+    compress_generic(state, blocks, num_blocks);
+}
+#endif
+
+bool SHA256::is_supported(Implementation impl) {
+    switch (impl) {
+    case Implementation::generic:
+        return true;
+    case Implementation::shani:
+#if defined(FILESTORE_X86)
+        return cpu().sha && cpu().sse41 && cpu().ssse3;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+SHA256::Implementation SHA256::detect_implementation() {
+    if (is_supported(Implementation::shani))
+        return Implementation::shani;
+    return Implementation::generic;
+}
+
+SHA256::compress_function SHA256::select_compress_function(Implementation impl) {
+    switch (impl) {
+    case Implementation::shani:
+        return &SHA256::compress_shani;
+    case Implementation::generic:
+        break;
+    }
+    return &SHA256::compress_generic;
+}
+
+// resolved on first use, so that hashing during static initialization works as well
+std::atomic<SHA256::compress_function> SHA256::compress{&SHA256::compress_dispatch};
+
+void SHA256::compress_dispatch(word *state, const char *blocks, size_t num_blocks) {
+    auto function = select_compress_function(detect_implementation());
+    compress_function expected = &SHA256::compress_dispatch;
+    compress.compare_exchange_strong(expected, function, std::memory_order_relaxed);
+    compress.load(std::memory_order_relaxed)(state, blocks, num_blocks);
+}
+
+SHA256::Implementation SHA256::implementation() {
+    auto function = compress.load(std::memory_order_relaxed);
+    if (function == &SHA256::compress_dispatch)
+        return detect_implementation();
+    return function == &SHA256::compress_shani ? Implementation::shani : Implementation::generic;
+}
+
+bool SHA256::use_implementation(Implementation impl) {
+    if (!is_supported(impl))
+        return false;
+    compress.store(select_compress_function(impl), std::memory_order_relaxed);
+    return true;
+}
+
 SHA256::word SHA256::Ch(word x, word y, word z) {
     return (x & y) ^ (~x & z);
 }
@@ -0,0 +1,48 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+// compiled with AVX2 enabled, only called after checking the CPU features
+
+#include "sha256_lanes.h"
+
+#include "FileStore/cpu.h"
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+
+namespace filestore::lanes {
+
+namespace {
+
+struct avx2 {
+    using type = __m256i;
+    static constexpr int lanes = 8;
+
+    static type load(const std::uint32_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static void store(std::uint32_t *p, type x) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), x); }
+    static type set1(std::uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+    static type add(type x, type y) { return _mm256_add_epi32(x, y); }
+    static type xor3(type x, type y, type z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+    static type ch(type x, type y, type z) { return _mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z)); }
+    static type maj(type x, type y, type z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y))); }
+    template<int n>
+    static type rotr(type x) {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+    template<int n>
+    static type shr(type x) {
+        return _mm256_srli_epi32(x, n);
+    }
+};
+
+} // namespace
+
+void compress_avx2(std::uint32_t *state, const std::uint32_t *words) {
+    compress<avx2>(state, words);
+}
+
+} // namespace filestore::lanes
+
+#endif
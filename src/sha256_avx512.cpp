@@ -0,0 +1,48 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+// compiled with AVX-512F enabled, only called after checking the CPU features
+
+#include "sha256_lanes.h"
+
+#include "FileStore/cpu.h"
+
+#if defined(FILESTORE_X86)
+#include <immintrin.h>
+
+namespace filestore::lanes {
+
+namespace {
+
+struct avx512 {
+    using type = __m512i;
+    static constexpr int lanes = 16;
+
+    static type load(const std::uint32_t *p) { return _mm512_loadu_si512(p); }
+    static void store(std::uint32_t *p, type x) { _mm512_storeu_si512(p, x); }
+    static type set1(std::uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+    static type add(type x, type y) { return _mm512_add_epi32(x, y); }
+    static type xor3(type x, type y, type z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+    static type ch(type x, type y, type z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+    static type maj(type x, type y, type z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe8); }
+    template<int n>
+    static type rotr(type x) {
+        return _mm512_ror_epi32(x, n);
+    }
+    template<int n>
+    static type shr(type x) {
+        return _mm512_srli_epi32(x, n);
+    }
+};
+
+} // namespace
+
+void compress_avx512(std::uint32_t *state, const std::uint32_t *words) {
+    compress<avx512>(state, words);
+}
+
+} // namespace filestore::lanes
+
+#endif
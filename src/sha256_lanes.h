@@ -0,0 +1,79 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_SHA256_LANES_H
+#define FILESTORE_SHA256_LANES_H
+
+// SHA256 compression function working on N independent messages at once. All data is stored lane-interleaved:
+// state[i * N + lane] holds state word i of a lane, words[t * N + lane] holds message word t (already converted
+// from big endian) of the block processed by a lane.
+//
+// The template is instantiated in translation units compiled for the respective instruction set. Everything
+// lives in an anonymous namespace, so no code compiled with extended instruction sets can be picked by the
+// linker for callers on CPUs without these extensions.
+
+#include "FileStore/sha256.h"
+
+#include <cstdint>
+
+namespace filestore::lanes {
+
+void compress_avx2(std::uint32_t *state, const std::uint32_t *words);   // 8 lanes
+void compress_avx512(std::uint32_t *state, const std::uint32_t *words); // 16 lanes
+
+namespace {
+
+template<typename V>
+inline void compress(std::uint32_t *state, const std::uint32_t *words) {
+    using vec = typename V::type;
+    constexpr auto N = V::lanes;
+
+    const auto Sigma0 = [](vec x) { return V::xor3(V::template rotr<2>(x), V::template rotr<13>(x), V::template rotr<22>(x)); };
+    const auto Sigma1 = [](vec x) { return V::xor3(V::template rotr<6>(x), V::template rotr<11>(x), V::template rotr<25>(x)); };
+    const auto sigma0 = [](vec x) { return V::xor3(V::template rotr<7>(x), V::template rotr<18>(x), V::template shr<3>(x)); };
+    const auto sigma1 = [](vec x) { return V::xor3(V::template rotr<17>(x), V::template rotr<19>(x), V::template shr<10>(x)); };
+
+    vec s[8];
+    for (int i = 0; i < 8; ++i)
+        s[i] = V::load(state + i * N);
+    vec a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    vec W[16];
+    for (int t = 0; t < 64; ++t) {
+        vec w;
+        if (t < 16) {
+            w = V::load(words + t * N);
+        } else {
+            w = V::add(V::add(sigma1(W[(t - 2) & 15]), W[(t - 7) & 15]), V::add(sigma0(W[(t - 15) & 15]), W[t & 15]));
+        }
+        W[t & 15] = w;
+
+        const vec T1 = V::add(V::add(V::add(h, Sigma1(e)), V::add(V::ch(e, f, g), V::set1(SHA256::K[t]))), w);
+        const vec T2 = V::add(Sigma0(a), V::maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = V::add(d, T1);
+        d = c;
+        c = b;
+        b = a;
+        a = V::add(T1, T2);
+    }
+
+    V::store(state + 0 * N, V::add(s[0], a));
+    V::store(state + 1 * N, V::add(s[1], b));
+    V::store(state + 2 * N, V::add(s[2], c));
+    V::store(state + 3 * N, V::add(s[3], d));
+    V::store(state + 4 * N, V::add(s[4], e));
+    V::store(state + 5 * N, V::add(s[5], f));
+    V::store(state + 6 * N, V::add(s[6], g));
+    V::store(state + 7 * N, V::add(s[7], h));
+}
+
+} // namespace
+
+} // namespace filestore::lanes
+
+#endif
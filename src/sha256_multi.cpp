@@ -0,0 +1,208 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/sha256_multi.h"
+#include "FileStore/cpu.h"
+#include "sha256_lanes.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace filestore {
+
+namespace {
+
+using word = SHA256::word;
+constexpr auto block_size = SHA256::block_size;
+
+word load_big_endian(const char *data) {
+    word value;
+    std::memcpy(&value, data, sizeof(word));
+    if constexpr (std::endian::native == std::endian::little)
+        return std::byteswap(value);
+    else
+        return value;
+}
+
+// A message being hashed in one lane: the full blocks are read directly from the message, the padded
+// remainder (one or two blocks) is kept in the job itself.
+struct lane_job {
+    size_t message_index{0};
+    const char *data{nullptr};
+    size_t full_blocks{0};
+    size_t tail_blocks{0};
+    size_t next_block{0};
+    std::array<char, 2 * block_size> tail{};
+
+    void start(size_t index, std::span<const char> message) {
+        message_index = index;
+        data = message.data();
+        full_blocks = message.size() / block_size;
+        next_block = 0;
+
+        const auto rest = message.size() % block_size;
+        tail.fill(0);
+        std::memcpy(tail.data(), data + full_blocks * block_size, rest);
+        tail[rest] = static_cast<char>(0x80);
+        tail_blocks = rest + 1 + sizeof(std::uint64_t) <= block_size ? 1 : 2;
+
+        std::uint64_t bit_length = static_cast<std::uint64_t>(message.size()) * 8;
+        if constexpr (std::endian::native == std::endian::little)
+            bit_length = std::byteswap(bit_length);
+        std::memcpy(tail.data() + tail_blocks * block_size - sizeof(bit_length), &bit_length, sizeof(bit_length));
+    }
+
+    const char *block() const {
+        if (next_block < full_blocks)
+            return data + next_block * block_size;
+        return tail.data() + (next_block - full_blocks) * block_size;
+    }
+    bool finished() const { return next_block == full_blocks + tail_blocks; }
+};
+
+template<size_t N>
+std::vector<SHA256::hash_type> hash_lanes(std::span<const std::span<const char>> messages, void (*compress)(word *, const word *)) {
+    std::vector<SHA256::hash_type> hashes(messages.size());
+
+    alignas(64) std::array<word, 8 * N> state{};
+    alignas(64) std::array<word, 16 * N> words{};
+    std::array<lane_job, N> jobs;
+    std::array<bool, N> active{};
+    static constexpr std::array<char, block_size> idle_block{};
+
+    size_t next_message = 0;
+    size_t active_lanes = 0;
+    const auto start_next_message = [&](size_t lane) {
+        if (next_message == messages.size()) {
+            active[lane] = false;
+            return;
+        }
+        jobs[lane].start(next_message, messages[next_message]);
+        for (size_t i = 0; i < 8; ++i)
+            state[i * N + lane] = SHA256::H0[i];
+        ++next_message;
+        active[lane] = true;
+        ++active_lanes;
+    };
+
+    for (size_t lane = 0; lane < N; ++lane)
+        start_next_message(lane);
+
+    while (active_lanes > 0) {
+        for (size_t lane = 0; lane < N; ++lane) {
+            const char *block = active[lane] ? jobs[lane].block() : idle_block.data();
+            for (size_t t = 0; t < 16; ++t)
+                words[t * N + lane] = load_big_endian(block + t * sizeof(word));
+        }
+
+        compress(state.data(), words.data());
+
+        for (size_t lane = 0; lane < N; ++lane) {
+            if (!active[lane])
+                continue;
+            auto &job = jobs[lane];
+            ++job.next_block;
+            if (!job.finished())
+                continue;
+
+            auto &hash = hashes[job.message_index];
+            for (size_t i = 0; i < 8; ++i) {
+                word w = state[i * N + lane];
+                if constexpr (std::endian::native == std::endian::little)
+                    w = std::byteswap(w);
+                std::memcpy(hash.data.data() + i * sizeof(word), &w, sizeof(word));
+            }
+            --active_lanes;
+            start_next_message(lane);
+        }
+    }
+    return hashes;
+}
+
+std::vector<SHA256::hash_type> hash_sequential(std::span<const std::span<const char>> messages) {
+    std::vector<SHA256::hash_type> hashes;
+    hashes.reserve(messages.size());
+    for (const auto &message : messages) {
+        SHA256 sha;
+        sha.update(message);
+        hashes.push_back(sha.hash());
+    }
+    return hashes;
+}
+
+} // namespace
+
+std::atomic<int> SHA256Multi::selected{-1};
+
+std::vector<SHA256Multi::hash_type> SHA256Multi::hash(std::span<const std::span<const char>> messages) {
+    switch (implementation()) {
+#if defined(FILESTORE_X86)
+    case Implementation::avx2:
+        return hash_lanes<8>(messages, &lanes::compress_avx2);
+    case Implementation::avx512:
+        return hash_lanes<16>(messages, &lanes::compress_avx512);
+#endif
+    default:
+        return hash_sequential(messages);
+    }
+}
+
+size_t SHA256Multi::lanes() {
+    switch (implementation()) {
+    case Implementation::avx2:
+        return 8;
+    case Implementation::avx512:
+        return 16;
+    case Implementation::sequential:
+        break;
+    }
+    return 1;
+}
+
+bool SHA256Multi::is_supported(Implementation impl) {
+    switch (impl) {
+    case Implementation::sequential:
+        return true;
+#if defined(FILESTORE_X86)
+    case Implementation::avx2:
+        return cpu().avx2;
+    case Implementation::avx512:
+        return cpu().avx512f;
+#else
+    default:
+        return false;
+#endif
+    }
+    return false;
+}
+
+SHA256Multi::Implementation SHA256Multi::detect_implementation() {
+    // 16 lanes outperform the SHA extensions (about 1.6 times for messages of 4 to 64 KiB), 8 lanes do not
+    if (is_supported(Implementation::avx512))
+        return Implementation::avx512;
+    if (SHA256::implementation() == SHA256::Implementation::shani)
+        return Implementation::sequential;
+    if (is_supported(Implementation::avx2))
+        return Implementation::avx2;
+    return Implementation::sequential;
+}
+
+SHA256Multi::Implementation SHA256Multi::implementation() {
+    const auto impl = selected.load(std::memory_order_relaxed);
+    if (impl < 0)
+        return detect_implementation();
+    return static_cast<Implementation>(impl);
+}
+
+bool SHA256Multi::use_implementation(Implementation impl) {
+    if (!is_supported(impl))
+        return false;
+    selected.store(static_cast<int>(impl), std::memory_order_relaxed);
+    return true;
+}
+
+} // namespace filestore
@@ -0,0 +1,135 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/shard_layout.h"
+#include "FileStore/bin_utils.h"
+#include "FileStore/file.h"
+
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+namespace filestore {
+
+namespace {
+
+// The root has no digits, so it is written as a single dash
+constexpr std::string_view root_prefix = "-";
+
+} // namespace
+
+ShardLayout::ShardLayout(int folder_levels, std::uint64_t split_threshold) : m_split_threshold{split_threshold} {
+    if (folder_levels < 0 || folder_levels > max_initial_levels)
+        throw std::invalid_argument{"Invalid number of folder levels for adaptive sharding"};
+
+    // each level of split directories below the previous one, so the parents are always split first
+    std::vector<std::vector<std::byte>> level{{}};
+    for (int depth = 0; depth < folder_levels; ++depth) {
+        std::vector<std::vector<std::byte>> next;
+        for (const auto &prefix : level) {
+            split(prefix);
+            if (depth + 1 < folder_levels) {
+                for (size_t b = 0; b < 256; ++b) {
+                    next.push_back(prefix);
+                    next.back().push_back(static_cast<std::byte>(b));
+                }
+            }
+        }
+        level = std::move(next);
+    }
+}
+
+ShardLayout::ShardLayout(const fs::path &file_path) {
+    std::ifstream input{file_path};
+    if (!input)
+        throw FileError{"Could not open file", file_path};
+
+    std::string name;
+    std::string value;
+    while (input >> name >> value) {
+        if (name == "split_threshold") {
+            try {
+                m_split_threshold = std::stoull(value);
+            } catch (const std::exception &) {
+                throw FileError{"Invalid split threshold " + value, file_path};
+            }
+        } else if (name == "split") {
+            std::vector<std::byte> prefix(value == root_prefix ? 0 : value.size() / 2);
+            if ((value != root_prefix && !hex_decode(value, prefix)) || prefix.size() >= max_depth ||
+                (!prefix.empty() && !is_split(std::span{prefix}.first(prefix.size() - 1))))
+                throw FileError{"Invalid split " + value, file_path};
+            split(prefix);
+        }
+    }
+}
+
+ShardLayout::~ShardLayout() = default;
+
+const ShardLayout::Node *ShardLayout::find(std::span<const std::byte> prefix) const {
+    const Node *node = m_root.load(std::memory_order_acquire);
+    for (size_t i = 0; node != nullptr && i < prefix.size(); ++i)
+        node = node->children[std::to_integer<size_t>(prefix[i])].load(std::memory_order_acquire);
+    return node;
+}
+
+int ShardLayout::depth(const Key &k) const {
+    int depth = 0;
+    for (const Node *node = m_root.load(std::memory_order_acquire); node != nullptr; ++depth)
+        node = node->children[std::to_integer<size_t>(k.data[depth])].load(std::memory_order_acquire);
+    return depth;
+}
+
+bool ShardLayout::is_split(std::span<const std::byte> prefix) const {
+    return find(prefix) != nullptr;
+}
+
+bool ShardLayout::split(std::span<const std::byte> prefix) {
+    if (prefix.size() >= max_depth)
+        return false;
+    std::lock_guard lock{m_mutex};
+    if (find(prefix) != nullptr)
+        return false;
+    const Node *parent = prefix.empty() ? nullptr : find(prefix.first(prefix.size() - 1));
+    if (!prefix.empty() && parent == nullptr)
+        throw std::invalid_argument{"Parent directory is not split"};
+
+    auto *node = m_nodes.emplace_back(std::make_unique<Node>()).get();
+    // the nodes are only changed under the lock, so the parent can be written through
+    if (prefix.empty())
+        m_root.store(node, std::memory_order_release);
+    else
+        const_cast<Node *>(parent)->children[std::to_integer<size_t>(prefix.back())].store(node, std::memory_order_release);
+    m_version.fetch_add(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void ShardLayout::save(const fs::path &file_path) const {
+    auto temp_path = file_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream output{temp_path, std::ios_base::trunc};
+        output << "split_threshold " << m_split_threshold << '\n';
+        std::lock_guard lock{m_mutex};
+        std::vector<std::byte> prefix;
+        const std::function<void(const Node &)> write_splits = [&](const Node &node) {
+            output << "split " << (prefix.empty() ? std::string{root_prefix} : bytes_to_hex(prefix.begin(), prefix.end())) << '\n';
+            for (size_t b = 0; b < node.children.size(); ++b) {
+                if (const auto *child = node.children[b].load(std::memory_order_relaxed)) {
+                    prefix.push_back(static_cast<std::byte>(b));
+                    write_splits(*child);
+                    prefix.pop_back();
+                }
+            }
+        };
+        if (const auto *root = m_root.load(std::memory_order_relaxed))
+            write_splits(*root);
+        if (!output.flush())
+            throw FileError{"Error writing file", temp_path};
+    }
+    fs::rename(temp_path, file_path);
+}
+
+} // namespace filestore
@@ -0,0 +1,210 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/source_cache.h"
+#include "FileStore/crc32c.h"
+#include "FileStore/file.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace filestore {
+
+namespace {
+
+// File layout (native byte order): header, followed by records of a fixed part and the path
+constexpr char cache_magic[8] = {'F', 'S', 'S', 'R', 'C', 'C', 'C', 'H'};
+constexpr std::uint32_t cache_version = 1;
+
+struct cache_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t key_size;
+};
+
+struct cache_record {
+    std::uint32_t path_length;
+    std::uint32_t checksum; // CRC-32C of the following bytes and the path
+    std::uint64_t size;
+    std::int64_t modification_time;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::byte key[Key::bytelength];
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(cache_header) == 16);
+static_assert(sizeof(cache_record) == 80);
+
+constexpr auto checked_offset = offsetof(cache_record, size);
+
+std::uint32_t record_checksum(const cache_record &record, std::string_view path) {
+    const auto *bytes = reinterpret_cast<const std::byte *>(&record);
+    const auto crc = crc32c(std::span(bytes + checked_offset, sizeof(record) - checked_offset));
+    return crc32c(std::as_bytes(std::span(path)), crc);
+}
+
+void write_header(std::ostream &output) {
+    cache_header header{};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.key_size = Key::bytelength;
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+bool write_record(std::ostream &output, const std::string &source, const SourceState &state, const Key &key) {
+    cache_record record{};
+    record.path_length = static_cast<std::uint32_t>(source.size());
+    record.size = state.size;
+    record.modification_time = state.modification_time;
+    record.device = state.device;
+    record.inode = state.inode;
+    std::memcpy(record.key, key.data.data(), Key::bytelength);
+    record.checksum = record_checksum(record, source);
+
+    output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    return static_cast<bool>(output.write(source.data(), static_cast<std::streamsize>(source.size())));
+}
+
+} // namespace
+
+SourceCache::SourceCache(const fs::path &file_path) : m_file_path{file_path} {
+    load();
+}
+
+// Reads all valid records. A damaged record ends the cache, it and everything after it is dropped by rewriting
+// the file, which also removes records that were superseded by later ones.
+void SourceCache::load() {
+    std::error_code ec;
+    std::vector<char> data;
+    if (fs::exists(m_file_path, ec))
+        data = read_file(m_file_path);
+
+    cache_header header{};
+    bool valid = data.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, data.data(), sizeof(header));
+        valid = std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 && header.version == cache_version &&
+                header.key_size == Key::bytelength;
+    }
+
+    size_t records = 0;
+    size_t offset = sizeof(header);
+    while (valid && data.size() - offset >= sizeof(cache_record)) {
+        cache_record record;
+        std::memcpy(&record, data.data() + offset, sizeof(record));
+        if (data.size() - offset - sizeof(record) < record.path_length)
+            break;
+        const std::string_view path{data.data() + offset + sizeof(record), record.path_length};
+        if (record.checksum != record_checksum(record, path))
+            break;
+
+        Entry entry{{record.size, record.modification_time, record.device, record.inode}, {}};
+        std::memcpy(entry.key.data.data(), record.key, Key::bytelength);
+        m_entries.insert_or_assign(std::string{path}, entry);
+        offset += sizeof(record) + record.path_length;
+        ++records;
+    }
+
+    if (!valid || offset != data.size() || records > 2 * m_entries.size())
+        rewrite();
+
+    m_output.open(m_file_path, std::ios_base::binary | std::ios_base::app);
+    if (!m_output)
+        throw FileError{"Could not open file", m_file_path};
+}
+
+// The new file is written next to the current one and replaces it atomically
+void SourceCache::rewrite() {
+    auto temp_path = m_file_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream output{temp_path, std::ios_base::binary | std::ios_base::trunc};
+        write_header(output);
+        for (const auto &[source, entry] : m_entries)
+            write_record(output, source, entry.state, entry.key);
+        if (!output.flush())
+            throw FileError{"Error writing file", temp_path};
+    }
+    fs::rename(temp_path, m_file_path);
+}
+
+std::optional<Key> SourceCache::find(const fs::path &source, const SourceState &state) const {
+    const auto path = cache_path(source);
+    std::lock_guard lock{m_mutex};
+    const auto it = m_entries.find(path);
+    if (it == m_entries.end() || it->second.state != state)
+        return std::nullopt;
+    return it->second.key;
+}
+
+void SourceCache::insert(const fs::path &source, const SourceState &state, const Key &key) {
+    const auto path = cache_path(source);
+    const Entry entry{state, key};
+    std::lock_guard lock{m_mutex};
+    const auto it = m_entries.find(path);
+    if (it != m_entries.end() && it->second.state == state && it->second.key == key)
+        return;
+    m_entries.insert_or_assign(path, entry);
+    if (!write_record(m_output, path, state, key))
+        throw FileError{"Error writing file", m_file_path};
+}
+
+size_t SourceCache::size() const {
+    std::lock_guard lock{m_mutex};
+    return m_entries.size();
+}
+
+void SourceCache::flush() {
+    std::lock_guard lock{m_mutex};
+    if (!m_output.flush())
+        throw FileError{"Error writing file", m_file_path};
+}
+
+// A single stat, so all values are taken at the same time
+std::optional<SourceState> SourceCache::describe(const fs::path &source) {
+#if !defined(_WIN32)
+    struct stat st;
+    if (::stat(source.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return std::nullopt;
+#if defined(__APPLE__)
+    const auto &modification_time = st.st_mtimespec;
+#else
+    const auto &modification_time = st.st_mtim;
+#endif
+    SourceState state;
+    state.size = static_cast<std::uint64_t>(st.st_size);
+    state.modification_time = static_cast<std::int64_t>(modification_time.tv_sec) * 1'000'000'000 + modification_time.tv_nsec;
+    state.device = static_cast<std::uint64_t>(st.st_dev);
+    state.inode = static_cast<std::uint64_t>(st.st_ino);
+    return state;
+#else
+    std::error_code ec;
+    const auto status = fs::status(source, ec);
+    if (ec || !fs::is_regular_file(status))
+        return std::nullopt;
+
+    SourceState state;
+    state.size = fs::file_size(source, ec);
+    const auto modification_time = fs::last_write_time(source, ec);
+    if (ec)
+        return std::nullopt;
+    const auto system_time = std::chrono::file_clock::to_sys(modification_time);
+    state.modification_time = std::chrono::duration_cast<std::chrono::nanoseconds>(system_time.time_since_epoch()).count();
+    return state;
+#endif
+}
+
+std::string SourceCache::cache_path(const fs::path &source) {
+    return fs::absolute(source).lexically_normal().string();
+}
+
+} // namespace filestore
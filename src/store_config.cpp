@@ -0,0 +1,146 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/store_config.h"
+#include "FileStore/file.h"
+#include "FileStore/hash.h"
+#include "FileStore/mapped_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace filestore {
+
+namespace {
+
+const char *scheme_name(KeyScheme scheme) {
+    switch (scheme) {
+    case KeyScheme::sha256:
+        return "sha256";
+    case KeyScheme::sha256_tree:
+        return "sha256-tree";
+    case KeyScheme::blake3:
+        return "blake3";
+    case KeyScheme::xxh128:
+        return "xxh128";
+    }
+    return "";
+}
+
+hash_value<256> to_hash_value(const hash_value<256> &hash) {
+    return hash;
+}
+
+// Big endian, as xxHash writes its canonical form, padded with zeros
+hash_value<256> to_hash_value(const xxh128_hash &hash) {
+    hash_value<256> value;
+    std::uint64_t words[2] = {hash.high, hash.low};
+    if constexpr (std::endian::native == std::endian::little) {
+        words[0] = std::byteswap(words[0]);
+        words[1] = std::byteswap(words[1]);
+    }
+    std::memcpy(value.data.data(), words, sizeof(words));
+    return value;
+}
+
+} // namespace
+
+void StoreConfig::save(const fs::path &file_path) const {
+    auto temp_path = file_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream output{temp_path, std::ios_base::trunc};
+        output << "key_scheme " << scheme_name(key_scheme) << '\n';
+        output << "leaf_size " << leaf_size << '\n';
+        if (!output.flush())
+            throw FileError{"Error writing file", temp_path};
+    }
+    fs::rename(temp_path, file_path);
+}
+
+// Unknown names are skipped, so older versions can open stores with settings they do not use
+StoreConfig StoreConfig::load(const fs::path &file_path) {
+    std::ifstream input{file_path};
+    if (!input)
+        throw FileError{"Could not open file", file_path};
+
+    StoreConfig config;
+    std::string name;
+    std::string value;
+    while (input >> name >> value) {
+        if (name == "key_scheme") {
+            const auto schemes = {KeyScheme::sha256, KeyScheme::sha256_tree, KeyScheme::blake3, KeyScheme::xxh128};
+            const auto scheme = std::ranges::find(schemes, value, scheme_name);
+            if (scheme == schemes.end())
+                throw FileError{"Unknown key scheme " + value, file_path};
+            config.key_scheme = *scheme;
+        } else if (name == "leaf_size") {
+            try {
+                config.leaf_size = static_cast<std::uint32_t>(std::stoul(value));
+            } catch (const std::exception &) {
+                config.leaf_size = 0;
+            }
+            if (config.leaf_size == 0)
+                throw FileError{"Invalid leaf size " + value, file_path};
+        }
+    }
+    return config;
+}
+
+KeyHasher::KeyHasher(const StoreConfig &config) {
+    switch (config.key_scheme) {
+    case KeyScheme::sha256:
+        break;
+    case KeyScheme::sha256_tree:
+        m_hasher.emplace<TreeHash>(config.leaf_size);
+        break;
+    case KeyScheme::blake3:
+        m_hasher.emplace<Blake3>();
+        break;
+    case KeyScheme::xxh128:
+        m_hasher.emplace<XXH3_128>();
+        break;
+    }
+}
+
+void KeyHasher::update(std::span<const char> data) {
+    std::visit([data](auto &hasher) { hasher.update(data); }, m_hasher);
+}
+
+ContentHash KeyHasher::hash() {
+    if (auto *tree = std::get_if<TreeHash>(&m_hasher)) {
+        const auto root = tree->hash();
+        return ContentHash{root, tree->leaves()};
+    }
+    return std::visit([](auto &hasher) { return ContentHash{to_hash_value(hasher.hash()), {}}; }, m_hasher);
+}
+
+ContentHash hash_content(std::span<const std::byte> data, const StoreConfig &config, ThreadPool *pool) {
+    if (config.key_scheme == KeyScheme::sha256_tree) {
+        auto result = tree_hash(data, config.leaf_size, pool);
+        return ContentHash{result.root, std::move(result.leaves)};
+    }
+    if (config.key_scheme == KeyScheme::xxh128)
+        return ContentHash{to_hash_value(xxh3_128(data)), {}};
+    KeyHasher hasher{config};
+    hasher.update({reinterpret_cast<const char *>(data.data()), data.size()});
+    return hasher.hash();
+}
+
+ContentHash hash_file_content(const fs::path &file_path, const StoreConfig &config, ThreadPool *pool) {
+    if (config.key_scheme == KeyScheme::sha256_tree) {
+        auto result = tree_hash_file(file_path, config.leaf_size, pool);
+        return ContentHash{result.root, std::move(result.leaves)};
+    }
+    if (config.key_scheme == KeyScheme::sha256)
+        return ContentHash{hash_file<SHA256>(file_path), {}};
+    const MappedFile file{file_path};
+    return hash_content(file.data(), config, pool);
+}
+
+} // namespace filestore
@@ -0,0 +1,191 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace filestore {
+
+namespace {
+
+// identifies the pool and queue of the current worker thread
+thread_local const void *current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0)
+        num_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    m_queues.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+        m_queues.push_back(std::make_unique<Queue>());
+    m_workers.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+        m_workers.emplace_back([this, i]() { run(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{m_mutex};
+        m_stop = true;
+    }
+    m_work_available.notify_all();
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::submit(task_type task) {
+    const auto index = current_pool == this ? current_queue : m_next_queue++ % m_queues.size();
+
+    // counted before the task becomes visible, so that m_queued can never drop below zero
+    {
+        std::lock_guard lock{m_mutex};
+        ++m_pending;
+        ++m_queued;
+    }
+    {
+        auto &queue = *m_queues[index];
+        std::lock_guard lock{queue.mutex};
+        queue.tasks.push_back(std::move(task));
+    }
+    m_work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock{m_mutex};
+    m_all_done.wait(lock, [this]() { return m_pending == 0; });
+    if (m_exception)
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+}
+
+void ThreadPool::run(size_t index) {
+    current_pool = this;
+    current_queue = index;
+
+    task_type task;
+    while (true) {
+        if (pop_task(index, task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock lock{m_mutex};
+        m_work_available.wait(lock, [this]() { return m_stop || m_queued > 0; });
+        if (m_stop && m_queued == 0)
+            return;
+    }
+}
+
+bool ThreadPool::pop_task(size_t index, task_type &task) {
+    // own queue: newest task first, as its data is most likely still in the cache
+    {
+        auto &queue = *m_queues[index];
+        std::lock_guard lock{queue.mutex};
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+    // steal the oldest task from another worker
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+        auto &queue = *m_queues[(index + i) % m_queues.size()];
+        std::lock_guard lock{queue.mutex};
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --m_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(task_type &task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard lock{m_mutex};
+        if (!m_exception)
+            m_exception = std::current_exception();
+    }
+    task = nullptr;
+    finish_task();
+}
+
+void ThreadPool::finish_task() {
+    if (--m_pending == 0) {
+        std::lock_guard lock{m_mutex};
+        m_all_done.notify_all();
+    }
+}
+
+bool ThreadPool::is_current_worker() const {
+    return current_pool == this;
+}
+
+bool ThreadPool::run_queued_task() {
+    task_type task;
+    if (!is_current_worker() || !pop_task(current_queue, task))
+        return false;
+    execute(task);
+    return true;
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // only reported by wait
+    }
+}
+
+// The exceptions of the tasks are kept by the group, so they do not show up in ThreadPool::wait
+void TaskGroup::submit(ThreadPool::task_type task) {
+    {
+        std::lock_guard lock{m_mutex};
+        ++m_pending;
+    }
+    m_pool.submit([this, task = std::move(task)]() {
+        std::exception_ptr exception;
+        try {
+            task();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        std::lock_guard lock{m_mutex};
+        if (exception && !m_exception)
+            m_exception = exception;
+        if (--m_pending == 0)
+            m_done.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    const auto finished = [this]() { return m_pending == 0; };
+    std::unique_lock lock{m_mutex};
+    if (!m_pool.is_current_worker()) {
+        m_done.wait(lock, finished);
+    } else {
+        // the tasks of the group may be queued behind the one waiting, so the worker helps instead of blocking
+        while (!finished()) {
+            lock.unlock();
+            const bool ran = m_pool.run_queued_task();
+            lock.lock();
+            if (!ran)
+                m_done.wait_for(lock, std::chrono::milliseconds{1}, finished);
+        }
+    }
+    if (m_exception)
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+}
+
+} // namespace filestore
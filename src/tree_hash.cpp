@@ -0,0 +1,118 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/tree_hash.h"
+#include "FileStore/mapped_file.h"
+
+#include <algorithm>
+
+namespace filestore {
+
+namespace {
+
+constexpr char leaf_prefix[1] = {0};
+constexpr char node_prefix[1] = {1};
+
+// Leaves are only hashed on other threads, if there are enough of them to make up for handing them over
+constexpr size_t min_parallel_leaves = 4;
+
+// For all calls without a pool of their own, so parallel imports do not start threads for each file
+ThreadPool &shared_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+std::span<const char> as_chars(std::span<const std::byte> data) {
+    return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+} // namespace
+
+TreeHash::TreeHash(std::uint32_t leaf_size) : m_leaf_size{leaf_size} {
+    m_leaf.update(leaf_prefix);
+}
+
+void TreeHash::update(std::span<const char> data) {
+    while (!data.empty()) {
+        // a full leaf is only finished, when more data follows, so the last leaf is never empty
+        if (m_leaf_bytes == m_leaf_size)
+            finish_leaf();
+        const auto count = std::min<size_t>(data.size(), m_leaf_size - m_leaf_bytes);
+        m_leaf.update(data.first(count));
+        m_leaf_bytes += count;
+        data = data.subspan(count);
+    }
+}
+
+void TreeHash::finish_leaf() {
+    m_leaves.push_back(m_leaf.hash());
+    m_leaf = SHA256{};
+    m_leaf.update(leaf_prefix);
+    m_leaf_bytes = 0;
+}
+
+TreeHash::hash_type TreeHash::hash() {
+    m_leaves.push_back(m_leaf.hash());
+    return root(m_leaves);
+}
+
+TreeHash::hash_type TreeHash::hash_leaf(std::span<const std::byte> data) {
+    SHA256 sha;
+    sha.update(leaf_prefix);
+    sha.update(as_chars(data));
+    return sha.hash();
+}
+
+TreeHash::hash_type TreeHash::root(std::span<const hash_type> leaves) {
+    if (leaves.empty())
+        return hash_leaf({});
+    std::vector<hash_type> level(leaves.begin(), leaves.end());
+    while (level.size() > 1) {
+        std::vector<hash_type> next;
+        next.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            SHA256 sha;
+            sha.update(node_prefix);
+            sha.update(as_chars(level[i].data));
+            sha.update(as_chars(level[i + 1].data));
+            next.push_back(sha.hash());
+        }
+        if (level.size() % 2 == 1)
+            next.push_back(level.back());
+        level = std::move(next);
+    }
+    return level.front();
+}
+
+TreeHashResult tree_hash(std::span<const std::byte> data, std::uint32_t leaf_size, ThreadPool *pool) {
+    const auto leaf_count = std::max<size_t>(1, (data.size() + leaf_size - 1) / leaf_size);
+    std::vector<TreeHash::hash_type> leaves(leaf_count);
+    const auto hash_leaves = [&](size_t first, size_t step) {
+        for (auto i = first; i < leaf_count; i += step)
+            leaves[i] = TreeHash::hash_leaf(data.subspan(i * leaf_size, std::min<size_t>(leaf_size, data.size() - i * leaf_size)));
+    };
+
+    if (pool == nullptr && leaf_count >= min_parallel_leaves)
+        pool = &shared_pool();
+    if (pool == nullptr) {
+        hash_leaves(0, 1);
+    } else {
+        // the calling thread takes a share, too
+        const auto tasks = std::min(leaf_count, pool->size() + 1);
+        TaskGroup group{*pool};
+        for (size_t task = 1; task < tasks; ++task)
+            group.submit([&hash_leaves, task, tasks]() { hash_leaves(task, tasks); });
+        hash_leaves(0, tasks);
+        group.wait();
+    }
+    return TreeHashResult{TreeHash::root(leaves), std::move(leaves)};
+}
+
+TreeHashResult tree_hash_file(const fs::path &file_path, std::uint32_t leaf_size, ThreadPool *pool) {
+    const MappedFile file{file_path};
+    return tree_hash(file.data(), leaf_size, pool);
+}
+
+} // namespace filestore
@@ -0,0 +1,293 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include "FileStore/xxhash.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace filestore {
+
+namespace {
+
+constexpr std::uint64_t prime1 = 0x9e3779b185ebca87ULL;
+constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr std::uint64_t prime3 = 0x165667b19e3779f9ULL;
+constexpr std::uint64_t prime4 = 0x85ebca77c2b2ae63ULL;
+constexpr std::uint64_t prime5 = 0x27d4eb2f165667c5ULL;
+constexpr std::uint32_t prime32_1 = 0x9e3779b1U;
+constexpr std::uint32_t prime32_2 = 0x85ebca77U;
+constexpr std::uint32_t prime32_3 = 0xc2b2ae3dU;
+constexpr std::uint64_t prime_mx1 = 0x165667919e3779f9ULL;
+constexpr std::uint64_t prime_mx2 = 0x9fb21c651e98df25ULL;
+
+template<typename T>
+T read_le(const std::byte *p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big)
+        value = std::byteswap(value);
+    return value;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+    acc += input * prime2;
+    acc = std::rotl(acc, 31);
+    return acc * prime1;
+}
+
+std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value) {
+    acc ^= round(0, value);
+    return acc * prime1 + prime4;
+}
+
+std::uint64_t avalanche64(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// XXH3
+
+// The default secret of XXH3
+constexpr std::uint8_t secret_bytes[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+const std::byte *const secret = reinterpret_cast<const std::byte *>(secret_bytes);
+constexpr size_t secret_size = sizeof(secret_bytes);
+constexpr size_t stripe_size = 64;
+constexpr size_t stripes_per_block = (secret_size - stripe_size) / 8;
+constexpr size_t max_short_length = 240;
+
+xxh128_hash multiply(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const auto product = static_cast<unsigned __int128>(a) * b;
+    return {static_cast<std::uint64_t>(product), static_cast<std::uint64_t>(product >> 64)};
+#else
+    const auto lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    const auto hi_lo = (a >> 32) * (b & 0xffffffff);
+    const auto lo_hi = (a & 0xffffffff) * (b >> 32);
+    const auto hi_hi = (a >> 32) * (b >> 32);
+    const auto cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return {(cross << 32) | (lo_lo & 0xffffffff), (hi_lo >> 32) + (cross >> 32) + hi_hi};
+#endif
+}
+
+std::uint64_t multiply_fold(std::uint64_t a, std::uint64_t b) {
+    const auto product = multiply(a, b);
+    return product.low ^ product.high;
+}
+
+std::uint64_t xorshift(std::uint64_t v, int shift) {
+    return v ^ (v >> shift);
+}
+
+std::uint64_t avalanche3(std::uint64_t h) {
+    return xorshift(xorshift(h, 37) * prime_mx1, 32);
+}
+
+std::uint64_t mix16(const std::byte *input, const std::byte *key) {
+    return multiply_fold(read_le<std::uint64_t>(input) ^ read_le<std::uint64_t>(key), read_le<std::uint64_t>(input + 8) ^ read_le<std::uint64_t>(key + 8));
+}
+
+void mix32(xxh128_hash &acc, const std::byte *input1, const std::byte *input2, const std::byte *key) {
+    acc.low += mix16(input1, key);
+    acc.low ^= read_le<std::uint64_t>(input2) + read_le<std::uint64_t>(input2 + 8);
+    acc.high += mix16(input2, key + 16);
+    acc.high ^= read_le<std::uint64_t>(input1) + read_le<std::uint64_t>(input1 + 8);
+}
+
+xxh128_hash finish_mid(const xxh128_hash &acc, std::uint64_t length) {
+    return {avalanche3(acc.low + acc.high), 0 - avalanche3(acc.low * prime1 + acc.high * prime4 + length * prime2)};
+}
+
+// Inputs of up to max_short_length bytes are hashed without the accumulators
+xxh128_hash hash_short(std::span<const std::byte> data) {
+    const auto *p = data.data();
+    const std::uint64_t length = data.size();
+    if (length == 0)
+        return {avalanche64(read_le<std::uint64_t>(secret + 64) ^ read_le<std::uint64_t>(secret + 72)),
+                avalanche64(read_le<std::uint64_t>(secret + 80) ^ read_le<std::uint64_t>(secret + 88))};
+    if (length <= 3) {
+        const auto combined_low = (std::to_integer<std::uint32_t>(p[0]) << 16) | (std::to_integer<std::uint32_t>(p[length >> 1]) << 24) |
+                                  std::to_integer<std::uint32_t>(p[length - 1]) | static_cast<std::uint32_t>(length << 8);
+        const auto combined_high = std::rotl(std::byteswap(combined_low), 13);
+        return {avalanche64(combined_low ^ static_cast<std::uint64_t>(read_le<std::uint32_t>(secret) ^ read_le<std::uint32_t>(secret + 4))),
+                avalanche64(combined_high ^ static_cast<std::uint64_t>(read_le<std::uint32_t>(secret + 8) ^ read_le<std::uint32_t>(secret + 12)))};
+    }
+    if (length <= 8) {
+        const auto input = read_le<std::uint32_t>(p) + (static_cast<std::uint64_t>(read_le<std::uint32_t>(p + length - 4)) << 32);
+        const auto keyed = input ^ read_le<std::uint64_t>(secret + 16) ^ read_le<std::uint64_t>(secret + 24);
+        auto m = multiply(keyed, prime1 + (length << 2));
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+        m.low = xorshift(xorshift(m.low, 35) * prime_mx2, 28);
+        m.high = avalanche3(m.high);
+        return m;
+    }
+    if (length <= 16) {
+        const auto input_low = read_le<std::uint64_t>(p);
+        const auto input_high = read_le<std::uint64_t>(p + length - 8);
+        auto m = multiply(input_low ^ input_high ^ read_le<std::uint64_t>(secret + 32) ^ read_le<std::uint64_t>(secret + 40), prime1);
+        const auto keyed_high = input_high ^ read_le<std::uint64_t>(secret + 48) ^ read_le<std::uint64_t>(secret + 56);
+        m.low += (length - 1) << 54;
+        m.high += keyed_high + (keyed_high & 0xffffffff) * (prime32_2 - 1);
+        m.low ^= std::byteswap(m.high);
+        auto h = multiply(m.low, prime2);
+        h.high += m.high * prime2;
+        return {avalanche3(h.low), avalanche3(h.high)};
+    }
+    xxh128_hash acc{length * prime1, 0};
+    if (length <= 128) {
+        if (length > 32) {
+            if (length > 64) {
+                if (length > 96)
+                    mix32(acc, p + 48, p + length - 64, secret + 96);
+                mix32(acc, p + 32, p + length - 48, secret + 64);
+            }
+            mix32(acc, p + 16, p + length - 32, secret + 32);
+        }
+        mix32(acc, p, p + length - 16, secret);
+        return finish_mid(acc, length);
+    }
+    for (size_t i = 32; i < 160; i += 32)
+        mix32(acc, p + i - 32, p + i - 16, secret + i - 32);
+    acc.low = avalanche3(acc.low);
+    acc.high = avalanche3(acc.high);
+    for (size_t i = 160; i <= length; i += 32)
+        mix32(acc, p + i - 32, p + i - 16, secret + 3 + i - 160);
+    mix32(acc, p + length - 16, p + length - 32, secret + 136 - 17 - 16);
+    return finish_mid(acc, length);
+}
+
+void accumulate_stripe(std::array<std::uint64_t, 8> &acc, const std::byte *input, const std::byte *key) {
+    for (size_t lane = 0; lane < 8; ++lane) {
+        const auto value = read_le<std::uint64_t>(input + 8 * lane);
+        const auto keyed = value ^ read_le<std::uint64_t>(key + 8 * lane);
+        acc[lane ^ 1] += value;
+        acc[lane] += (keyed & 0xffffffff) * (keyed >> 32);
+    }
+}
+
+void accumulate(std::array<std::uint64_t, 8> &acc, const std::byte *input, size_t stripes) {
+    for (size_t i = 0; i < stripes; ++i)
+        accumulate_stripe(acc, input + i * stripe_size, secret + i * 8);
+}
+
+void consume_block(std::array<std::uint64_t, 8> &acc, const std::byte *block) {
+    accumulate(acc, block, stripes_per_block);
+    for (size_t lane = 0; lane < 8; ++lane)
+        acc[lane] = (xorshift(acc[lane], 47) ^ read_le<std::uint64_t>(secret + secret_size - stripe_size + 8 * lane)) * prime32_1;
+}
+
+std::uint64_t merge_accumulators(const std::array<std::uint64_t, 8> &acc, const std::byte *key, std::uint64_t start) {
+    for (size_t i = 0; i < 4; ++i)
+        start += multiply_fold(acc[2 * i] ^ read_le<std::uint64_t>(key + 16 * i), acc[2 * i + 1] ^ read_le<std::uint64_t>(key + 16 * i + 8));
+    return avalanche3(start);
+}
+
+} // namespace
+
+std::uint64_t xxh64(std::span<const std::byte> data, std::uint64_t seed) {
+    const std::byte *p = data.data();
+    const std::byte *const end = p + data.size();
+    std::uint64_t h;
+
+    if (data.size() >= 32) {
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = round(v1, read_le<std::uint64_t>(p));
+            v2 = round(v2, read_le<std::uint64_t>(p + 8));
+            v3 = round(v3, read_le<std::uint64_t>(p + 16));
+            v4 = round(v4, read_le<std::uint64_t>(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+    h += data.size();
+
+    for (; end - p >= 8; p += 8) {
+        h ^= round(0, read_le<std::uint64_t>(p));
+        h = std::rotl(h, 27) * prime1 + prime4;
+    }
+    if (end - p >= 4) {
+        h ^= static_cast<std::uint64_t>(read_le<std::uint32_t>(p)) * prime1;
+        h = std::rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= std::to_integer<std::uint64_t>(*p) * prime5;
+        h = std::rotl(h, 11) * prime1;
+    }
+
+    return avalanche64(h);
+}
+
+xxh128_hash xxh3_128(std::span<const std::byte> data) {
+    if (data.size() <= max_short_length)
+        return hash_short(data);
+    XXH3_128 hasher;
+    hasher.update({reinterpret_cast<const char *>(data.data()), data.size()});
+    return hasher.hash();
+}
+
+XXH3_128::XXH3_128() : m_acc{prime32_3, prime1, prime2, prime3, prime4, prime32_2, prime5, prime32_1} {}
+
+// A block is only consumed, when more data follows, as the last stripe is treated differently
+void XXH3_128::update(std::span<const char> data) {
+    auto input = std::as_bytes(data);
+    m_length += input.size();
+    while (!input.empty()) {
+        if (m_buffered == block_size) {
+            consume_block(m_acc, m_buffer.data() + stripe_size);
+            std::memcpy(m_buffer.data(), m_buffer.data() + block_size, stripe_size);
+            m_buffered = 0;
+        }
+        if (m_buffered == 0) {
+            // blocks are read directly from the input
+            for (; input.size() > block_size; input = input.subspan(block_size)) {
+                consume_block(m_acc, input.data());
+                std::memcpy(m_buffer.data(), input.data() + block_size - stripe_size, stripe_size);
+            }
+        }
+        const auto count = std::min(input.size(), block_size - m_buffered);
+        std::memcpy(m_buffer.data() + stripe_size + m_buffered, input.data(), count);
+        m_buffered += count;
+        input = input.subspan(count);
+    }
+}
+
+xxh128_hash XXH3_128::hash() const {
+    const auto *rest = m_buffer.data() + stripe_size;
+    if (m_length <= max_short_length)
+        return hash_short({rest, m_buffered});
+
+    auto acc = m_acc;
+    accumulate(acc, rest, (m_buffered - 1) / stripe_size);
+    // the last stripe may reach back into the data consumed before
+    accumulate_stripe(acc, rest + m_buffered - stripe_size, secret + secret_size - stripe_size - 7);
+    return {merge_accumulators(acc, secret + 11, m_length * prime1), merge_accumulators(acc, secret + secret_size - 64 - 11, ~(m_length * prime2))};
+}
+
+} // namespace filestore
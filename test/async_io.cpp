@@ -0,0 +1,114 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/async_io.h"
+#include "FileStore/file.h"
+#include "temp_fs.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string test_content(size_t size, size_t seed) {
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+        content[i] = static_cast<char>((i * 31 + seed) % 251);
+    return content;
+}
+
+} // namespace
+
+TEST_CASE("async reads and copies", "[async_io]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    // more files than the queue depth, sizes around the chunk size
+    const std::vector<size_t> sizes{0, 1, 4096, AsyncIo::chunk_size, AsyncIo::chunk_size + 1, 3 * AsyncIo::chunk_size + 17, 100000, 5, 77, 12345};
+    std::vector<fs::path> files;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        files.push_back(temp.path() / std::to_string(i));
+        std::ofstream{files.back(), std::ios_base::binary} << test_content(sizes[i], i);
+    }
+
+    for (const auto backend : {AsyncIo::Backend::io_uring, AsyncIo::Backend::threads}) {
+        AsyncIo io{backend, 4, 2};
+        if (backend == AsyncIo::Backend::threads)
+            REQUIRE(io.backend() == AsyncIo::Backend::threads);
+
+        std::vector<std::string> contents(files.size());
+        std::vector<fs::path> copies;
+        std::atomic<int> done{0};
+        for (size_t i = 0; i < files.size(); ++i) {
+            copies.push_back(files[i]);
+            copies.back() += ".copy";
+            const auto on_data = [&contents, i](std::span<const char> data) { contents[i].append(data.begin(), data.end()); };
+            const auto on_done = [&done](std::exception_ptr error) {
+                if (!error)
+                    ++done;
+            };
+            if (i % 2 == 0)
+                io.read_file(files[i], on_data, on_done);
+            else
+                io.copy_file(files[i], copies.back(), on_data, on_done);
+        }
+        io.wait();
+
+        REQUIRE(done == static_cast<int>(files.size()));
+        for (size_t i = 0; i < files.size(); ++i) {
+            REQUIRE(contents[i] == test_content(sizes[i], i));
+            if (i % 2 == 1)
+                REQUIRE(files_are_equal(files[i], copies[i]));
+            fs::remove(copies[i]);
+        }
+    }
+}
+
+TEST_CASE("async errors", "[async_io]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    std::ofstream{temp.path() / "file", std::ios_base::binary} << test_content(3 * AsyncIo::chunk_size, 0);
+
+    for (const auto backend : {AsyncIo::Backend::io_uring, AsyncIo::Backend::threads}) {
+        AsyncIo io{backend, 8, 2};
+        std::mutex mutex;
+        std::vector<std::exception_ptr> errors;
+        const auto on_done = [&](std::exception_ptr error) {
+            std::lock_guard lock{mutex};
+            errors.push_back(error);
+        };
+
+        io.read_file(temp.path() / "missing", [](std::span<const char>) {}, on_done);
+        io.copy_file(temp.path() / "file", temp.path() / "missing" / "copy", [](std::span<const char>) {}, on_done);
+        // an exception from the data handler ends the read
+        int chunks = 0;
+        io.read_file(temp.path() / "file", [&chunks](std::span<const char>) {
+            if (++chunks == 2)
+                throw std::runtime_error("stop");
+        }, on_done);
+        io.wait();
+
+        REQUIRE(errors.size() == 3);
+        for (const auto &error : errors)
+            REQUIRE(error);
+        REQUIRE(chunks == 2);
+
+        // exceptions from done handlers and tasks are rethrown by wait
+        io.post([]() { throw std::runtime_error("task"); });
+        REQUIRE_THROWS_AS(io.wait(), std::runtime_error);
+        io.wait();
+    }
+}
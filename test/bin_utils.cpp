@@ -0,0 +1,57 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/bin_utils.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+TEST_CASE("hex encoding", "[bin_utils]") {
+    using namespace filestore;
+
+    REQUIRE(byte_to_hex(std::byte{0x00}) == "00");
+    REQUIRE(byte_to_hex(std::byte{0x9f}) == "9f");
+    REQUIRE(byte_to_hex(std::byte{0xff}) == "ff");
+
+    // lengths around the 16 byte blocks of the vectorized implementation
+    for (size_t length = 0; length <= 70; ++length) {
+        std::vector<std::byte> bytes(length);
+        std::string expected;
+        for (size_t i = 0; i < length; ++i) {
+            bytes[i] = static_cast<std::byte>(i * 73 + 5);
+            expected += "0123456789abcdef"[(i * 73 + 5) % 256 / 16];
+            expected += "0123456789abcdef"[(i * 73 + 5) % 16];
+        }
+        REQUIRE(bytes_to_hex(bytes.begin(), bytes.end()) == expected);
+
+        std::vector<std::byte> decoded(length);
+        REQUIRE(hex_decode(expected, decoded));
+        REQUIRE(decoded == bytes);
+    }
+
+    const std::deque<std::byte> values{std::byte{1}, std::byte{2}, std::byte{255}};
+    REQUIRE(bytes_to_hex(values.begin(), values.end()) == "0102ff");
+}
+
+TEST_CASE("hex decoding errors", "[bin_utils]") {
+    using namespace filestore;
+
+    std::vector<std::byte> bytes(20);
+    const std::string valid(40, 'a');
+    REQUIRE(hex_decode(valid, bytes));
+    REQUIRE_FALSE(hex_decode(valid.substr(1), bytes));
+    REQUIRE_FALSE(hex_decode(valid + "00", bytes));
+
+    // invalid characters in the vectorized part and in the rest
+    for (const size_t position : {0, 7, 31, 32, 39}) {
+        for (const char c : {'g', 'A', '/', ':', '`', '\0', '\xff'}) {
+            auto hex = valid;
+            hex[position] = c;
+            REQUIRE_FALSE(hex_decode(hex, bytes));
+        }
+    }
+}
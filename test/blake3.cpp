@@ -0,0 +1,75 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/blake3.h"
+#include "FileStore/hash.h"
+#include <algorithm>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The input of the official test vectors: bytes 0, 1, ..., 250, 0, 1, ...
+std::string test_input(size_t length) {
+    std::string data(length, 0);
+    for (size_t i = 0; i < length; ++i)
+        data[i] = static_cast<char>(i % 251);
+    return data;
+}
+
+std::string blake3_str(const std::string &data, size_t chunk_size = 0) {
+    filestore::Blake3 blake3;
+    if (chunk_size == 0)
+        chunk_size = std::max<size_t>(data.size(), 1);
+    for (size_t offset = 0; offset < data.size(); offset += chunk_size)
+        blake3.update(std::span(data.data() + offset, std::min(chunk_size, data.size() - offset)));
+    return to_hex_string(blake3.hash());
+}
+
+} // namespace
+
+TEST_CASE("blake3 hashes", "[hash]") {
+    using namespace std::string_literals;
+    using Impl = filestore::Blake3::Implementation;
+
+    const std::vector<std::pair<size_t, std::string>> vectors{
+        {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"s},
+        {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"s},
+        {1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"s},
+        {1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"s},
+        {1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"s},
+        {2049, "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"s},
+        {8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"s},
+        {31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47"s},
+        {102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"s},
+    };
+
+    const auto initial = filestore::Blake3::implementation();
+    for (const auto impl : {Impl::generic, Impl::avx2, Impl::avx512}) {
+        if (!filestore::Blake3::use_implementation(impl))
+            continue;
+        REQUIRE(filestore::Blake3::implementation() == impl);
+        REQUIRE(blake3_str("Hello, World!") == "288a86a79f20a3d6dccdca7713beaed178798296bdfa7913fa2a62d9727bf8f8"s);
+        for (const auto &[length, expected] : vectors) {
+            const auto data = test_input(length);
+            REQUIRE(blake3_str(data) == expected);
+            // pieces that split blocks and chunks
+            REQUIRE(blake3_str(data, 63) == expected);
+            REQUIRE(blake3_str(data, 1500) == expected);
+        }
+    }
+    filestore::Blake3::use_implementation(initial);
+}
+
+TEST_CASE("blake3 file hashes", "[hash]") {
+    using namespace std::string_literals;
+    std::filesystem::path root{"../../test/data"};
+    REQUIRE(to_hex_string(filestore::hash_file<filestore::Blake3>(root / "file3.dat")) == "758e7e33f6a407f2597c6bba185eebda513f63639b88353d4f710976c217daad"s);
+}
@@ -0,0 +1,231 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/catalog.h"
+#include "FileStore/filestore.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+filestore::CatalogEntry make_entry(int i) {
+    filestore::CatalogEntry entry;
+    entry.key.data[0] = static_cast<std::byte>(i & 0xff);
+    entry.key.data[1] = static_cast<std::byte>(i >> 8);
+    entry.size = 100 + i;
+    entry.modification_time = 1000 + i;
+    entry.import_time = 2000 + i;
+    return entry;
+}
+
+} // namespace
+
+TEST_CASE("catalog entries", "[catalog]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "catalog";
+    {
+        Catalog catalog{path};
+        REQUIRE(catalog.size() == 0);
+        for (int i = 0; i < 10; ++i)
+            catalog.add(make_entry(i));
+        REQUIRE(catalog.size() == 10);
+        catalog.remove(make_entry(3).key);
+        REQUIRE(catalog.size() == 9);
+
+        const auto entries = catalog.entries();
+        REQUIRE(entries.size() == 9);
+        REQUIRE(entries[3].key == make_entry(4).key);
+        REQUIRE(entries[3].size == 104);
+        REQUIRE(entries[3].modification_time == 1004);
+        REQUIRE(entries[3].import_time == 2004);
+    }
+    {
+        // persistent, and a removed object can be added again
+        Catalog catalog{path};
+        REQUIRE(catalog.size() == 9);
+        catalog.add(make_entry(3));
+        REQUIRE(catalog.entries().back().key == make_entry(3).key);
+        REQUIRE(catalog.size() == 10);
+
+        const auto size_before = fs::file_size(path);
+        catalog.remove(make_entry(0).key);
+        catalog.compact();
+        REQUIRE(fs::file_size(path) < size_before);
+        REQUIRE(catalog.size() == 9);
+        REQUIRE(catalog.entries().size() == 9);
+        catalog.add(make_entry(20));
+        REQUIRE(catalog.entries().size() == 10);
+    }
+    REQUIRE(Catalog{path}.size() == 10);
+}
+
+TEST_CASE("catalog with repeated changes", "[catalog]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "catalog";
+    {
+        Catalog catalog{path};
+        for (int i = 0; i < 5; ++i)
+            catalog.add(make_entry(i));
+        auto updated = make_entry(2);
+        updated.size = 200;
+        catalog.add(updated);
+        catalog.remove(make_entry(99).key);
+        catalog.remove(make_entry(1).key);
+        catalog.remove(make_entry(1).key);
+        REQUIRE(catalog.size() == 4);
+
+        const auto entries = catalog.entries();
+        REQUIRE(entries.size() == 4);
+        REQUIRE(entries[0].key == make_entry(0).key);
+        REQUIRE(entries[3].key == make_entry(2).key);
+        REQUIRE(entries[3].size == 200);
+    }
+    Catalog catalog{path};
+    REQUIRE(catalog.size() == 4);
+    catalog.compact();
+    REQUIRE(catalog.size() == 4);
+    REQUIRE(catalog.entries().size() == 4);
+}
+
+TEST_CASE("catalog after a crash", "[catalog]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "catalog";
+    const auto crashed_path = temp.path() / "crashed";
+    {
+        Catalog catalog{path};
+        REQUIRE(catalog.closed_cleanly());
+        for (int i = 0; i < 5; ++i)
+            catalog.add(make_entry(i));
+        // the files as a crash would leave them behind
+        fs::copy_file(path, crashed_path);
+        fs::copy_file(fs::path{path} += ".open", fs::path{crashed_path} += ".open");
+    }
+    REQUIRE_FALSE(fs::exists(fs::path{path} += ".open"));
+    REQUIRE(Catalog{path}.closed_cleanly());
+
+    {
+        Catalog catalog{crashed_path};
+        REQUIRE_FALSE(catalog.closed_cleanly());
+        REQUIRE(catalog.size() == 5);
+    }
+    REQUIRE(Catalog{crashed_path}.closed_cleanly());
+}
+
+TEST_CASE("catalog recovery", "[catalog]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "catalog";
+    {
+        Catalog catalog{path};
+        for (int i = 0; i < 5; ++i)
+            catalog.add(make_entry(i));
+        catalog.sync();
+    }
+    const auto full_size = fs::file_size(path);
+
+    // torn last record
+    fs::resize_file(path, full_size - 10);
+    {
+        Catalog catalog{path};
+        REQUIRE(catalog.size() == 4);
+        REQUIRE(fs::file_size(path) < full_size - 10);
+        catalog.add(make_entry(4));
+    }
+    REQUIRE(fs::file_size(path) == full_size);
+
+    // damaged record
+    {
+        std::fstream file{path, std::ios_base::binary | std::ios_base::in | std::ios_base::out};
+        file.seekp(static_cast<std::streamoff>(full_size) - 30);
+        file.put('x');
+    }
+    REQUIRE(Catalog{path}.size() == 4);
+
+    std::ofstream{temp.path() / "invalid"} << "not a catalog";
+    REQUIRE_THROWS_AS(Catalog{temp.path() / "invalid"}, FileError);
+}
+
+TEST_CASE("FileStore with catalog", "[catalog][filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS fs1;
+    Key k1;
+    {
+        FileStore store(fs1);
+        k1 = store.import(root / "file1.dat").value();
+        REQUIRE(store.object_count() == 1);
+    }
+    {
+        // existing objects are taken over into a new catalog
+        FileStore store(fs1, StoreOptions{.catalog = true});
+        REQUIRE(fs::exists(fs1.path() / ".filestore" / "catalog"));
+        REQUIRE(store.object_count() == 1);
+        REQUIRE(store.import(root / "file3.dat").has_value());
+        REQUIRE_FALSE(store.import(root / "file2.dat").has_value());
+        REQUIRE(store.object_count() == 2);
+    }
+    FileStore store(fs1, StoreOptions{.catalog = true});
+    std::vector<CatalogEntry> entries;
+    store.for_each_object([&entries](const CatalogEntry &entry) { entries.push_back(entry); });
+    REQUIRE(entries.size() == 2);
+    REQUIRE(entries[0].key == k1);
+    REQUIRE(entries[0].size == fs::file_size(root / "file1.dat"));
+    REQUIRE(entries[1].key == generate_file_key(root / "file3.dat"));
+    REQUIRE(entries[1].import_time >= entries[1].modification_time);
+    REQUIRE(entries[1].fingerprint() == fingerprint_file(root / "file3.dat"));
+
+    store.rebuild_catalog();
+    REQUIRE(store.object_count() == 2);
+
+    // objects stored without the catalog are only taken over after a crash, but copies see a rebuilt catalog
+    const auto copy = store;
+    REQUIRE(FileStore{fs1}.import(root / "file4.dat").has_value());
+    REQUIRE(copy.object_count() == 2);
+    store.rebuild_catalog();
+    REQUIRE(copy.object_count() == 3);
+}
+
+TEST_CASE("FileStore with catalog after a crash", "[catalog][filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS fs1;
+    {
+        FileStore store(fs1, StoreOptions{.catalog = true});
+        REQUIRE(store.import(root / "file1.dat").has_value());
+    }
+    REQUIRE(FileStore{fs1}.import(root / "file3.dat").has_value());
+    REQUIRE(FileStore(fs1, StoreOptions{.catalog = true}).object_count() == 1);
+
+    // the catalog was still open when the process ended
+    std::ofstream{fs1.path() / ".filestore" / "catalog.open"};
+    FileStore store(fs1, StoreOptions{.catalog = true});
+    REQUIRE(store.object_count() == 2);
+    std::vector<Key> keys;
+    store.for_each_object([&keys](const CatalogEntry &entry) { keys.push_back(entry.key); });
+    REQUIRE(std::ranges::find(keys, generate_file_key(root / "file3.dat")) != keys.end());
+}
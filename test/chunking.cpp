@@ -0,0 +1,83 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/chunking.h"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::byte> random_bytes(size_t count, unsigned seed) {
+    std::mt19937 rng{seed};
+    std::vector<std::byte> data(count);
+    std::generate(data.begin(), data.end(), [&rng]() { return static_cast<std::byte>(rng()); });
+    return data;
+}
+
+std::vector<std::vector<std::byte>> split(std::span<const std::byte> data, const filestore::ChunkingPolicy &policy) {
+    std::vector<std::vector<std::byte>> chunks;
+    while (!data.empty()) {
+        const auto size = filestore::next_chunk_size(data, policy);
+        chunks.emplace_back(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(size));
+        data = data.subspan(size);
+    }
+    return chunks;
+}
+
+} // namespace
+
+TEST_CASE("content-defined chunks", "[chunking]") {
+    using namespace filestore;
+
+    const ChunkingPolicy policy{.min_chunk_size = 2048, .average_chunk_size = 8192, .max_chunk_size = 32768};
+    const auto data = random_bytes(1U << 20, 1);
+    const auto chunks = split(data, policy);
+    REQUIRE(chunks.size() > 64);
+    REQUIRE(chunks.size() < 512);
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+        REQUIRE(chunks[i].size() >= policy.min_chunk_size);
+        REQUIRE(chunks[i].size() <= policy.max_chunk_size);
+    }
+
+    // an insertion only changes the chunks around it
+    auto changed = data;
+    const auto insertion = random_bytes(100, 2);
+    changed.insert(changed.begin() + 500000, insertion.begin(), insertion.end());
+    const auto changed_chunks = split(changed, policy);
+    const std::set<std::vector<std::byte>> original{chunks.begin(), chunks.end()};
+    const auto shared = std::count_if(changed_chunks.begin(), changed_chunks.end(), [&](const auto &chunk) { return original.contains(chunk); });
+    REQUIRE(static_cast<size_t>(shared) + 3 >= chunks.size());
+
+    REQUIRE(next_chunk_size({}, policy) == 0);
+    REQUIRE(next_chunk_size(std::span{data}.first(100), policy) == 100);
+}
+
+TEST_CASE("chunk manifests", "[chunking]") {
+    using namespace filestore;
+
+    ChunkManifest manifest{300, 42, {}};
+    for (int i = 0; i < 3; ++i) {
+        ChunkRef chunk{Key{}, 100};
+        chunk.key.data[0] = static_cast<std::byte>(i);
+        manifest.chunks.push_back(chunk);
+    }
+    auto data = manifest.serialize();
+    const auto parsed = ChunkManifest::parse(data);
+    REQUIRE(parsed);
+    REQUIRE(parsed->size == 300);
+    REQUIRE(parsed->fingerprint() == manifest.fingerprint());
+    REQUIRE(parsed->chunks.size() == 3);
+    REQUIRE(parsed->chunks[2].key == manifest.chunks[2].key);
+
+    data.back() ^= std::byte{1};
+    REQUIRE_FALSE(ChunkManifest::parse(data));
+    const std::string text = "not a manifest";
+    REQUIRE_FALSE(ChunkManifest::parse(std::as_bytes(std::span{text})));
+}
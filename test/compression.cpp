@@ -0,0 +1,96 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/compression.h"
+#include "FileStore/mapped_file.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace {
+
+std::string log_lines(size_t count) {
+    std::string text;
+    for (size_t i = 0; i < count; ++i)
+        text += "2024-09-26 12:00:" + std::to_string(i % 60) + " INFO request " + std::to_string(i) + " handled\n";
+    return text;
+}
+
+std::string random_bytes(size_t count) {
+    std::mt19937 rng{42};
+    std::string data(count, 0);
+    std::generate(data.begin(), data.end(), [&rng]() { return static_cast<char>(rng()); });
+    return data;
+}
+
+} // namespace
+
+TEST_CASE("compressed files", "[compression]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    if (!compression_available(Compression::deflate))
+        return; // built without zlib
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto write = [&](const std::string &name, const std::string &content) {
+        std::ofstream{temp.path() / name, std::ios_base::binary} << content;
+        return temp.path() / name;
+    };
+    const CompressionPolicy policy{.algorithm = Compression::deflate, .block_size = 16384};
+
+    const auto text = log_lines(5000);
+    const auto source = write("log.txt", text);
+    TempFile target{temp.path()};
+    REQUIRE(compress_file(source, target, policy));
+    target.close();
+    REQUIRE(fs::file_size(target.path()) * 3 < text.size());
+
+    const ContentReader reader{target.path()};
+    REQUIRE(reader.compressed());
+    REQUIRE(reader.size() == text.size());
+    REQUIRE(reader.equals(std::as_bytes(std::span{text})));
+    REQUIRE(reader.fingerprint() == fingerprint_file(source));
+    // files are compared as they are
+    REQUIRE_FALSE(files_are_equal(target.path(), source));
+
+    // random access across a block boundary
+    std::string part(100, 0);
+    REQUIRE(reader.read(16350, std::as_writable_bytes(std::span{part})) == part.size());
+    REQUIRE(part == text.substr(16350, 100));
+    REQUIRE(reader.read(text.size() - 10, std::as_writable_bytes(std::span{part})) == 10);
+
+    std::string streamed;
+    reader.for_each_block([&streamed](std::span<const std::byte> block) { streamed.append(reinterpret_cast<const char *>(block.data()), block.size()); });
+    REQUIRE(streamed == text);
+
+    // incompressible content is not compressed
+    TempFile random_target{temp.path()};
+    REQUIRE_FALSE(compress_file(write("random.bin", random_bytes(100000)), random_target, policy));
+
+    // content that looks compressed is always written in the block format
+    const auto looks_compressed = read_file(target.path());
+    const auto tricky = write("tricky.bin", std::string{looks_compressed.begin(), looks_compressed.end()});
+    TempFile tricky_target{temp.path()};
+    REQUIRE(compress_file(tricky, tricky_target, CompressionPolicy{}));
+    tricky_target.close();
+    REQUIRE(ContentReader{tricky_target.path()}.equals(std::as_bytes(std::span{looks_compressed})));
+    TempFile escaped_target{temp.path()};
+    REQUIRE(compress_file(source, escaped_target, CompressionPolicy{}, true));
+    escaped_target.close();
+    REQUIRE(ContentReader{escaped_target.path()}.equals(std::as_bytes(std::span{text})));
+    REQUIRE_FALSE(ContentReader{std::as_bytes(std::span{looks_compressed}), nullptr, false}.compressed());
+
+    // plain files are read as they are
+    const ContentReader plain{source};
+    REQUIRE_FALSE(plain.compressed());
+    REQUIRE(plain.size() == text.size());
+}
@@ -0,0 +1,23 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/crc32c.h"
+#include <string>
+
+TEST_CASE("crc32c checksums", "[crc32c]") {
+    using namespace filestore;
+
+    const auto crc = [](const std::string &str) { return crc32c(std::as_bytes(std::span(str.data(), str.size()))); };
+    REQUIRE(crc("") == 0);
+    REQUIRE(crc("123456789") == 0xe3069283);
+    REQUIRE(crc(std::string(32, '\0')) == 0x8a9136aa);
+
+    // continued checksums
+    const std::string data{"The quick brown fox jumps over the lazy dog"};
+    const auto bytes = std::as_bytes(std::span(data.data(), data.size()));
+    REQUIRE(crc32c(bytes.subspan(10), crc32c(bytes.first(10))) == crc(data));
+}
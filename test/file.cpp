@@ -6,6 +6,8 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "FileStore/file.h"
+#include "temp_fs.h"
+#include <algorithm>
 
 TEST_CASE("file size comparison", "[file]") {
     using namespace filestore;
@@ -24,3 +26,167 @@ TEST_CASE("file equality checks", "[file]") {
     REQUIRE_FALSE(files_are_equal(root / "file1.dat", root / "file3.dat"));
     REQUIRE_FALSE(files_are_equal(root / "file3.dat", root / "file4.dat"));
 }
+
+TEST_CASE("file equality of large files", "[file]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto write = [&temp](const std::string &name, const std::string &content) {
+        std::ofstream{temp.path() / name, std::ios_base::binary} << content;
+        return temp.path() / name;
+    };
+
+    REQUIRE(files_are_equal(write("empty1", ""), write("empty2", "")));
+
+    std::string content(5 * (1u << 20) + 123, '\0');
+    for (size_t i = 0; i < content.size(); ++i)
+        content[i] = static_cast<char>(i * 7 % 251);
+    const auto original = write("original", content);
+    REQUIRE(files_are_equal(original, write("copy", content)));
+
+    // differences between the sampled places, in the last partial block and in the first byte
+    for (const auto position : {size_t{1u << 20} + 17, content.size() - 1, size_t{0}}) {
+        auto changed = content;
+        changed[position] ^= 1;
+        REQUIRE_FALSE(files_are_equal(original, write("changed", changed)));
+    }
+}
+
+TEST_CASE("file fingerprints", "[file]") {
+    using namespace filestore;
+    std::filesystem::path root{"../../test/data"};
+
+    REQUIRE(fingerprint_file(root / "file1.dat") == fingerprint_file(root / "file2.dat"));
+    REQUIRE(fingerprint_file(root / "file1.dat").size == std::filesystem::file_size(root / "file1.dat"));
+    REQUIRE_FALSE(fingerprint_file(root / "file1.dat") == fingerprint_file(root / "file3.dat"));
+
+    // only the head and the tail are sampled
+    TempFS temp;
+    std::filesystem::create_directories(temp.path());
+    std::string content(3 * Fingerprint::sample_size, 'a');
+    std::ofstream{temp.path() / "a", std::ios_base::binary} << content;
+    content[Fingerprint::sample_size + 10] = 'b';
+    std::ofstream{temp.path() / "b", std::ios_base::binary} << content;
+    content.back() = 'c';
+    std::ofstream{temp.path() / "c", std::ios_base::binary} << content;
+    REQUIRE(fingerprint_file(temp.path() / "a") == fingerprint_file(temp.path() / "b"));
+    REQUIRE_FALSE(fingerprint_file(temp.path() / "a") == fingerprint_file(temp.path() / "c"));
+    REQUIRE_FALSE(files_are_equal(temp.path() / "a", temp.path() / "b"));
+}
+
+TEST_CASE("file transfer modes", "[file]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+
+    REQUIRE(transfer_file(root / "file1.dat", temp.path() / "copy", TransferMode::copy) == TransferMode::copy);
+    REQUIRE(files_are_equal(root / "file1.dat", temp.path() / "copy"));
+
+    const auto kernel_copy = transfer_file(root / "file3.dat", temp.path() / "kernel_copy", TransferMode::kernel_copy);
+    REQUIRE((kernel_copy == TransferMode::kernel_copy || kernel_copy == TransferMode::copy));
+    REQUIRE(files_are_equal(root / "file3.dat", temp.path() / "kernel_copy"));
+
+    const auto reflink = transfer_file(root / "file4.dat", temp.path() / "reflink", TransferMode::reflink);
+    REQUIRE(reflink <= TransferMode::reflink);
+    REQUIRE(files_are_equal(root / "file4.dat", temp.path() / "reflink"));
+
+    // the target must not exist
+    REQUIRE_THROWS(transfer_file(root / "file1.dat", temp.path() / "copy", TransferMode::copy));
+    REQUIRE_THROWS(transfer_file(root / "file1.dat", temp.path() / "copy", TransferMode::kernel_copy));
+    REQUIRE(files_are_equal(root / "file1.dat", temp.path() / "copy"));
+
+    const auto hardlink = transfer_file(temp.path() / "copy", temp.path() / "hardlink", TransferMode::hardlink);
+    REQUIRE(hardlink == TransferMode::hardlink);
+    REQUIRE(fs::hard_link_count(temp.path() / "copy") == 2);
+    REQUIRE(files_are_equal(root / "file1.dat", temp.path() / "hardlink"));
+
+    REQUIRE(transfer_file(temp.path() / "kernel_copy", temp.path() / "move", TransferMode::move) == TransferMode::move);
+    REQUIRE_FALSE(fs::exists(temp.path() / "kernel_copy"));
+    REQUIRE(files_are_equal(root / "file3.dat", temp.path() / "move"));
+}
+
+TEST_CASE("temporary files", "[file]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::path kept;
+    {
+        TempFile file{temp.path() / "tmp"};
+        file.write(std::span("Hello, World!", 13));
+        REQUIRE(fs::exists(file.path()));
+        file.commit(temp.path() / "a" / "hello.dat");
+    }
+    REQUIRE(files_are_equal(temp.path() / "a" / "hello.dat", "../../test/data/hello.dat"));
+
+    fs::path discarded;
+    {
+        TempFile file{temp.path() / "tmp"};
+        file.write(std::span("data", 4));
+        file.close();
+        discarded = file.path();
+        REQUIRE(fs::file_size(discarded) == 4);
+    }
+    REQUIRE_FALSE(fs::exists(discarded));
+    REQUIRE(fs::is_empty(temp.path() / "tmp"));
+}
+
+TEST_CASE("publishing files", "[file]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    fs::copy_file(root / "hello.dat", temp.path() / "hello");
+    fs::copy_file(root / "file1.dat", temp.path() / "other");
+    REQUIRE(publish_file(temp.path() / "hello", temp.path() / "a" / "hello.dat"));
+    REQUIRE_FALSE(fs::exists(temp.path() / "hello"));
+
+    // an existing target is kept, as is the source
+    REQUIRE_FALSE(publish_file(temp.path() / "other", temp.path() / "a" / "hello.dat"));
+    REQUIRE(fs::exists(temp.path() / "other"));
+    REQUIRE(files_are_equal(temp.path() / "a" / "hello.dat", root / "hello.dat"));
+
+    fs::path kept;
+    {
+        TempFile file{temp.path() / "tmp"};
+        file.write(std::span("data", 4));
+        REQUIRE_FALSE(file.try_commit(temp.path() / "a" / "hello.dat"));
+        kept = file.path();
+        REQUIRE(fs::exists(kept));
+        REQUIRE(file.try_commit(temp.path() / "a" / "data.dat"));
+    }
+    REQUIRE_FALSE(fs::exists(kept));
+    REQUIRE(fs::file_size(temp.path() / "a" / "data.dat") == 4);
+}
+
+TEST_CASE("listing files", "[file]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS temp;
+    fs::create_directories(temp.path() / "a" / "b");
+    fs::create_directories(temp.path() / "empty");
+    fs::copy_file(root / "hello.dat", temp.path() / "hello.dat");
+    fs::copy_file(root / "file1.dat", temp.path() / "a" / "file1.dat");
+    fs::copy_file(root / "file3.dat", temp.path() / "a" / "b" / "file3.dat");
+    fs::create_symlink(temp.path() / "hello.dat", temp.path() / "a" / "link.dat");
+    fs::create_directory_symlink(temp.path() / "a", temp.path() / "link");
+
+    auto files = list_files(temp.path());
+    std::ranges::sort(files, {}, &DirectoryFile::path);
+    REQUIRE(files.size() == 3);
+    REQUIRE(files[0].path == temp.path() / "a" / "b" / "file3.dat");
+    REQUIRE(files[1].path == temp.path() / "a" / "file1.dat");
+    REQUIRE(files[2].path == temp.path() / "hello.dat");
+    prefetch_file(files[0].path);
+
+    REQUIRE_THROWS_AS(list_files(temp.path() / "missing"), FileError);
+}
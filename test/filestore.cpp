@@ -5,41 +5,25 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include "FileStore/file.h"
 #include "FileStore/filestore.h"
+#include "FileStore/sha256_multi.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
 #include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
-std::string rand_string(size_t length) {
-    static constexpr auto num_chars = 63U;
-    static constexpr char chars[num_chars] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-
-    static constexpr auto rand_char = [&]() {
-        static std::default_random_engine rng(std::random_device{}());
-        static std::uniform_int_distribution<> dist(0, num_chars);
-        return chars[dist(rng)];
-    };
-
-    std::string str(length, 0);
-    std::generate_n(std::begin(str), length, rand_char);
-
-    return str;
-}
-
-class TempFS {
-public:
-    TempFS() {
-        m_path = std::filesystem::temp_directory_path() / rand_string(5);
-        while (std::filesystem::exists(m_path)) {
-            m_path = std::filesystem::temp_directory_path() / rand_string(5);
-        }
-    }
-    ~TempFS() { std::filesystem::remove_all(m_path); }
-
-    const std::filesystem::path &path() const { return m_path; }
-    operator std::filesystem::path &() { return m_path; }
-private:
-    std::filesystem::path m_path;
-};
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 filestore::Key gen_key(const std::string &hash, int distinguisher) {
     filestore::Key key{};
@@ -70,6 +54,25 @@ TEST_CASE("FileStore key generation", "[filestore]") {
     REQUIRE(to_string(k2) == "0cc8d7e70144753c7f1f1ba72687434595934a9dfc0932401fa3285e37eb2b6600000000");
 }
 
+TEST_CASE("FileStore batch key generation", "[filestore]") {
+    using namespace filestore;
+
+    std::filesystem::path root{"../../test/data"};
+    const std::vector<std::filesystem::path> files{root / "file1.dat", root / "hello.dat", root / "file3.dat", root / "file4.dat", root / "file2.dat"};
+
+    const auto initial = SHA256Multi::implementation();
+    for (const auto impl : {SHA256Multi::Implementation::sequential, SHA256Multi::Implementation::avx2, SHA256Multi::Implementation::avx512}) {
+        if (!SHA256Multi::use_implementation(impl))
+            continue;
+        const auto keys = generate_file_keys(files);
+        REQUIRE(keys.size() == files.size());
+        for (size_t i = 0; i < files.size(); ++i)
+            REQUIRE(keys[i] == generate_file_key(files[i]));
+        REQUIRE(generate_file_keys({}).empty());
+    }
+    SHA256Multi::use_implementation(initial);
+}
+
 TEST_CASE("FileStore key increment", "[filestore]") {
     using namespace filestore;
 
@@ -117,4 +120,882 @@ TEST_CASE("FileStore import test", "[filestore]") {
     REQUIRE(k3.has_value());
     REQUIRE(to_string(k3.value()) == "0cc8d7e70144753c7f1f1ba72687434595934a9dfc0932401fa3285e37eb2b6600000000");
     REQUIRE(fs::exists(store.get_file_path(k3.value())));
+    REQUIRE(files_are_equal(store.get_file_path(k3.value()), root / "file3.dat"));
+
+    // no temporary files are left behind, even for duplicates
+    REQUIRE(fs::is_empty(fs1.path() / ".filestore" / "tmp"));
+}
+
+TEST_CASE("FileStore metrics", "[filestore][metrics]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS fs1;
+    FileStore store(fs1);
+    // another content under the key of file1.dat, so it gets the next distinguisher
+    const auto key = generate_file_key(root / "file1.dat");
+    fs::create_directories(store.get_file_path(key).parent_path());
+    std::ofstream{store.get_file_path(key)} << "other content";
+
+    const auto size = fs::file_size(root / "file1.dat");
+    REQUIRE(store.import(root / "file1.dat").has_value());
+    REQUIRE_FALSE(store.import(root / "file2.dat").has_value());
+
+    const auto metrics = store.metrics();
+    if constexpr (metrics_enabled) {
+        REQUIRE(metrics.bytes_hashed == 2 * size);
+        REQUIRE(metrics.hash_time.count == 2);
+        REQUIRE(metrics.bytes_stored == size);
+        REQUIRE(metrics.copy_time.count == 2);
+        // the first import skips the other content, the second one finds file1.dat after it
+        REQUIRE(metrics.distinguisher_steps.count == 2);
+        REQUIRE(metrics.distinguisher_steps.sum == 2);
+        REQUIRE(metrics.compare_time.count == 3);
+        REQUIRE(metrics.key_probes >= 4);
+    } else {
+        REQUIRE(metrics.key_probes == 0);
+    }
+    REQUIRE(metrics.to_json() == FileStore{store}.metrics().to_json());
+}
+
+TEST_CASE("FileStore parallel import", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    const std::vector<fs::path> files{root / "file1.dat", root / "file3.dat", root / "file2.dat", root / "hello.dat", root / "file4.dat"};
+
+    TempFS fs1;
+    FileStore store(fs1);
+    const auto results = store.import_many(files, ImportOptions{.threads = 3});
+    REQUIRE(results.size() == files.size());
+
+    // one of the equal files is stored, the other one reported as duplicate
+    REQUIRE(results[0].has_value() != results[2].has_value());
+    const auto k1 = results[0].has_value() ? results[0].value() : results[0].error();
+    const auto k2 = results[2].has_value() ? results[2].value() : results[2].error();
+    REQUIRE(k1 == k2);
+    REQUIRE(to_string(k1) == "d5d845d8fd337e1635c929f7205c1bc93ce95bbdd44a23b17b2790c7532d12f100000000");
+
+    for (const auto i : {1, 3, 4}) {
+        REQUIRE(results[i].has_value());
+        REQUIRE(results[i].value() == generate_file_key(files[i]));
+        REQUIRE(fs::exists(store.get_file_path(results[i].value())));
+    }
+
+    // everything is known now
+    const std::vector<std::string> names{(root / "file4.dat").string(), (root / "file1.dat").string()};
+    const auto again = store.import_many(names);
+    REQUIRE_FALSE(again[0].has_value());
+    REQUIRE_FALSE(again[1].has_value());
+    REQUIRE(again[1].error() == k1);
+
+    const std::vector<fs::path> missing{root / "file1.dat", root / "does_not_exist.dat"};
+    REQUIRE_THROWS_AS(store.import_many(missing), FileError);
+
+    // on a pool, that is busy with other work: only the imports are waited for, the other failures are not theirs
+    TempFS fs2;
+    FileStore shared_store(fs2);
+    ThreadPool pool{2};
+    std::promise<void> release;
+    pool.submit([blocked = release.get_future().share()]() { blocked.wait(); });
+    pool.submit([]() { throw std::runtime_error("other task failed"); });
+    const auto shared = shared_store.import_many(files, ImportOptions{.pool = &pool});
+    REQUIRE(std::ranges::count_if(shared, [](const auto &result) { return result.has_value(); }) == 4);
+    // and from a task of the pool
+    std::vector<std::expected<Key, Key>> nested;
+    pool.submit([&]() { nested = shared_store.import_many(files, ImportOptions{.pool = &pool}); });
+    release.set_value();
+    REQUIRE_THROWS_AS(pool.wait(), std::runtime_error);
+    REQUIRE(std::ranges::none_of(nested, [](const auto &result) { return result.has_value(); }));
+}
+
+TEST_CASE("FileStore concurrent stores", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    // stores on the same root share no locks, as those in other processes would
+    TempFS fs1;
+    const std::vector<fs::path> files{root / "file1.dat", root / "file2.dat", root / "file3.dat"};
+    std::vector<std::vector<FileStore::import_result>> results(4);
+    {
+        std::vector<std::thread> threads;
+        for (auto &result : results) {
+            threads.emplace_back([&]() {
+                FileStore store(fs1);
+                for (const auto &file : files)
+                    result.push_back(store.import(file));
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    const auto key_of = [](const FileStore::import_result &result) { return result ? result.value() : result.error(); };
+    const auto k1 = key_of(results[0][0]);
+    const auto k3 = key_of(results[0][2]);
+    size_t added = 0;
+    for (const auto &result : results) {
+        REQUIRE(key_of(result[0]) == k1);
+        REQUIRE(key_of(result[1]) == k1);
+        REQUIRE(key_of(result[2]) == k3);
+        added += std::ranges::count_if(result, [](const auto &r) { return r.has_value(); });
+    }
+    REQUIRE(added == 2);
+    REQUIRE(to_string(k1) == "d5d845d8fd337e1635c929f7205c1bc93ce95bbdd44a23b17b2790c7532d12f100000000");
+
+    FileStore store(fs1);
+    REQUIRE(store.verify(k1));
+    REQUIRE(store.verify(k3));
+    REQUIRE(fs::is_empty(fs1.path() / ".filestore" / "tmp"));
+
+    // a key index misses the objects another store on the root publishes
+    TempFS fs2;
+    FileStore indexed(fs2, StoreOptions{.key_index = true});
+    REQUIRE(indexed.import(root / "file3.dat").value() == k3);
+    FileStore other(fs2);
+    REQUIRE(other.import(root / "file1.dat").value() == k1);
+    REQUIRE(indexed.import(root / "file1.dat").error() == k1);
+    REQUIRE(indexed.import(root / "file2.dat").error() == k1);
+
+    // another content under the key, as with a hash collision, moves the content to the next distinguisher
+    const auto k4 = generate_file_key(root / "file4.dat");
+    fs::create_directories(indexed.get_file_path(k4).parent_path());
+    fs::copy_file(root / "hello.dat", indexed.get_file_path(k4));
+    auto next = k4;
+    next.increment();
+    REQUIRE(indexed.import(root / "file4.dat").value() == next);
+    REQUIRE(other.import(root / "file4.dat").error() == next);
+    REQUIRE(indexed.verify(next));
+}
+
+TEST_CASE("FileStore tree import", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS tree;
+    fs::create_directories(tree.path() / "a" / "b");
+    fs::copy_file(root / "file1.dat", tree.path() / "file1.dat");
+    fs::copy_file(root / "file2.dat", tree.path() / "a" / "file2.dat");
+    fs::copy_file(root / "file3.dat", tree.path() / "a" / "b" / "file3.dat");
+    fs::copy_file(root / "hello.dat", tree.path() / "a" / "b" / "hello.dat");
+
+    // the store is inside the tree, its objects are not imported again
+    FileStore store(tree.path() / "store");
+    const auto hello = store.import(root / "hello.dat").value();
+    const auto report = store.import_tree(tree.path(), TreeImportOptions{.threads = 2, .read_ahead = 2});
+    REQUIRE(report.failed.empty());
+    REQUIRE(report.added.size() == 2);
+    REQUIRE(report.duplicates.size() == 2);
+    for (const auto &entry : report.added)
+        REQUIRE(entry.key == generate_file_key(entry.path));
+    const auto hello_entry = std::ranges::find(report.duplicates, tree.path() / "a" / "b" / "hello.dat", &TreeImportEntry::path);
+    REQUIRE(hello_entry != report.duplicates.end());
+    REQUIRE(hello_entry->key == hello);
+    REQUIRE(store.object_count() == 3);
+
+    REQUIRE_THROWS_AS(store.import_tree(tree.path() / "missing"), FileError);
+}
+
+TEST_CASE("FileStore tree import order", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS tree;
+    fs::create_directories(tree.path() / "files");
+    for (int i = 0; i < 30; ++i)
+        std::ofstream{tree.path() / "files" / ("file" + std::to_string(i))} << "content " << i;
+    std::map<fs::path, std::uint64_t> inodes;
+    for (const auto &file : list_files(tree.path() / "files"))
+        inodes[file.path] = file.inode;
+
+    // the catalog lists the objects in the order they were stored
+    TempFS fs1;
+    FileStore store(fs1, StoreOptions{.catalog = true});
+    ThreadPool pool{1};
+    const auto report = store.import_tree(tree.path() / "files", TreeImportOptions{.pool = &pool, .read_ahead = 4});
+    REQUIRE(report.added.size() == 30);
+    std::unordered_map<Key, std::uint64_t, KeyHash> key_inodes;
+    for (const auto &entry : report.added)
+        key_inodes[entry.key] = inodes.at(entry.path);
+    std::vector<std::uint64_t> stored;
+    store.for_each_object([&](const CatalogEntry &entry) { stored.push_back(key_inodes.at(entry.key)); });
+    REQUIRE(stored.size() == 30);
+    REQUIRE(std::ranges::is_sorted(stored));
+}
+
+TEST_CASE("FileStore adaptive sharding", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS fs1;
+    std::vector<std::vector<std::byte>> contents;
+    std::vector<Key> keys;
+    {
+        FileStore store(fs1, StoreOptions{.folder_levels = 0, .shard_split_threshold = 4});
+        for (int i = 0; i < 40; ++i) {
+            const auto text = "object " + std::to_string(i);
+            contents.emplace_back(std::as_bytes(std::span{text}).begin(), std::as_bytes(std::span{text}).end());
+            keys.push_back(store.import(std::span{contents.back()}).value());
+        }
+        // the root holds no objects any more, each one is in a directory of at most the threshold
+        for (const auto &key : keys) {
+            const auto path = store.get_file_path(key);
+            REQUIRE(fs::exists(path));
+            REQUIRE(path.parent_path() != fs1.path());
+            REQUIRE(std::distance(fs::directory_iterator{path.parent_path()}, fs::directory_iterator{}) <= 4);
+        }
+        REQUIRE(store.object_count() == keys.size());
+    }
+
+    // reopened with the recorded layout
+    FileStore store(fs1);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(std::ranges::equal(store.open(keys[i]).data(), contents[i]));
+        REQUIRE_FALSE(store.import(std::span{contents[i]}).has_value());
+    }
+    const auto report = store.scrub();
+    REQUIRE(report.objects == keys.size());
+    REQUIRE(report.mismatches.empty());
+    REQUIRE(report.orphans.empty());
+
+    // a store with fixed folder levels is converted, and its full directories are split by reshard
+    TempFS fs2;
+    {
+        FileStore fixed(fs2, 1);
+        for (const auto &content : contents)
+            fixed.import(std::span{content});
+    }
+    FileStore converted(fs2, StoreOptions{.folder_levels = 1, .shard_split_threshold = 1});
+    REQUIRE(converted.object_count() == keys.size());
+    converted.reshard();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(fs::exists(converted.get_file_path(keys[i])));
+        REQUIRE(std::distance(fs::directory_iterator{converted.get_file_path(keys[i]).parent_path()}, fs::directory_iterator{}) == 1);
+        REQUIRE(std::ranges::equal(converted.open(keys[i]).data(), contents[i]));
+    }
+    REQUIRE(converted.object_count() == keys.size());
+
+    // directories are split while other threads import into them
+    TempFS fs3;
+    FileStore parallel(fs3, StoreOptions{.folder_levels = 0, .shard_split_threshold = 2});
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                for (size_t i = t; i < contents.size(); i += 4)
+                    parallel.import(std::span{contents[i]});
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+    }
+    for (size_t i = 0; i < keys.size(); ++i)
+        REQUIRE(std::ranges::equal(parallel.open(keys[i]).data(), contents[i]));
+    REQUIRE(parallel.object_count() == keys.size());
+
+    TempFS fs4;
+    REQUIRE_THROWS_AS(FileStore(fs4, StoreOptions{.folder_levels = 3, .shard_split_threshold = 1}), std::invalid_argument);
+}
+
+TEST_CASE("FileStore import modes", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS source;
+    fs::create_directories(source.path());
+    fs::copy_file(root / "file1.dat", source.path() / "file1.dat");
+    fs::copy_file(root / "file3.dat", source.path() / "file3.dat");
+    fs::copy_file(root / "file2.dat", source.path() / "file2.dat");
+
+    TempFS fs1;
+    FileStore store(fs1, StoreOptions{.import_mode = TransferMode::hardlink});
+    const auto k1 = store.import(source.path() / "file1.dat");
+    REQUIRE(k1.has_value());
+    REQUIRE(fs::hard_link_count(source.path() / "file1.dat") == 2);
+
+    TempFS fs2;
+    FileStore moving_store(fs2, StoreOptions{.import_mode = TransferMode::move});
+    const auto k3 = moving_store.import(source.path() / "file3.dat");
+    REQUIRE(k3.has_value());
+    REQUIRE_FALSE(fs::exists(source.path() / "file3.dat"));
+    REQUIRE(files_are_equal(root / "file3.dat", moving_store.get_file_path(k3.value())));
+
+    // duplicates stay where they are
+    REQUIRE(moving_store.import(source.path() / "file1.dat").has_value());
+    const auto k2 = moving_store.import(source.path() / "file2.dat");
+    REQUIRE_FALSE(k2.has_value());
+    REQUIRE(fs::exists(source.path() / "file2.dat"));
+}
+
+TEST_CASE("FileStore source cache", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS source;
+    fs::create_directories(source.path());
+    const std::vector<fs::path> files{source.path() / "file1.dat", source.path() / "file3.dat", source.path() / "file4.dat"};
+    fs::copy_file(root / "file1.dat", files[0]);
+    fs::copy_file(root / "file3.dat", files[1]);
+    fs::copy_file(root / "file4.dat", files[2]);
+
+    TempFS fs1;
+    std::vector<FileStore::import_result> first;
+    {
+        FileStore store(fs1, StoreOptions{.trust_source_cache = true});
+        first = store.import_many(files);
+        REQUIRE(std::ranges::all_of(first, [](const auto &result) { return result.has_value(); }));
+    }
+    REQUIRE(fs::exists(fs1.path() / ".filestore" / "sources"));
+
+    // unchanged sources are known without reading them
+    FileStore store(fs1, StoreOptions{.trust_source_cache = true});
+    const auto second = store.import_many(files);
+    REQUIRE(second.size() == files.size());
+    for (size_t i = 0; i < files.size(); ++i)
+        REQUIRE(second[i].error() == first[i].value());
+
+    // changed sources are imported again
+    std::ofstream{files[1], std::ios_base::app} << "changed";
+    const auto changed = store.import(files[1]);
+    REQUIRE(changed.has_value());
+    REQUIRE(changed.value() == generate_file_key(files[1]));
+    REQUIRE_FALSE(store.import(files[1]).has_value());
+}
+
+TEST_CASE("FileStore asynchronous import", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    const std::vector<fs::path> files{root / "file1.dat", root / "file2.dat", root / "file3.dat", root / "file4.dat"};
+    for (const auto mode : {TransferMode::copy, TransferMode::hardlink}) {
+        TempFS fs1;
+        FileStore store(fs1, StoreOptions{.import_mode = mode, .io_queue_depth = 2});
+        std::vector<std::future<FileStore::import_result>> results;
+        for (const auto &file : files)
+            results.push_back(store.import_async(file));
+
+        std::vector<FileStore::import_result> imported;
+        for (auto &result : results)
+            imported.push_back(result.get());
+        REQUIRE(imported[0].has_value() != imported[1].has_value()); // same content
+        REQUIRE(imported[2].has_value());
+        REQUIRE(imported[3].has_value());
+        for (size_t i = 0; i < files.size(); ++i) {
+            const auto key = imported[i].has_value() ? imported[i].value() : imported[i].error();
+            REQUIRE(key == generate_file_key(files[i]));
+            REQUIRE(store.read_async(key).get() == read_file(files[i]));
+        }
+        REQUIRE_FALSE(store.import_async(files[2]).get().has_value());
+        REQUIRE_THROWS_AS(store.import_async(root / "missing.dat").get(), FileError);
+        REQUIRE_THROWS_AS(store.read_async(Key{}).get(), FileError);
+    }
+
+    AsyncIo io;
+    REQUIRE(generate_file_key_async(io, files[2]).get() == generate_file_key(files[2]));
+}
+
+TEST_CASE("FileStore import from memory and streams", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    const auto content1 = read_file(root / "file1.dat");
+    const auto content3 = read_file(root / "file3.dat");
+    const auto bytes = [](const std::vector<char> &content) { return std::as_bytes(std::span{content}); };
+
+    REQUIRE(generate_key(bytes(content1)) == generate_file_key(root / "file1.dat"));
+    std::istringstream stream3{std::string{content3.begin(), content3.end()}};
+    REQUIRE(generate_key(stream3) == generate_file_key(root / "file3.dat"));
+
+    TempFS fs1;
+    FileStore store(fs1);
+    const auto k1 = store.import(bytes(content1));
+    REQUIRE(k1.has_value());
+    REQUIRE(k1.value() == generate_file_key(root / "file1.dat"));
+    REQUIRE(read_file(store.get_file_path(k1.value())) == content1);
+    REQUIRE_FALSE(store.import(root / "file2.dat").has_value());
+
+    std::istringstream input3{std::string{content3.begin(), content3.end()}};
+    const auto k3 = store.import(input3);
+    REQUIRE(k3.has_value());
+    REQUIRE(k3.value() == generate_file_key(root / "file3.dat"));
+    std::ifstream input1{root / "file1.dat", std::ios_base::binary};
+    REQUIRE(store.import(input1).error() == k1.value());
+
+    const auto empty = store.import(std::span<const std::byte>{});
+    REQUIRE(empty.has_value());
+    REQUIRE(fs::file_size(store.get_file_path(empty.value())) == 0);
+
+#if !defined(_WIN32)
+    const int fd = ::open((root / "file4.dat").c_str(), O_RDONLY | O_CLOEXEC);
+    REQUIRE(fd >= 0);
+    const auto k4 = store.import_fd(fd);
+    ::close(fd);
+    REQUIRE(k4.has_value());
+    REQUIRE(k4.value() == generate_file_key(root / "file4.dat"));
+
+    int pipe_fds[2];
+    REQUIRE(::pipe(pipe_fds) == 0);
+    std::thread writer{[&]() { // the content does not fit into the pipe buffer
+        for (size_t written = 0; written < content3.size();) {
+            const auto result = ::write(pipe_fds[1], content3.data() + written, content3.size() - written);
+            if (result <= 0)
+                break;
+            written += static_cast<size_t>(result);
+        }
+        ::close(pipe_fds[1]);
+    }};
+    const auto piped = store.import_fd(pipe_fds[0]);
+    writer.join();
+    ::close(pipe_fds[0]);
+    REQUIRE(piped.error() == k3.value());
+#endif
+}
+
+TEST_CASE("FileStore mapped objects", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    for (const size_t cache_size : {0, 1}) {
+        TempFS fs1;
+        FileStore store(fs1, StoreOptions{.mapping_cache_size = cache_size});
+        const auto k1 = store.import(root / "file1.dat").value();
+        const auto k3 = store.import(root / "file3.dat").value();
+
+        const auto content1 = read_file(root / "file1.dat");
+        const auto view1 = store.open(k1, AccessPattern::sequential);
+        REQUIRE(view1.size() == content1.size());
+        REQUIRE(std::ranges::equal(std::as_bytes(std::span{content1}), view1.data()));
+        REQUIRE((store.open(k1).data().data() == view1.data().data()) == (cache_size > 0));
+
+        // views stay valid, when the cache drops them
+        const auto view3 = store.open(k3, AccessPattern::random);
+        REQUIRE(view3.size() == fs::file_size(root / "file3.dat"));
+        REQUIRE(std::ranges::equal(std::as_bytes(std::span{content1}), view1.data()));
+
+        REQUIRE_THROWS_AS(store.open(Key{}), FileError);
+    }
+}
+
+TEST_CASE("FileStore pack files", "[filestore][pack]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    const auto has_content = [](const FileStore &store, const Key &k, const fs::path &file_path) {
+        const auto content = read_file(file_path);
+        return std::ranges::equal(std::as_bytes(std::span{content}), store.open(k).data()) && store.read_async(k).get() == content;
+    };
+
+    TempFS fs1;
+    Key k1, k3, hello;
+    {
+        // files of their own for the objects imported before packing is enabled
+        FileStore store(fs1);
+        k3 = store.import(root / "file3.dat").value();
+    }
+    {
+        FileStore store(fs1, StoreOptions{.catalog = true, .pack_threshold = 100000});
+        k1 = store.import(root / "file1.dat").value();
+        const auto hello_content = read_file(root / "hello.dat");
+        hello = store.import(std::as_bytes(std::span{hello_content})).value();
+        REQUIRE_FALSE(store.is_packed(k1));
+        REQUIRE(store.is_packed(hello));
+        REQUIRE_FALSE(store.is_packed(k3));
+        REQUIRE_FALSE(fs::exists(store.get_file_path(hello)));
+        REQUIRE(has_content(store, hello, root / "hello.dat"));
+        REQUIRE_FALSE(store.import(root / "hello.dat").has_value());
+        REQUIRE(store.is_packed(store.import(root / "file4.dat").value()));
+        REQUIRE(store.object_count() == 4);
+
+        store.repack();
+        REQUIRE(store.is_packed(k3));
+        REQUIRE_FALSE(fs::exists(store.get_file_path(k3)));
+        REQUIRE(has_content(store, k3, root / "file3.dat"));
+        REQUIRE_FALSE(store.import(root / "file3.dat").has_value());
+    }
+    {
+        // packs are read without a threshold, the objects are listed when walking the directories
+        FileStore store(fs1, StoreOptions{.key_index = true});
+        REQUIRE(store.object_count() == 4);
+        REQUIRE(store.is_packed(k3));
+        REQUIRE(has_content(store, k3, root / "file3.dat"));
+        REQUIRE(has_content(store, k1, root / "file1.dat"));
+        REQUIRE_FALSE(store.import(root / "file3.dat").has_value());
+    }
+
+    // a moved source is gone, also when it was copied into a pack
+    TempFS source;
+    fs::create_directories(source.path());
+    fs::copy_file(root / "file3.dat", source.path() / "file3.dat");
+    TempFS fs2;
+    FileStore moving_store(fs2, StoreOptions{.import_mode = TransferMode::move, .pack_threshold = 100000});
+    REQUIRE(moving_store.import(source.path() / "file3.dat").value() == k3);
+    REQUIRE_FALSE(fs::exists(source.path() / "file3.dat"));
+    REQUIRE(has_content(moving_store, k3, root / "file3.dat"));
+}
+
+TEST_CASE("FileStore compression", "[filestore][compression]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    if (!compression_available(Compression::deflate))
+        return; // built without zlib
+
+    TempFS source;
+    fs::create_directories(source.path());
+    std::string text;
+    for (int i = 0; i < 20000; ++i)
+        text += "line " + std::to_string(i) + " of a highly compressible log\n";
+    const auto text_path = source.path() / "log.txt";
+    std::ofstream{text_path, std::ios_base::binary} << text;
+    const auto content = std::as_bytes(std::span{text});
+
+    TempFS fs1;
+    Key key;
+    {
+        FileStore store(fs1, StoreOptions{.catalog = true, .compression = {.algorithm = Compression::deflate}});
+        key = store.import(text_path).value();
+        REQUIRE(key == generate_file_key(text_path));
+        REQUIRE(fs::file_size(store.get_file_path(key)) * 3 < text.size());
+        REQUIRE_FALSE(store.import(text_path).has_value());
+        REQUIRE_FALSE(store.import(content).has_value());
+
+        REQUIRE(std::ranges::equal(store.open(key).data(), content));
+        const auto read = store.read_async(key).get();
+        REQUIRE(std::string{read.begin(), read.end()} == text);
+        std::string part(20, 0);
+        REQUIRE(store.read(key).read(text.size() - 20, std::as_writable_bytes(std::span{part})) == 20);
+        REQUIRE(part == text.substr(text.size() - 20));
+
+        std::vector<CatalogEntry> entries;
+        store.for_each_object([&entries](const CatalogEntry &entry) { entries.push_back(entry); });
+        REQUIRE(entries.size() == 1);
+        REQUIRE(entries[0].size == text.size());
+        REQUIRE(entries[0].fingerprint() == fingerprint_file(text_path));
+    }
+
+    // a store opened without a policy still reads the compressed objects
+    FileStore store(fs1);
+    std::vector<CatalogEntry> entries;
+    store.for_each_object([&entries](const CatalogEntry &entry) { entries.push_back(entry); });
+    REQUIRE(entries.size() == 1);
+    REQUIRE(entries[0].size == text.size());
+    REQUIRE(std::ranges::equal(store.open(key).data(), content));
+    REQUIRE_FALSE(store.import(text_path).has_value());
+
+    // a file in the block format is escaped in a plain store, so it is read as it is
+    const auto compressed_path = store.get_file_path(key);
+    const MappedFile compressed{compressed_path};
+    TempFS fs2;
+    {
+        FileStore plain(fs2);
+        const auto escaped = plain.import(compressed_path).value();
+        REQUIRE(fs::file_size(plain.get_file_path(escaped)) > compressed.size());
+        REQUIRE(std::ranges::equal(plain.open(escaped).data(), compressed.data()));
+        REQUIRE(std::ranges::equal(plain.read(escaped).read_all(), compressed.data()));
+        const auto read = plain.read_async(escaped).get();
+        REQUIRE(std::ranges::equal(std::as_bytes(std::span{read}), compressed.data()));
+        REQUIRE(plain.verify(escaped));
+        REQUIRE_FALSE(plain.import(compressed_path).has_value());
+        REQUIRE_FALSE(plain.import(compressed.data()).has_value());
+    }
+    FileStore reopened(fs2);
+    REQUIRE(reopened.verify(generate_file_key(compressed_path)));
+
+    // plain stores do not look for the format in packed objects
+    TempFS fs3;
+    FileStore packed(fs3, StoreOptions{.pack_threshold = 1U << 20});
+    const auto packed_key = packed.import(compressed_path).value();
+    REQUIRE(packed.is_packed(packed_key));
+    REQUIRE(std::ranges::equal(packed.read(packed_key).read_all(), compressed.data()));
+    REQUIRE(packed.verify(packed_key));
+}
+
+TEST_CASE("FileStore chunked objects", "[filestore][chunking]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    std::mt19937 rng{7};
+    std::string version1(1U << 20, 0);
+    std::generate(version1.begin(), version1.end(), [&rng]() { return static_cast<char>(rng()); });
+    auto version2 = version1;
+    version2.insert(300000, "a few changed bytes");
+
+    TempFS source;
+    fs::create_directories(source.path());
+    std::ofstream{source.path() / "v1.bin", std::ios_base::binary} << version1;
+    std::ofstream{source.path() / "v2.bin", std::ios_base::binary} << version2;
+
+    const auto stored_size = [](const fs::path &path) {
+        std::uintmax_t size = 0;
+        for (const auto &entry : fs::recursive_directory_iterator{path})
+            if (entry.is_regular_file())
+                size += entry.file_size();
+        return size;
+    };
+
+    TempFS fs1;
+    const StoreOptions options{.catalog = true,
+                               .chunking = {.min_file_size = 65536, .min_chunk_size = 4096, .average_chunk_size = 16384, .max_chunk_size = 65536}};
+    Key k1, k2;
+    {
+        FileStore store(fs1, options);
+        k1 = store.import(source.path() / "v1.bin").value();
+        k2 = store.import(source.path() / "v2.bin").value();
+        REQUIRE(k1 == generate_file_key(source.path() / "v1.bin"));
+        REQUIRE(k2 == generate_file_key(source.path() / "v2.bin"));
+        REQUIRE(stored_size(fs1.path()) < version1.size() * 5 / 4);
+        REQUIRE_FALSE(store.import(source.path() / "v2.bin").has_value());
+        REQUIRE_FALSE(store.import(std::as_bytes(std::span{version1})).has_value());
+        REQUIRE(store.object_count() == 2);
+
+        REQUIRE(std::ranges::equal(store.open(k2).data(), std::as_bytes(std::span{version2})));
+        const auto read = store.read_async(k1).get();
+        REQUIRE(std::string{read.begin(), read.end()} == version1);
+        std::string streamed;
+        store.read_stream(k2, [&streamed](std::span<const std::byte> data) { streamed.append(reinterpret_cast<const char *>(data.data()), data.size()); });
+        REQUIRE(streamed == version2);
+    }
+
+    // the sizes of the contents are listed, also when walking the directories
+    FileStore store(fs1);
+    std::vector<CatalogEntry> entries;
+    store.for_each_object([&entries](const CatalogEntry &entry) { entries.push_back(entry); });
+    REQUIRE(entries.size() == 2);
+    REQUIRE(entries[0].size + entries[1].size == version1.size() + version2.size());
+    REQUIRE(std::ranges::equal(store.open(k1).data(), std::as_bytes(std::span{version1})));
+
+    // a file, that is a valid manifest, is stored as it is and not taken for the chunks it names
+    const auto manifest_path = source.path() / "manifest.bin";
+    fs::copy_file(store.get_file_path(k1), manifest_path);
+    const MappedFile manifest{manifest_path};
+    REQUIRE(ChunkManifest::parse(manifest.data()));
+    const auto manifest_key = store.import(manifest_path).value();
+    REQUIRE(std::ranges::equal(store.open(manifest_key).data(), manifest.data()));
+    REQUIRE(std::ranges::equal(store.read(manifest_key).read_all(), manifest.data()));
+    REQUIRE(store.verify(manifest_key));
+    REQUIRE_FALSE(store.import(manifest.data()).has_value());
+
+    // stores without chunks do not look for manifests
+    TempFS fs2;
+    FileStore plain(fs2);
+    const auto plain_key = plain.import(manifest_path).value();
+    REQUIRE(plain_key == manifest_key);
+    REQUIRE(std::ranges::equal(plain.open(plain_key).data(), manifest.data()));
+    REQUIRE(plain.verify(plain_key));
+}
+
+TEST_CASE("FileStore garbage collection", "[filestore][gc]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    std::mt19937 rng{11};
+    std::string version1(1U << 20, 0);
+    std::generate(version1.begin(), version1.end(), [&rng]() { return static_cast<char>(rng()); });
+    auto version2 = version1;
+    version2.insert(500000, "a few changed bytes");
+
+    TempFS fs1;
+    const StoreOptions options{.catalog = true,
+                               .pack_threshold = 16,
+                               .chunking = {.min_file_size = 65536, .min_chunk_size = 4096, .average_chunk_size = 16384, .max_chunk_size = 65536}};
+    FileStore store(fs1, options);
+    std::vector<std::string> contents;
+    std::vector<Key> keys;
+    for (int i = 0; i < 41; ++i) {
+        // short ones are packed, long ones get files of their own
+        contents.push_back(i % 2 == 0 ? "p" + std::to_string(i) : "a longer object with a file " + std::to_string(i));
+        keys.push_back(store.import(std::as_bytes(std::span{contents.back()})).value());
+    }
+    contents.push_back(version1);
+    keys.push_back(store.import(std::as_bytes(std::span{version1})).value());
+    contents.push_back(version2);
+    keys.push_back(store.import(std::as_bytes(std::span{version2})).value());
+    REQUIRE(store.is_packed(keys[0]));
+    REQUIRE_FALSE(store.is_packed(keys[1]));
+
+    // every third object is kept, the last one of them is version2, which shares most chunks with version1
+    std::vector<Key> roots;
+    for (size_t i = 0; i < keys.size(); i += 3)
+        roots.push_back(keys[i]);
+    REQUIRE(roots.back() == keys.back());
+    const auto report = store.collect_garbage(roots, GcOptions{.threads = 2, .batch_size = 4});
+    REQUIRE(report.objects_kept == roots.size());
+    REQUIRE(report.objects_removed == keys.size() - roots.size());
+    REQUIRE(report.chunks_removed > 0);
+    REQUIRE(report.directories_removed > 0);
+    REQUIRE(store.object_count() == roots.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 3 == 0)
+            REQUIRE(std::ranges::equal(store.open(keys[i]).data(), std::as_bytes(std::span{contents[i]})));
+        else
+            REQUIRE_THROWS(store.open(keys[i]));
+    }
+    // removed objects are added again
+    REQUIRE(store.import(std::as_bytes(std::span{contents[1]})).value() == keys[1]);
+    REQUIRE(std::ranges::equal(store.open(keys[1]).data(), std::as_bytes(std::span{contents[1]})));
+    REQUIRE(store.scrub().mismatches.empty());
+
+    // the directories left are those with objects
+    roots.push_back(keys[1]);
+    REQUIRE(store.remove(roots) == roots.size());
+    REQUIRE(store.object_count() == 0);
+    for (const auto &entry : fs::directory_iterator{fs1.path()})
+        REQUIRE(entry.path().filename() == ".filestore");
+    REQUIRE(store.collect_garbage({}).chunks_removed > 0);
+    REQUIRE(store.remove(roots) == 0);
+}
+
+TEST_CASE("FileStore scrub", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS fs1;
+    FileStore store(fs1, StoreOptions{.pack_threshold = 100});
+    const auto k1 = store.import(root / "file1.dat").value();
+    const auto k3 = store.import(root / "file3.dat").value();
+    const auto hello = store.import(root / "hello.dat").value();
+    REQUIRE(store.is_packed(hello));
+    const auto total_size = fs::file_size(root / "file1.dat") + fs::file_size(root / "file3.dat") + fs::file_size(root / "hello.dat");
+
+    auto report = store.scrub();
+    REQUIRE(report.complete);
+    REQUIRE(report.objects == 3);
+    REQUIRE(report.bytes == total_size);
+    REQUIRE(report.mismatches.empty());
+    REQUIRE(report.orphans.empty());
+
+    // a damaged object and files that belong to no object
+    {
+        std::fstream object{store.get_file_path(k3), std::ios_base::in | std::ios_base::out | std::ios_base::binary};
+        object.seekp(1000);
+        object.put('x');
+    }
+    std::ofstream{fs1.path() / "stray.txt"} << "stray";
+    std::ofstream{store.get_file_path(k1).parent_path() / "not_a_key"} << "stray";
+    report = store.scrub(ScrubOptions{.threads = 2});
+    REQUIRE(report.complete);
+    REQUIRE(report.objects == 3);
+    REQUIRE(report.mismatches == std::vector<Key>{k3});
+    REQUIRE(report.orphans.size() == 2);
+    REQUIRE(store.verify(k1));
+    REQUIRE_FALSE(store.verify(k3));
+
+    // stopped before the first object, then continued after the first key
+    const auto checkpoint = fs1.path() / "scrub.checkpoint";
+    report = store.scrub(ScrubOptions{.checkpoint_path = checkpoint, .stop = []() { return true; }});
+    REQUIRE_FALSE(report.complete);
+    REQUIRE(report.objects == 0);
+    auto keys = std::vector{k1, k3, hello};
+    std::ranges::sort(keys, {}, &Key::data);
+    std::ofstream{checkpoint} << to_string(keys[0]) << '\n';
+    report = store.scrub(ScrubOptions{.checkpoint_path = checkpoint});
+    REQUIRE(report.complete);
+    REQUIRE(report.objects == 2);
+    REQUIRE_FALSE(fs::exists(checkpoint));
+
+    // the reads are spread over at least the time the limit allows for all but the last object
+    const auto start = std::chrono::steady_clock::now();
+    report = store.scrub(ScrubOptions{.max_bytes_per_second = 200000});
+    REQUIRE(report.objects == 3);
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds{400});
+}
+
+TEST_CASE("FileStore tree hash keys", "[filestore][tree_hash]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    static constexpr std::uint32_t leaf_size = 65536;
+    std::mt19937 rng{11};
+    std::string content(1000000, 0);
+    std::generate(content.begin(), content.end(), [&rng]() { return static_cast<char>(rng()); });
+    TempFS source;
+    fs::create_directories(source.path());
+    const auto file_path = source.path() / "large.bin";
+    std::ofstream{file_path, std::ios_base::binary} << content;
+
+    const StoreConfig config{KeyScheme::sha256_tree, leaf_size};
+    const auto data = std::as_bytes(std::span{content});
+    const auto root = tree_hash(data, leaf_size).root;
+
+    TempFS fs1;
+    Key k;
+    {
+        FileStore store(fs1, StoreOptions{.config = config});
+        REQUIRE(store.config() == config);
+        k = store.import(file_path).value();
+        REQUIRE(std::equal(root.data.begin(), root.data.end(), k.data.begin()));
+        REQUIRE(k != generate_file_key(file_path));
+    }
+
+    // the scheme is kept by stores opened later, so the keys stay the same
+    FileStore store(fs1);
+    REQUIRE(store.config() == config);
+    REQUIRE_FALSE(store.import(std::as_bytes(std::span{content})).has_value());
+    std::istringstream stream{content};
+    REQUIRE(store.import(stream).error() == k);
+    REQUIRE(store.import_async(file_path).get().error() == k);
+    REQUIRE_THROWS_AS(FileStore(fs1, StoreOptions{.config = {KeyScheme::sha256_tree, 2 * leaf_size}}), std::invalid_argument);
+
+    REQUIRE(store.verify(k));
+    REQUIRE(store.verify(k, 3 * leaf_size, 2 * leaf_size));
+    {
+        std::fstream object{store.get_file_path(k), std::ios_base::binary | std::ios_base::in | std::ios_base::out};
+        object.seekp(10 * leaf_size + 5);
+        object.put(static_cast<char>(content[10 * leaf_size + 5] ^ 1));
+    }
+    REQUIRE_FALSE(store.verify(k));
+    REQUIRE_FALSE(store.verify(k, 10 * leaf_size, 1));
+    REQUIRE(store.verify(k, 0, 10 * leaf_size));
+    REQUIRE(store.verify(k, 11 * leaf_size));
+
+    // stores with the default scheme check the whole object
+    TempFS fs2;
+    FileStore plain(fs2);
+    const auto k2 = plain.import(file_path).value();
+    REQUIRE(k2 == generate_file_key(file_path));
+    REQUIRE(plain.verify(k2, 0, 1));
+}
+
+TEST_CASE("FileStore hash algorithms", "[filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    const fs::path root{"../../test/data"};
+    for (const auto scheme : {KeyScheme::blake3, KeyScheme::xxh128}) {
+        const StoreConfig config{scheme};
+        TempFS fs1;
+        {
+            FileStore store(fs1, StoreOptions{.config = config});
+            const auto k1 = store.import(root / "file1.dat").value();
+            REQUIRE(k1 != generate_file_key(root / "file1.dat"));
+            const auto expected = hash_file_content(root / "file1.dat", config).hash;
+            REQUIRE(std::equal(expected.data.begin(), expected.data.end(), k1.data.begin()));
+            REQUIRE(store.import(root / "file2.dat").error() == k1);
+            REQUIRE(store.verify(k1));
+
+            const auto content = read_file(root / "file3.dat");
+            const auto k3 = store.import(std::as_bytes(std::span{content})).value();
+            REQUIRE(store.import(root / "file3.dat").error() == k3);
+            REQUIRE(store.import_async(root / "file3.dat").get().error() == k3);
+        }
+
+        // the algorithm is recorded, so the store cannot be opened with another one
+        REQUIRE(FileStore(fs1).config() == config);
+        REQUIRE_THROWS_AS(FileStore(fs1, StoreOptions{.config = {KeyScheme::sha256_tree}}), std::invalid_argument);
+        FileStore store(fs1, StoreOptions{.import_mode = TransferMode::copy, .config = config});
+        const auto k4 = store.import(root / "file4.dat").value();
+        REQUIRE(store.verify(k4));
+        REQUIRE(store.object_count() == 3);
+    }
 }
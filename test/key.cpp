@@ -0,0 +1,43 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/key.h"
+#include <filesystem>
+#include <string>
+
+TEST_CASE("key strings", "[key]") {
+    using namespace filestore;
+
+    const std::string digits = "a37b2f29ec7ef15a39b20015382bef6a45b28a3b2ffe1862ca4f92ef7a3f2872dd180000";
+    const auto key = from_string(digits);
+    REQUIRE(key.has_value());
+    REQUIRE(key->distinguisher() == 0x18dd);
+    REQUIRE(to_string(*key) == digits);
+
+    std::array<char, Key::string_length> buffer;
+    to_chars(*key, buffer);
+    REQUIRE(std::string(buffer.data(), buffer.size()) == digits);
+
+    REQUIRE_FALSE(from_string(digits.substr(2)).has_value());
+    REQUIRE_FALSE(from_string("A37B2F29EC7EF15A39B20015382BEF6A45B28A3B2FFE1862CA4F92EF7A3F2872DD180000").has_value());
+    REQUIRE_FALSE(from_string("").has_value());
+}
+
+TEST_CASE("key paths", "[key]") {
+    using namespace filestore;
+
+    const auto digits = std::string{"a37b2f29ec7ef15a39b20015382bef6a45b28a3b2ffe1862ca4f92ef7a3f287200000000"};
+    const auto key = *from_string(digits);
+    const auto separator = static_cast<char>(std::filesystem::path::preferred_separator);
+
+    REQUIRE(KeyPath(key, 0).view() == digits);
+    REQUIRE(KeyPath(key, 1).view() == "a3" + std::string{separator} + digits.substr(2));
+    REQUIRE(KeyPath(key, 3).view() == "a3" + std::string{separator} + "7b" + separator + "2f" + separator + digits.substr(6));
+    REQUIRE(KeyPath(key, Key::bytelength).view().size() == Key::string_length + Key::bytelength);
+    REQUIRE_THROWS_AS(KeyPath(key, -1), std::out_of_range);
+    REQUIRE_THROWS_AS(KeyPath(key, Key::bytelength + 1), std::out_of_range);
+}
@@ -0,0 +1,119 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/filestore.h"
+#include "FileStore/key_index.h"
+#include "temp_fs.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+
+filestore::Key random_key(std::mt19937_64 &rng) {
+    filestore::Key key{};
+    for (auto &b : key.data)
+        b = static_cast<std::byte>(rng() & 0xff);
+    return key;
+}
+
+} // namespace
+
+TEST_CASE("key index insert and lookup", "[key_index]") {
+    using namespace filestore;
+
+    std::mt19937_64 rng{42};
+    std::vector<Key> keys;
+    for (int i = 0; i < 10000; ++i)
+        keys.push_back(random_key(rng));
+    // same hash, different distinguishers
+    for (Key::distinguisher_type d = 1; d < 10; ++d) {
+        auto key = keys[0];
+        key.update_distiguisher(d);
+        keys.push_back(key);
+    }
+
+    KeyIndex index;
+    REQUIRE(index.empty());
+    REQUIRE_FALSE(index.contains(keys[0]));
+    for (const auto &key : keys)
+        REQUIRE(index.insert(key));
+    REQUIRE(index.size() == keys.size());
+    REQUIRE_FALSE(index.insert(keys[5]));
+    REQUIRE(index.size() == keys.size());
+
+    for (const auto &key : keys)
+        REQUIRE(index.contains(key));
+    for (int i = 0; i < 1000; ++i)
+        REQUIRE_FALSE(index.contains(random_key(rng)));
+
+    // every other key, including some with the same hash, so the others must stay reachable
+    for (size_t i = 0; i < keys.size(); i += 2)
+        REQUIRE(index.erase(keys[i]));
+    REQUIRE_FALSE(index.erase(keys[0]));
+    REQUIRE(index.size() == keys.size() / 2);
+    for (size_t i = 0; i < keys.size(); ++i)
+        REQUIRE(index.contains(keys[i]) == (i % 2 == 1));
+
+    index.clear();
+    REQUIRE(index.empty());
+    REQUIRE_FALSE(index.contains(keys[0]));
+}
+
+TEST_CASE("key index snapshots", "[key_index]") {
+    using namespace filestore;
+
+    TempFS temp;
+    std::filesystem::create_directories(temp.path());
+    std::mt19937_64 rng{7};
+
+    KeyIndex index;
+    std::vector<Key> keys;
+    for (int i = 0; i < 500; ++i) {
+        keys.push_back(random_key(rng));
+        index.insert(keys.back());
+    }
+    index.save(temp.path() / "keys.idx");
+
+    const auto loaded = KeyIndex::load(temp.path() / "keys.idx");
+    REQUIRE(loaded.size() == keys.size());
+    for (const auto &key : keys)
+        REQUIRE(loaded.contains(key));
+
+    std::ofstream{temp.path() / "broken.idx"} << "no index";
+    REQUIRE_THROWS_AS(KeyIndex::load(temp.path() / "broken.idx"), FileError);
+    REQUIRE_THROWS_AS(KeyIndex::load(temp.path() / "missing.idx"), FileError);
+}
+
+TEST_CASE("FileStore with key index", "[key_index][filestore]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS fs1;
+    Key k1, k3;
+    {
+        // objects stored before the index is used are found by scanning
+        FileStore store(fs1);
+        k1 = store.import(root / "file1.dat").value();
+    }
+    {
+        FileStore store(fs1, StoreOptions{.key_index = true});
+        REQUIRE_FALSE(store.import(root / "file2.dat").has_value());
+        k3 = store.import(root / "file3.dat").value();
+        REQUIRE_FALSE(store.import(root / "file3.dat").has_value());
+        store.save_key_index();
+    }
+    REQUIRE(fs::exists(fs1.path() / ".filestore" / "keys.idx"));
+    {
+        FileStore store(fs1, StoreOptions{.key_index = true});
+        REQUIRE(store.import(root / "file4.dat").has_value());
+        REQUIRE_FALSE(fs::exists(fs1.path() / ".filestore" / "keys.idx")); // consumed
+        REQUIRE(store.import(root / "file1.dat").error() == k1);
+        REQUIRE(store.import(root / "file3.dat").error() == k3);
+    }
+}
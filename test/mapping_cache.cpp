@@ -0,0 +1,43 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/mapping_cache.h"
+#include <filesystem>
+
+TEST_CASE("mapping cache eviction", "[mapping_cache]") {
+    using namespace filestore;
+    std::filesystem::path root{"../../test/data"};
+
+    const auto key = [](int i) {
+        Key k{};
+        k.data[0] = static_cast<std::byte>(i);
+        return k;
+    };
+    const auto mapping1 = std::make_shared<const MappedFile>(root / "file1.dat");
+    const auto mapping3 = std::make_shared<const MappedFile>(root / "file3.dat");
+
+    MappingCache cache{2};
+    REQUIRE(cache.find(key(1)) == nullptr);
+    cache.insert(key(1), mapping1);
+    cache.insert(key(2), mapping3);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(key(1)) == mapping1); // now the most recently used one
+
+    cache.insert(key(3), mapping3);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find(key(2)) == nullptr);
+    REQUIRE(cache.find(key(1)) == mapping1);
+    REQUIRE(cache.find(key(3)) == mapping3);
+
+    cache.erase(key(1));
+    REQUIRE(cache.find(key(1)) == nullptr);
+    REQUIRE(cache.size() == 1);
+
+    MappingCache disabled{0};
+    disabled.insert(key(1), mapping1);
+    REQUIRE(disabled.find(key(1)) == nullptr);
+}
@@ -0,0 +1,82 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/metrics.h"
+#include <string>
+
+TEST_CASE("metrics histogram buckets", "[metrics]") {
+    using namespace filestore;
+
+    REQUIRE(HistogramSnapshot::bucket(0) == 0);
+    REQUIRE(HistogramSnapshot::bucket(1) == 1);
+    REQUIRE(HistogramSnapshot::bucket(2) == 2);
+    REQUIRE(HistogramSnapshot::bucket(3) == 2);
+    REQUIRE(HistogramSnapshot::bucket(1024) == 11);
+    REQUIRE(HistogramSnapshot::bucket(~std::uint64_t{0}) == HistogramSnapshot::bucket_count - 1);
+    REQUIRE(HistogramSnapshot::upper_bound(0) == 0);
+    REQUIRE(HistogramSnapshot::upper_bound(2) == 3);
+
+    Metrics metrics;
+    metrics.distinguisher_steps.record(0);
+    metrics.distinguisher_steps.record(0);
+    metrics.distinguisher_steps.record(5);
+    metrics.key_probes.add();
+    metrics.bytes_hashed.add(100);
+    {
+        Metrics::Timer timer{metrics.hash_time, false};
+        timer.start();
+        timer.stop();
+        timer.start();
+    }
+    // a timer that never ran records nothing
+    { Metrics::Timer timer{metrics.copy_time, false}; }
+
+    const auto snapshot = metrics.snapshot();
+    if constexpr (metrics_enabled) {
+        REQUIRE(snapshot.distinguisher_steps.count == 3);
+        REQUIRE(snapshot.distinguisher_steps.sum == 5);
+        REQUIRE(snapshot.distinguisher_steps.buckets[0] == 2);
+        REQUIRE(snapshot.distinguisher_steps.buckets[3] == 1);
+        REQUIRE(snapshot.key_probes == 1);
+        REQUIRE(snapshot.bytes_hashed == 100);
+        REQUIRE(snapshot.hash_time.count == 1);
+        REQUIRE(snapshot.copy_time.count == 0);
+    } else {
+        REQUIRE(snapshot.distinguisher_steps.count == 0);
+        REQUIRE(snapshot.key_probes == 0);
+        REQUIRE(snapshot.hash_time.count == 0);
+    }
+}
+
+TEST_CASE("metrics export", "[metrics]") {
+    using namespace filestore;
+
+    MetricsSnapshot snapshot;
+    snapshot.hash_time.buckets[HistogramSnapshot::bucket(1500)] = 2;
+    snapshot.hash_time.count = 2;
+    snapshot.hash_time.sum = 3000;
+    snapshot.key_probes = 7;
+    snapshot.bytes_stored = 42;
+
+    const auto text = snapshot.to_prometheus();
+    REQUIRE(text.find("# TYPE filestore_hash_seconds histogram\n") != std::string::npos);
+    REQUIRE(text.find("filestore_hash_seconds_bucket{le=\"1.023e-06\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("filestore_hash_seconds_bucket{le=\"2.047e-06\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("filestore_hash_seconds_bucket{le=\"+Inf\"} 2\n") != std::string::npos);
+    REQUIRE(text.find("filestore_hash_seconds_sum 3e-06\n") != std::string::npos);
+    REQUIRE(text.find("filestore_hash_seconds_count 2\n") != std::string::npos);
+    REQUIRE(text.find("filestore_distinguisher_steps_bucket{le=\"0\"} 0\n") != std::string::npos);
+    REQUIRE(text.find("filestore_key_probes_total 7\n") != std::string::npos);
+    REQUIRE(text.find("filestore_stored_bytes_total 42\n") != std::string::npos);
+
+    const auto json = snapshot.to_json();
+    REQUIRE(json.front() == '{');
+    REQUIRE(json.back() == '}');
+    REQUIRE(json.find("\"hash_time_ns\":{\"count\":2,\"sum\":3000,\"buckets\":[0,0,0,0,0,0,0,0,0,0,0,2,0,") != std::string::npos);
+    REQUIRE(json.find("\"key_probes\":7,") != std::string::npos);
+    REQUIRE(json.find("\"bytes_stored\":42}") != std::string::npos);
+}
@@ -0,0 +1,158 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/file.h"
+#include "FileStore/pack.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+namespace {
+
+filestore::Key make_key(int i) {
+    filestore::Key k{};
+    k.data[0] = static_cast<std::byte>(i & 0xff);
+    k.data[1] = static_cast<std::byte>(i >> 8);
+    return k;
+}
+
+std::string content(int i) {
+    return std::string(static_cast<size_t>(100 + i), static_cast<char>('a' + i % 26));
+}
+
+void add(filestore::PackStore &packs, int i, std::int64_t import_time = 0) {
+    const auto data = content(i);
+    packs.add(make_key(i), std::as_bytes(std::span{data}), import_time);
+}
+
+bool has_content(const filestore::PackStore &packs, int i) {
+    const auto object = packs.read(make_key(i));
+    const auto expected = content(i);
+    return object && std::ranges::equal(object->data, std::as_bytes(std::span{expected}));
+}
+
+} // namespace
+
+TEST_CASE("pack objects", "[pack]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    const auto directory = temp.path() / "packs";
+    {
+        PackStore packs{directory, 4096};
+        REQUIRE(packs.size() == 0);
+        for (int i = 0; i < 50; ++i)
+            add(packs, i, 1000 + i);
+        REQUIRE(packs.size() == 50);
+        REQUIRE(packs.pack_count() > 1);
+        REQUIRE(has_content(packs, 0));
+        REQUIRE(has_content(packs, 49));
+        REQUIRE(packs.find(make_key(7))->size == 107);
+        REQUIRE(packs.find(make_key(7))->import_time == 1007);
+        REQUIRE_FALSE(packs.read(make_key(50)));
+
+        REQUIRE(packs.remove(make_key(3)));
+        REQUIRE_FALSE(packs.remove(make_key(3)));
+        REQUIRE_FALSE(packs.contains(make_key(3)));
+    }
+    {
+        // persistent, and a removed object can be added again
+        PackStore packs{directory, 4096};
+        REQUIRE(packs.size() == 49);
+        REQUIRE_FALSE(packs.contains(make_key(3)));
+        add(packs, 3);
+        REQUIRE(has_content(packs, 3));
+        REQUIRE(has_content(packs, 30));
+    }
+    PackStore packs{directory, 4096};
+    REQUIRE(packs.size() == 50);
+    size_t count = 0;
+    packs.for_each([&count](const Key &, const PackLocation &) { ++count; });
+    REQUIRE(count == 50);
+}
+
+TEST_CASE("pack after a crash", "[pack]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    const auto directory = temp.path() / "packs";
+    const auto crashed = temp.path() / "crashed";
+    PackStore packs{directory};
+    for (int i = 0; i < 5; ++i)
+        add(packs, i);
+    REQUIRE(packs.remove(make_key(2)));
+    // the files as a crash would leave them behind, without a sync
+    fs::copy(directory, crashed);
+
+    const PackStore recovered{crashed};
+    REQUIRE(recovered.size() == 4);
+    REQUIRE(has_content(recovered, 4));
+    REQUIRE_FALSE(recovered.contains(make_key(2)));
+}
+
+TEST_CASE("pack repack", "[pack]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    const auto directory = temp.path() / "packs";
+    {
+        PackStore packs{directory, 4096};
+        for (int i = 0; i < 50; ++i)
+            add(packs, i);
+        const auto pack_count = packs.pack_count();
+
+        REQUIRE(packs.repack() == 0);
+        for (int i = 0; i < 40; ++i)
+            packs.remove(make_key(i));
+        REQUIRE(packs.repack() > 0);
+        REQUIRE(packs.pack_count() < pack_count);
+        REQUIRE(packs.size() == 10);
+        for (int i = 40; i < 50; ++i)
+            REQUIRE(has_content(packs, i));
+    }
+    PackStore packs{directory, 4096};
+    REQUIRE(packs.size() == 10);
+    for (int i = 40; i < 50; ++i)
+        REQUIRE(has_content(packs, i));
+}
+
+TEST_CASE("pack recovery", "[pack]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    const auto directory = temp.path() / "packs";
+    {
+        PackStore packs{directory};
+        for (int i = 0; i < 5; ++i)
+            add(packs, i);
+        packs.sync();
+    }
+
+    // the data of the last object did not reach the disk
+    const auto data_path = directory / "pack-000001.pack";
+    fs::resize_file(data_path, fs::file_size(data_path) - 10);
+    {
+        PackStore packs{directory};
+        REQUIRE(packs.size() == 4);
+        REQUIRE(has_content(packs, 3));
+        add(packs, 4);
+        REQUIRE(has_content(packs, 4));
+    }
+
+    // torn index record
+    const auto index_path = directory / "pack-000001.idx";
+    fs::resize_file(index_path, fs::file_size(index_path) - 10);
+    REQUIRE(PackStore{directory}.size() == 4);
+
+    std::ofstream{directory / "pack-000002.idx"} << "not a pack index";
+    REQUIRE_THROWS_AS(PackStore{directory}, FileError);
+}
@@ -47,3 +47,39 @@ TEST_CASE("sha256 file hashes", "[hash]") {
     REQUIRE(hash_file(root / "file3.dat") == "0cc8d7e70144753c7f1f1ba72687434595934a9dfc0932401fa3285e37eb2b66"s);
     REQUIRE(hash_file(root / "file4.dat") == "d42adb5929b01ea9d435a8d847c71c26a8f7fd8265cb956fdc3210b9cadb2829"s);
 }
+
+TEST_CASE("sha256 implementations", "[hash]") {
+    using namespace std::string_literals;
+    using Impl = filestore::SHA256::Implementation;
+
+    std::string data(100000, 0);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>((i * 7 + i / 13) & 0xff);
+
+    const auto hash_chunked = [&](size_t chunk_size) {
+        filestore::SHA256 sha;
+        for (size_t offset = 0; offset < data.size(); offset += chunk_size)
+            sha.update(std::span(data.data() + offset, std::min(chunk_size, data.size() - offset)));
+        return to_hex_string(sha.hash());
+    };
+
+    const auto initial = filestore::SHA256::implementation();
+    REQUIRE(filestore::SHA256::use_implementation(Impl::generic));
+    const auto reference = hash_str(data);
+    REQUIRE(reference == "31d0267730ac13f2c898d8f433ac3b96aedca7591fe73659c099799022b362df"s);
+    REQUIRE(hash_chunked(1) == reference);
+    REQUIRE(hash_chunked(63) == reference);
+    REQUIRE(hash_chunked(4096) == reference);
+
+    for (const auto impl : {Impl::generic, Impl::shani}) {
+        if (!filestore::SHA256::use_implementation(impl))
+            continue;
+        REQUIRE(filestore::SHA256::implementation() == impl);
+        REQUIRE(hash_str("Hello, World!") == "dffd6021bb2bd5b0af676290809ec3a53191dd81c7f70a4b28688a362182986f"s);
+        REQUIRE(hash_str("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"s);
+        REQUIRE(hash_str(data) == reference);
+        REQUIRE(hash_chunked(65) == reference);
+        REQUIRE(hash_chunked(1000) == reference);
+    }
+    filestore::SHA256::use_implementation(initial);
+}
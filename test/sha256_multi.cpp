@@ -0,0 +1,51 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/sha256.h"
+#include "FileStore/sha256_multi.h"
+#include <span>
+#include <string>
+#include <vector>
+
+TEST_CASE("sha256 multi buffer hashes", "[hash]") {
+    using namespace filestore;
+    using Impl = SHA256Multi::Implementation;
+
+    // lengths around the block and padding boundaries, more messages than lanes
+    std::vector<std::string> data;
+    for (size_t length : {0, 1, 3, 55, 56, 63, 64, 65, 119, 120, 127, 128, 129, 1000, 5000})
+        for (size_t variant = 0; variant < 3; ++variant) {
+            std::string str(length, 0);
+            for (size_t i = 0; i < length; ++i)
+                str[i] = static_cast<char>((i * 31 + variant * 7 + length) & 0xff);
+            data.push_back(str);
+        }
+    const std::vector<std::span<const char>> messages(data.begin(), data.end());
+
+    std::vector<SHA256::hash_type> expected;
+    for (const auto &message : messages) {
+        SHA256 sha;
+        sha.update(message);
+        expected.push_back(sha.hash());
+    }
+
+    const auto initial = SHA256Multi::implementation();
+    for (const auto impl : {Impl::sequential, Impl::avx2, Impl::avx512}) {
+        if (!SHA256Multi::use_implementation(impl))
+            continue;
+        const auto hashes = SHA256Multi::hash(messages);
+        REQUIRE(hashes.size() == expected.size());
+        for (size_t i = 0; i < hashes.size(); ++i)
+            REQUIRE(hashes[i].data == expected[i].data);
+
+        REQUIRE(SHA256Multi::hash({}).empty());
+        const auto single = SHA256Multi::hash(std::span(messages.begin(), 1));
+        REQUIRE(single.size() == 1);
+        REQUIRE(single[0].data == expected[0].data);
+    }
+    SHA256Multi::use_implementation(initial);
+}
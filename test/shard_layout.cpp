@@ -0,0 +1,75 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/file.h"
+#include "FileStore/shard_layout.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+filestore::Key key_with_prefix(std::vector<std::byte> prefix) {
+    filestore::Key key{};
+    std::ranges::copy(prefix, key.data.begin());
+    return key;
+}
+
+} // namespace
+
+TEST_CASE("shard layout depths", "[shard_layout]") {
+    using namespace filestore;
+
+    ShardLayout flat{0, 100};
+    REQUIRE(flat.depth(key_with_prefix({std::byte{0x12}})) == 0);
+    REQUIRE(flat.version() == 0);
+
+    ShardLayout fixed{2, 100};
+    REQUIRE(fixed.depth(key_with_prefix({std::byte{0x12}, std::byte{0x34}})) == 2);
+    REQUIRE(fixed.is_split({}));
+    REQUIRE(fixed.is_split(std::vector{std::byte{0xff}}));
+    REQUIRE_FALSE(fixed.is_split(std::vector{std::byte{0xff}, std::byte{0x00}}));
+
+    // only the directories that are split get deeper
+    const auto version = fixed.version();
+    REQUIRE(fixed.split(std::vector{std::byte{0x12}, std::byte{0x34}}));
+    REQUIRE_FALSE(fixed.split(std::vector{std::byte{0x12}, std::byte{0x34}}));
+    REQUIRE(fixed.version() == version + 1);
+    REQUIRE(fixed.depth(key_with_prefix({std::byte{0x12}, std::byte{0x34}, std::byte{0x56}})) == 3);
+    REQUIRE(fixed.depth(key_with_prefix({std::byte{0x12}, std::byte{0x35}, std::byte{0x56}})) == 2);
+    REQUIRE_THROWS_AS(fixed.split(std::vector{std::byte{0x12}, std::byte{0x35}, std::byte{0x56}}), std::invalid_argument);
+
+    REQUIRE_THROWS_AS(ShardLayout(3, 100), std::invalid_argument);
+}
+
+TEST_CASE("shard layout files", "[shard_layout]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "shards";
+    {
+        ShardLayout layout{1, 1000};
+        layout.split(std::vector{std::byte{0xab}});
+        layout.split(std::vector{std::byte{0xab}, std::byte{0x01}});
+        layout.save(path);
+    }
+    const ShardLayout loaded{path};
+    REQUIRE(loaded.split_threshold() == 1000);
+    REQUIRE(loaded.depth(key_with_prefix({std::byte{0xab}, std::byte{0x01}})) == 3);
+    REQUIRE(loaded.depth(key_with_prefix({std::byte{0xab}, std::byte{0x02}})) == 2);
+    REQUIRE(loaded.depth(key_with_prefix({std::byte{0xac}})) == 1);
+
+    // a split without its parent
+    std::ofstream{path} << "split_threshold 10\nsplit -\nsplit 0102\n";
+    REQUIRE_THROWS_AS(ShardLayout{path}, FileError);
+    REQUIRE_THROWS_AS(ShardLayout{temp.path() / "missing"}, FileError);
+}
@@ -0,0 +1,84 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/file.h"
+#include "FileStore/source_cache.h"
+#include "temp_fs.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("source cache lookup", "[source_cache]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+    fs::path root{"../../test/data"};
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "sources";
+
+    const auto state = SourceCache::describe(root / "file1.dat");
+    REQUIRE(state.has_value());
+    REQUIRE(state->size == fs::file_size(root / "file1.dat"));
+    const auto modification_time = std::chrono::file_clock::to_sys(fs::last_write_time(root / "file1.dat"));
+    REQUIRE(state->modification_time == std::chrono::duration_cast<std::chrono::nanoseconds>(modification_time.time_since_epoch()).count());
+    REQUIRE_FALSE(SourceCache::describe(root / "missing.dat").has_value());
+    REQUIRE_FALSE(SourceCache::describe(root).has_value());
+
+    Key key{};
+    key.data[0] = std::byte{0x42};
+    auto changed = *state;
+    changed.modification_time += 1;
+    {
+        SourceCache cache{path};
+        REQUIRE(cache.size() == 0);
+        REQUIRE_FALSE(cache.find(root / "file1.dat", *state).has_value());
+        cache.insert(root / "file1.dat", *state, key);
+        REQUIRE(cache.find(root / "file1.dat", *state) == key);
+        REQUIRE(cache.find(fs::absolute(root) / "." / "file1.dat", *state) == key);
+        REQUIRE_FALSE(cache.find(root / "file1.dat", changed).has_value());
+        REQUIRE_FALSE(cache.find(root / "file2.dat", *state).has_value());
+    }
+
+    SourceCache cache{path};
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.find(root / "file1.dat", *state) == key);
+
+    // the last record for a path wins
+    key.data[0] = std::byte{0x43};
+    cache.insert(root / "file1.dat", changed, key);
+    cache.flush();
+    SourceCache reloaded{path};
+    REQUIRE(reloaded.size() == 1);
+    REQUIRE_FALSE(reloaded.find(root / "file1.dat", *state).has_value());
+    REQUIRE(reloaded.find(root / "file1.dat", changed) == key);
+}
+
+TEST_CASE("source cache recovery", "[source_cache]") {
+    using namespace filestore;
+    namespace fs = std::filesystem;
+
+    TempFS temp;
+    fs::create_directories(temp.path());
+    const auto path = temp.path() / "sources";
+
+    const SourceState state{.size = 1, .modification_time = 2, .device = 3, .inode = 4};
+    {
+        SourceCache cache{path};
+        for (int i = 0; i < 5; ++i)
+            cache.insert(temp.path() / std::to_string(i), state, Key{});
+    }
+
+    // a torn record at the end is dropped
+    const auto full_size = fs::file_size(path);
+    fs::resize_file(path, full_size - 3);
+    REQUIRE(SourceCache{path}.size() == 4);
+    REQUIRE(fs::file_size(path) < full_size - 3);
+
+    std::ofstream{path, std::ios_base::trunc} << "not a cache";
+    REQUIRE(SourceCache{path}.size() == 0);
+}
@@ -0,0 +1,64 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/file.h"
+#include "FileStore/store_config.h"
+#include "temp_fs.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+TEST_CASE("store config", "[store_config]") {
+    using namespace filestore;
+
+    TempFS temp;
+    std::filesystem::create_directories(temp.path());
+    const auto path = temp.path() / "config";
+
+    for (const auto scheme : {KeyScheme::sha256, KeyScheme::blake3, KeyScheme::xxh128}) {
+        StoreConfig{scheme}.save(path);
+        REQUIRE(StoreConfig::load(path).key_scheme == scheme);
+    }
+    const StoreConfig config{KeyScheme::sha256_tree, 65536};
+    config.save(path);
+    REQUIRE(StoreConfig::load(path) == config);
+
+    // names of later versions are skipped
+    std::ofstream{path, std::ios_base::app} << "something_new 1\n";
+    REQUIRE(StoreConfig::load(path) == config);
+
+    std::ofstream{path} << "key_scheme md5\n";
+    REQUIRE_THROWS_AS(StoreConfig::load(path), FileError);
+    std::ofstream{path} << "leaf_size 0\n";
+    REQUIRE_THROWS_AS(StoreConfig::load(path), FileError);
+    REQUIRE_THROWS_AS(StoreConfig::load(temp.path() / "missing"), FileError);
+}
+
+TEST_CASE("key hasher", "[store_config]") {
+    using namespace filestore;
+
+    const std::string text(100000, 'x');
+    const auto data = std::as_bytes(std::span{text});
+    for (const auto &config : {StoreConfig{}, StoreConfig{KeyScheme::sha256_tree, 4096}, StoreConfig{KeyScheme::blake3}, StoreConfig{KeyScheme::xxh128}}) {
+        KeyHasher hasher{config};
+        hasher.update(std::span{text}.first(5000));
+        hasher.update(std::span{text}.subspan(5000));
+        const auto streamed = hasher.hash();
+        const auto direct = hash_content(data, config);
+        REQUIRE(streamed.hash.data == direct.hash.data);
+        REQUIRE(streamed.leaves.size() == direct.leaves.size());
+        REQUIRE(direct.leaves.size() == (config.key_scheme == KeyScheme::sha256_tree ? 25 : 0));
+    }
+    REQUIRE(hash_content(data, StoreConfig{}).hash.data != hash_content(data, StoreConfig{KeyScheme::sha256_tree, 4096}).hash.data);
+    REQUIRE(hash_content(data, StoreConfig{}).hash.data != hash_content(data, StoreConfig{KeyScheme::blake3}).hash.data);
+
+    // the 128 bit hash fills the first half of the key
+    const auto xxh = hash_content(data, StoreConfig{KeyScheme::xxh128}).hash;
+    REQUIRE(std::all_of(xxh.data.begin() + 16, xxh.data.end(), [](std::byte b) { return b == std::byte{0}; }));
+    REQUIRE(xxh.data[0] == static_cast<std::byte>(xxh3_128(data).high >> 56));
+}
@@ -0,0 +1,46 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#ifndef FILESTORE_TEST_TEMP_FS_H
+#define FILESTORE_TEST_TEMP_FS_H
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+
+inline std::string rand_string(size_t length) {
+    static constexpr auto num_chars = 63U;
+    static constexpr char chars[num_chars] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+    static constexpr auto rand_char = [&]() {
+        static std::default_random_engine rng(std::random_device{}());
+        static std::uniform_int_distribution<> dist(0, num_chars - 2); // without the terminating 0
+        return chars[dist(rng)];
+    };
+
+    std::string str(length, 0);
+    std::generate_n(std::begin(str), length, rand_char);
+
+    return str;
+}
+
+class TempFS {
+public:
+    TempFS() {
+        m_path = std::filesystem::temp_directory_path() / rand_string(5);
+        while (std::filesystem::exists(m_path)) {
+            m_path = std::filesystem::temp_directory_path() / rand_string(5);
+        }
+    }
+    ~TempFS() { std::filesystem::remove_all(m_path); }
+
+    const std::filesystem::path &path() const { return m_path; }
+    operator std::filesystem::path &() { return m_path; }
+private:
+    std::filesystem::path m_path;
+};
+
+#endif
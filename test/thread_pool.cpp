@@ -0,0 +1,87 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/thread_pool.h"
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("thread pool runs all tasks", "[thread_pool]") {
+    using namespace filestore;
+
+    ThreadPool pool{4};
+    REQUIRE(pool.size() == 4);
+
+    std::vector<int> values(1000, 0);
+    for (size_t i = 0; i < values.size(); ++i)
+        pool.submit([&values, i]() { values[i] = static_cast<int>(i); });
+    pool.wait();
+    for (size_t i = 0; i < values.size(); ++i)
+        REQUIRE(values[i] == static_cast<int>(i));
+
+    // tasks submitting more tasks
+    std::atomic<int> count{0};
+    for (int i = 0; i < 10; ++i)
+        pool.submit([&pool, &count]() {
+            for (int j = 0; j < 10; ++j)
+                pool.submit([&count]() { ++count; });
+        });
+    pool.wait();
+    REQUIRE(count == 100);
+}
+
+TEST_CASE("thread pool reports exceptions", "[thread_pool]") {
+    using namespace filestore;
+
+    ThreadPool pool{2};
+    std::atomic<int> count{0};
+    pool.submit([]() { throw std::runtime_error("task failed"); });
+    for (int i = 0; i < 10; ++i)
+        pool.submit([&count]() { ++count; });
+    REQUIRE_THROWS_AS(pool.wait(), std::runtime_error);
+    REQUIRE(count == 10);
+
+    // the exception is reported once
+    pool.submit([&count]() { ++count; });
+    REQUIRE_NOTHROW(pool.wait());
+    REQUIRE(count == 11);
+}
+
+TEST_CASE("thread pool task groups", "[thread_pool]") {
+    using namespace filestore;
+
+    ThreadPool pool{2};
+    std::promise<void> release;
+    pool.submit([blocked = release.get_future().share()]() { blocked.wait(); });
+    pool.submit([]() { throw std::runtime_error("other task failed"); });
+
+    // the group is finished, while the pool is not
+    std::atomic<int> count{0};
+    TaskGroup group{pool};
+    for (int i = 0; i < 100; ++i)
+        group.submit([&count]() { ++count; });
+    REQUIRE_NOTHROW(group.wait());
+    REQUIRE(count == 100);
+
+    // its exceptions go to the group only
+    group.submit([]() { throw std::logic_error("group task failed"); });
+    REQUIRE_THROWS_AS(group.wait(), std::logic_error);
+
+    // a task waits for a group of its own, while the other worker is blocked
+    pool.submit([&pool, &count]() {
+        TaskGroup nested{pool};
+        for (int i = 0; i < 10; ++i)
+            nested.submit([&count]() { ++count; });
+        nested.wait();
+    });
+    while (count < 110)
+        std::this_thread::yield();
+    release.set_value();
+    REQUIRE_THROWS_AS(pool.wait(), std::runtime_error);
+}
@@ -0,0 +1,61 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/tree_hash.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST_CASE("tree hash", "[tree_hash]") {
+    using namespace filestore;
+
+    static constexpr std::uint32_t leaf_size = 4096;
+    std::mt19937 rng{3};
+    std::vector<std::byte> data(10 * leaf_size + 123);
+    std::generate(data.begin(), data.end(), [&rng]() { return static_cast<std::byte>(rng()); });
+
+    ThreadPool pool{4};
+    for (const size_t size : {size_t{0}, size_t{1}, size_t{leaf_size}, size_t{leaf_size + 1}, data.size()}) {
+        const auto content = std::span{data}.first(size);
+        // fed in pieces that do not line up with the leaves
+        TreeHash streamed{leaf_size};
+        for (auto rest = content; !rest.empty();) {
+            const auto piece = rest.first(std::min<size_t>(rest.size(), 1000));
+            streamed.update({reinterpret_cast<const char *>(piece.data()), piece.size()});
+            rest = rest.subspan(piece.size());
+        }
+        const auto root = streamed.hash();
+
+        const auto parallel = tree_hash(content, leaf_size, &pool);
+        REQUIRE(parallel.root.data == root.data);
+        REQUIRE(tree_hash(content, leaf_size).root.data == root.data);
+        REQUIRE(parallel.leaves.size() == std::max<size_t>(1, (size + leaf_size - 1) / leaf_size));
+        REQUIRE(streamed.leaves().size() == parallel.leaves.size());
+        REQUIRE(TreeHash::root(parallel.leaves).data == root.data);
+    }
+
+    // from tasks of the pool, on the same pool and on the shared one
+    const auto expected = tree_hash(data, leaf_size).root;
+    std::vector<TreeHashResult> results(8);
+    for (size_t i = 0; i < results.size(); ++i)
+        pool.submit([&, i]() { results[i] = tree_hash(data, leaf_size, i % 2 == 0 ? &pool : nullptr); });
+    pool.wait();
+    for (const auto &result : results)
+        REQUIRE(result.root.data == expected.data);
+
+    // the root of a single leaf is its hash, and the leaf size changes the root
+    REQUIRE(tree_hash(std::span{data}.first(leaf_size), leaf_size).root.data == TreeHash::hash_leaf(std::span{data}.first(leaf_size)).data);
+    REQUIRE(tree_hash(data, leaf_size).root.data != tree_hash(data, 2 * leaf_size).root.data);
+
+    auto changed = data;
+    changed[5 * leaf_size] ^= std::byte{1};
+    const auto original = tree_hash(data, leaf_size);
+    const auto modified = tree_hash(changed, leaf_size);
+    REQUIRE(original.root.data != modified.root.data);
+    for (size_t i = 0; i < original.leaves.size(); ++i)
+        REQUIRE((original.leaves[i].data == modified.leaves[i].data) == (i != 5));
+}
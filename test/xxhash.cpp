@@ -0,0 +1,62 @@
+/* ******************************************************* *
+ * FileStore                                               *
+ * (c) Florian Giesemann 2024                              *
+ * ******************************************************* */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "FileStore/xxhash.h"
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+TEST_CASE("xxh64 hashes", "[hash]") {
+    using namespace filestore;
+
+    const auto hash = [](const std::string &str, std::uint64_t seed = 0) { return xxh64(std::as_bytes(std::span(str.data(), str.size())), seed); };
+    REQUIRE(hash("") == 0xef46db3751d8e999ULL);
+    REQUIRE(hash("a") == 0xd24ec4f1a98c6e5bULL);
+    REQUIRE(hash("abc") == 0x44bc2cf5ad770999ULL);
+    REQUIRE(hash("123456789012345678901234567890123456789") == 0x490afd8c09f2040bULL);
+    REQUIRE(hash("Hello, World!", 42) == 0xc2e0fe28b2512846ULL);
+
+    std::vector<std::byte> data(768);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<std::byte>(i & 0xff);
+    REQUIRE(xxh64(data) == 0x8e03c838c596036fULL);
+}
+
+TEST_CASE("xxh3 128 bit hashes", "[hash]") {
+    using namespace filestore;
+
+    const std::string hello = "Hello, World!";
+    REQUIRE(xxh3_128(std::as_bytes(std::span{hello})) == xxh128_hash{0x77db03842cd75395ULL, 0x531df2844447dd50ULL});
+
+    std::vector<std::byte> data(4096);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<std::byte>(i & 0xff);
+    // all length classes of the short inputs and the block boundaries of the long ones
+    const std::vector<std::tuple<size_t, std::uint64_t, std::uint64_t>> vectors{
+        {0, 0x6001c324468d497fULL, 0x99aa06d3014798d8ULL},    {1, 0xc44bdff4074eecdbULL, 0xa6cd5e9392000f6aULL},
+        {3, 0x5f4299fc161c9cbbULL, 0xe3b55f57945a17cfULL},    {4, 0xa6111d53e80a3db5ULL, 0xeb70bf5fc779e9e6ULL},
+        {8, 0xcfd50c61c8bb98c1ULL, 0xe1e4432a62217fe4ULL},    {9, 0x907931979dca3746ULL, 0x16c769d83e4aebceULL},
+        {16, 0x842812cc870dcae2ULL, 0x72950631827607e2ULL},   {17, 0xc06e233df7729217ULL, 0x685bc458b37d057fULL},
+        {128, 0x05321a0b64d67b41ULL, 0x14792fc3af88dc6cULL},  {129, 0xbc30b63382b09a3bULL, 0xdd5e74ac6b45f54eULL},
+        {240, 0xc92b68e16f83bbb6ULL, 0x65b5be86da5540e7ULL},  {241, 0x02e8cd95421c6d02ULL, 0x1da1cb61bcb8a2a1ULL},
+        {1024, 0xa870f92984398d22ULL, 0x83885e853bb6640cULL}, {1025, 0x78c86e91ee939852ULL, 0xe1e508f110763b46ULL},
+        {4096, 0xeb4b7c3707879151ULL, 0x03916578969f7a66ULL},
+    };
+    for (const auto &[length, low, high] : vectors) {
+        const auto content = std::span{data}.first(length);
+        REQUIRE(xxh3_128(content) == xxh128_hash{low, high});
+
+        XXH3_128 streamed;
+        for (auto rest = content; !rest.empty();) {
+            const auto piece = rest.first(std::min<size_t>(rest.size(), 100));
+            streamed.update({reinterpret_cast<const char *>(piece.data()), piece.size()});
+            rest = rest.subspan(piece.size());
+        }
+        REQUIRE(streamed.hash() == xxh128_hash{low, high});
+    }
+}